@@ -3,6 +3,8 @@ using namespace std;
 struct Arguments {
     vector<string> positionals;
     map<string, string> options;
+    // Arguments after "--", passed on untouched.
+    vector<string> passthrough;
     bool hasHelpFlag = false;
 };
 
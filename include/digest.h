@@ -0,0 +1,29 @@
+#ifndef _WIN32
+enum class DigestType {
+    Sha1,
+    Sha256
+};
+
+// An incremental hash computed with OpenSSL.
+class Digest {
+private:
+    // An EVP_MD_CTX, which is kept out of this header so that it doesn't need OpenSSL's.
+    void *context;
+
+public:
+    explicit Digest(DigestType type);
+
+    ~Digest();
+
+    Digest(const Digest&) = delete;
+    Digest& operator=(const Digest&) = delete;
+
+    void update(const char *data, size_t size);
+
+    // The raw bytes of the hash. Nothing can be added after this is called.
+    string finish();
+
+    // The hash in hex. Nothing can be added after this is called.
+    string hex();
+};
+#endif
@@ -105,6 +105,30 @@ struct UnnecessaryMergeException : public MetroException {
     {}
 };
 
+struct UnchangedMergeHeadException : public MetroException {
+    explicit UnchangedMergeHeadException():
+            MetroException("Nothing to refresh, the absorbed branch hasn't changed.")
+    {}
+};
+
+struct WrongAbsorbedBranchException : public MetroException {
+    explicit WrongAbsorbedBranchException(const string& absorbed):
+            MetroException(("Only the branch being absorbed, " + absorbed + ", can be refreshed.").c_str())
+    {}
+};
+
+struct TestCommandException : public MetroException {
+    explicit TestCommandException(const string& commit, const string& log):
+            MetroException("The test command couldn't run on " + commit + ", see " + log)
+    {}
+};
+
+struct TransferException : public MetroException {
+    explicit TransferException(const string& message):
+        MetroException(message)
+    {}
+};
+
 struct UnsupportedOperationException : public MetroException {
     explicit UnsupportedOperationException(const char* message):
         MetroException(message)
@@ -0,0 +1,28 @@
+#pragma once
+
+namespace git {
+    class Blob {
+    private:
+        shared_ptr<git_blob> blob;
+
+    public:
+        explicit Blob(git_blob *blob) : blob(blob, git_blob_free) {}
+
+        explicit Blob(shared_ptr<git_blob> blob) : blob(std::move(blob)) {}
+
+        Blob() = delete;
+
+        Blob operator=(Blob b) = delete;
+
+        [[nodiscard]] shared_ptr<git_blob> ptr() const {
+            return blob;
+        }
+
+        [[nodiscard]] const char *rawcontent() const;
+
+        [[nodiscard]] size_t rawsize() const;
+
+        // View the blob's contents without copying them. The view keeps the blob alive.
+        [[nodiscard]] BlobView view() const;
+    };
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+namespace git {
+    // A read-only view of file contents that keeps the buffer it points into alive, so the contents never
+    // need to be copied. Copies of a view share the same buffer.
+    // Views of blobs borrow libgit2's decompressed object buffers, which are reference counted and pooled
+    // in the repo's object cache. Views of files on disk are memory-mapped where possible.
+    class BlobView {
+    private:
+        shared_ptr<const void> owner;
+        const char *start = nullptr;
+        size_t length = 0;
+
+    public:
+        BlobView() = default;
+
+        BlobView(shared_ptr<const void> owner, const char *start, size_t length) :
+                owner(std::move(owner)), start(start), length(length) {}
+
+        // Map the file at path into memory and view its contents.
+        static BlobView map_file(const string& path);
+
+        [[nodiscard]] const char *data() const {
+            return start;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return length;
+        }
+
+        [[nodiscard]] string_view view() const {
+            return string_view(start, length);
+        }
+    };
+}
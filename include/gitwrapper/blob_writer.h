@@ -0,0 +1,30 @@
+#pragma once
+
+namespace git {
+    // Writes a blob to the object database in chunks, so its contents never need to be held in memory at once.
+    class BlobWriter {
+    private:
+        git_writestream *stream;
+
+    public:
+        explicit BlobWriter(git_writestream *stream) : stream(stream) {}
+
+        BlobWriter() = delete;
+
+        BlobWriter(const BlobWriter&) = delete;
+
+        BlobWriter operator=(BlobWriter w) = delete;
+
+        ~BlobWriter() {
+            // Once committed the stream has already been freed.
+            if (stream != nullptr) {
+                stream->free(stream);
+            }
+        }
+
+        void write(const char *data, size_t size);
+
+        // Finish writing the blob, returning its ID.
+        OID commit();
+    };
+}
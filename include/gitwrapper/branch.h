@@ -19,5 +19,6 @@ namespace git {
         void delete_branch();
 
         [[nodiscard]] string reference_name() const;
+        [[nodiscard]] OID target() const;
     };
 }
\ No newline at end of file
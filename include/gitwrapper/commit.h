@@ -22,12 +22,21 @@ namespace git {
 
         [[nodiscard]] OID id() const;
 
+        // The author's signature, owned by the commit.
+        [[nodiscard]] const git_signature *author() const;
+
+        // The committer's time, in seconds since the Unix epoch.
+        [[nodiscard]] int64_t time() const;
+
         [[nodiscard]] Tree tree() const;
 
         [[nodiscard]] unsigned int parentcount() const;
 
         [[nodiscard]] Commit parent(unsigned int n) const;
 
+        // The ID of the nth parent, without looking the parent up. n must be less than parentcount().
+        [[nodiscard]] OID parent_id(unsigned int n) const;
+
         [[nodiscard]] vector<Commit> parents() const;
     };
 }
\ No newline at end of file
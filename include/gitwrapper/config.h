@@ -0,0 +1,25 @@
+#pragma once
+
+namespace git {
+    class Config {
+    private:
+        shared_ptr<git_config> config;
+
+    public:
+        explicit Config(git_config *config) : config(config, git_config_free) {}
+
+        Config() = delete;
+
+        Config operator=(Config c) = delete;
+
+        [[nodiscard]] shared_ptr<git_config> ptr() const {
+            return config;
+        }
+
+        // Open a file in git config format that isn't part of a repo's config, such as .lfsconfig.
+        static Config open_file(const string& path);
+
+        // Get the value of a config variable. Returns false if it isn't set.
+        bool get_string(const string& name, string& out) const;
+    };
+}
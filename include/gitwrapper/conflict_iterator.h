@@ -15,6 +15,23 @@ namespace git {
         Conflict(const git_index_entry *ancestor, const git_index_entry *ours, const git_index_entry *theirs):
             ancestor(ancestor), ours(ours), theirs(theirs)
         {}
+
+        // The path of the conflicted file, taken from whichever side has it.
+        [[nodiscard]] const char *path() const {
+            return ours != nullptr? ours->path : theirs != nullptr? theirs->path : ancestor->path;
+        }
+
+        // Append the index entries of each side of the conflict to out, with their conflict stages set.
+        void append_entries(vector<git_index_entry>& out) const {
+            const git_index_entry *stages[3] = {ancestor, ours, theirs};
+            for (int stage = 0; stage < 3; stage++) {
+                if (stages[stage] != nullptr) {
+                    git_index_entry entry = *stages[stage];
+                    GIT_INDEX_ENTRY_STAGE_SET(&entry, stage + 1);
+                    out.push_back(entry);
+                }
+            }
+        }
     };
 
     // Conflict that contains the backing data within itself, rather than referencing memory controlled by a git index.
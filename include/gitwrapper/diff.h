@@ -0,0 +1,27 @@
+#pragma once
+
+namespace git {
+    class Diff {
+    private:
+        shared_ptr<git_diff> diff;
+
+    public:
+        explicit Diff(git_diff *diff) : diff(diff, git_diff_free) {}
+
+        Diff() = delete;
+
+        Diff operator=(Diff d) = delete;
+
+        [[nodiscard]] shared_ptr<git_diff> ptr() const {
+            return diff;
+        }
+
+        [[nodiscard]] size_t num_deltas() const {
+            return git_diff_num_deltas(diff.get());
+        }
+
+        [[nodiscard]] const git_diff_delta *get_delta(size_t n) const {
+            return git_diff_get_delta(diff.get(), n);
+        }
+    };
+}
@@ -20,13 +20,31 @@ namespace git {
         }
 
         void add_all(StrArray pathspec, unsigned int flags, MatchedPathCallback callback);
+        void add(const git_index_entry& entry);
+        void add_bypath(const string& path);
+        // Replace the contents of the index with the tree. The entries get no stat data.
+        void read_tree(const Tree& tree);
+        // Remove all entries for the path, including any conflicts.
+        void remove_bypath(const string& path);
         OID write_tree();
         void write();
 
+        // Replace every entry for the given paths, at any stage, with the new entries.
+        // Rather than inserting the entries one at a time, the index is rebuilt in sorted order
+        // and swapped in, so the cost doesn't grow with the product of the number of changes and the index size.
+        // The stage of each new entry is taken from its flags.
+        void replace_entries(const set<string>& paths, vector<git_index_entry> entries);
+
         [[nodiscard]] ConflictIterator conflict_iterator() const;
+        // Call the callback with each conflict in path order, in a single pass over the entries.
+        // The conflict's entries are only valid during the callback, and the index must not be changed meanwhile.
+        void for_each_conflict(const function<void(const Conflict&)>& callback) const;
         [[nodiscard]] size_t entrycount() const;
+        [[nodiscard]] const git_index_entry *get_byindex(size_t n) const;
 
         void add_conflict(const Conflict& conflict) const;
+        // Add all the conflicts at once, replacing any existing entries for their paths.
+        void add_conflicts(const vector<StandaloneConflict>& conflicts);
         void cleanup_conflicts() const;
         [[nodiscard]] bool has_conflicts() const;
     };
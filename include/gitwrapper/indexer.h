@@ -0,0 +1,34 @@
+#pragma once
+
+namespace git {
+    // Writes a pack streamed to it into a pack directory, along with the index that lets it be read.
+    class Indexer {
+    private:
+        shared_ptr<git_indexer> indexer;
+
+    public:
+        explicit Indexer(git_indexer *indexer) : indexer(indexer, git_indexer_free) {}
+
+        Indexer() = delete;
+
+        Indexer operator=(Indexer i) = delete;
+
+        [[nodiscard]] shared_ptr<git_indexer> ptr() const {
+            return indexer;
+        }
+
+        // Start indexing a new pack, which will be written to packDir.
+        static Indexer open(const string& packDir);
+
+        // Add the next bytes of the pack.
+        void append(const char *data, size_t size) const;
+
+        // Check the whole pack has been added and write it and its index.
+        void commit() const;
+
+        // The name of the written pack, the hash that follows "pack-" in its file names.
+        [[nodiscard]] string name() const {
+            return string(git_indexer_name(indexer.get()));
+        }
+    };
+}
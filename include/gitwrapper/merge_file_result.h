@@ -0,0 +1,44 @@
+#pragma once
+
+namespace git {
+    // The result of a three-way merge of a single file's contents.
+    class MergeFileResult {
+    private:
+        shared_ptr<git_merge_file_result> result;
+
+    public:
+        explicit MergeFileResult(git_merge_file_result *result) : result(result, [](git_merge_file_result *r) {
+            git_merge_file_result_free(r);
+            delete r;
+        }) {}
+
+        MergeFileResult() = delete;
+
+        [[nodiscard]] shared_ptr<git_merge_file_result> ptr() const {
+            return result;
+        }
+
+        // Three-way merge the contents of a file. ancestor may be null if the file has no common ancestor.
+        static MergeFileResult merge(const git_merge_file_input *ancestor, const git_merge_file_input& ours,
+                                     const git_merge_file_input& theirs, const git_merge_file_options& options);
+
+        // True if the file merged without conflicts.
+        [[nodiscard]] bool automergeable() const {
+            return result->automergeable;
+        }
+
+        // The merged file mode, or 0 if the modes conflicted.
+        [[nodiscard]] unsigned int mode() const {
+            return result->mode;
+        }
+
+        // The merged contents, including conflict markers if the merge was not clean.
+        [[nodiscard]] const char *content() const {
+            return result->ptr;
+        }
+
+        [[nodiscard]] size_t size() const {
+            return result->len;
+        }
+    };
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+namespace git {
+    class OdbObject {
+    private:
+        shared_ptr<git_odb_object> object;
+
+    public:
+        explicit OdbObject(git_odb_object *object) : object(object, git_odb_object_free) {}
+
+        OdbObject() = delete;
+
+        [[nodiscard]] shared_ptr<git_odb_object> ptr() const {
+            return object;
+        }
+
+        [[nodiscard]] const char *data() const {
+            return static_cast<const char*>(git_odb_object_data(object.get()));
+        }
+
+        [[nodiscard]] size_t size() const {
+            return git_odb_object_size(object.get());
+        }
+
+        [[nodiscard]] git_object_t type() const {
+            return git_odb_object_type(object.get());
+        }
+    };
+
+    class ODB {
+    private:
+        shared_ptr<git_odb> odb;
+
+    public:
+        explicit ODB(git_odb *odb) : odb(odb, git_odb_free) {}
+
+        ODB() = delete;
+
+        ODB operator=(ODB o) = delete;
+
+        [[nodiscard]] shared_ptr<git_odb> ptr() const {
+            return odb;
+        }
+
+        // Open an object database containing only the loose objects and packs in objectsDir,
+        // ignoring any alternates it lists.
+        static ODB open_directory(const string& objectsDir);
+
+        // Add a backend for the loose objects in objectsDir.
+        // New objects are written to the writable backend with the highest priority.
+        void add_loose_backend(const string& objectsDir, int priority) const;
+
+        [[nodiscard]] bool exists(const OID& id) const;
+        [[nodiscard]] OdbObject read(const OID& id) const;
+        // The size of an object, read from its header without inflating it.
+        [[nodiscard]] size_t read_size(const OID& id) const;
+        // The type and size of an object, read from its header without inflating it.
+        void read_header(const OID& id, git_object_t& type, size_t& size) const;
+        OID write(const char *data, size_t size, git_object_t type) const;
+        // The ID an object with the given contents would have, without writing it.
+        static OID hash(const char *data, size_t size, git_object_t type);
+
+        void foreach(const function<void(const OID&)>& callback) const;
+    };
+}
@@ -7,6 +7,8 @@ namespace git {
     public:
         git_oid oid;
 
+        OID() : oid() {}
+
         explicit OID(git_oid oid) : oid(oid) {}
 
         [[nodiscard]] string str() const {
@@ -14,5 +16,26 @@ namespace git {
             git_oid_tostr(out, OID_LENGTH, &oid);
             return string(out);
         }
+
+        bool operator==(const OID& other) const {
+            return git_oid_equal(&oid, &other.oid);
+        }
+
+        bool operator!=(const OID& other) const {
+            return !(*this == other);
+        }
+
+        bool operator<(const OID& other) const {
+            return git_oid_cmp(&oid, &other.oid) < 0;
+        }
+    };
+
+    // Hashes an OID for unordered containers. IDs are already uniformly distributed, so their first bytes will do.
+    struct OIDHash {
+        size_t operator()(const OID& id) const {
+            size_t hash;
+            memcpy(&hash, id.oid.id, sizeof(hash));
+            return hash;
+        }
     };
 }
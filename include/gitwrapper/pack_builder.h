@@ -0,0 +1,39 @@
+#pragma once
+
+namespace git {
+    class PackBuilder {
+    private:
+        shared_ptr<git_packbuilder> builder;
+
+    public:
+        explicit PackBuilder(git_packbuilder *builder) : builder(builder, git_packbuilder_free) {}
+
+        PackBuilder() = delete;
+
+        PackBuilder operator=(PackBuilder p) = delete;
+
+        [[nodiscard]] shared_ptr<git_packbuilder> ptr() const {
+            return builder;
+        }
+
+        void insert(const OID& id) const;
+
+        // Insert an object along with everything it refers to.
+        void insert_recursive(const OID& id) const;
+
+        // Insert a commit along with its tree and everything in it.
+        void insert_commit(const OID& id) const;
+
+        [[nodiscard]] size_t object_count() const {
+            return git_packbuilder_object_count(builder.get());
+        }
+
+        // Write the pack and its index to the given pack directory.
+        void write(const string& packDir) const;
+
+        // The name of the written pack, the hash that follows "pack-" in its file names.
+        [[nodiscard]] string name() const {
+            return string(git_packbuilder_name(builder.get()));
+        }
+    };
+}
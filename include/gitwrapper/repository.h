@@ -1,6 +1,10 @@
 #pragma once
 
 namespace git {
+    // A repo can be shared between threads for reading: looking up objects, diffing trees and merging them in memory.
+    // libgit2 loads a repo's ODB, config and refs atomically and locks its object cache and ODB. Anything that
+    // changes the repo or its working directory, such as checkouts, status and the index, must stay on one thread,
+    // as must the objects made from a repo, such as an Index or a RevWalk.
     class Repository {
     private:
         explicit Repository(git_repository *repo) : repo(repo, git_repository_free) {}
@@ -19,10 +23,24 @@ namespace git {
         static bool exists(const string& path);
 
         [[nodiscard]] string path() const;
+        [[nodiscard]] string workdir() const;
+        // Returns true if the path, relative to the working directory, is ignored by .gitignore rules.
+        [[nodiscard]] bool is_ignored(const string& path) const;
         [[nodiscard]] Signature &default_signature() const;
         [[nodiscard]] Index index() const;
+        [[nodiscard]] ODB odb() const;
+        [[nodiscard]] Config config() const;
 
         [[nodiscard]] Tree lookup_tree(const OID &oid) const;
+        [[nodiscard]] Commit lookup_commit(const OID &oid) const;
+        [[nodiscard]] Blob lookup_blob(const OID &oid) const;
+        OID create_blob(const char *data, size_t size) const;
+        // Write the file at path, relative to the working directory, as a blob, applying any filters.
+        OID create_blob_from_workdir(const string& path) const;
+        // The ID create_blob_from_workdir would give the file at path, without writing it.
+        [[nodiscard]] OID hash_workdir_file(const string& path) const;
+        [[nodiscard]] unique_ptr<BlobWriter> create_blob_writer() const;
+        OID create_updated_tree(const Tree& baseline, const vector<git_tree_update>& updates) const;
         Branch lookup_branch(const string& name, git_branch_t branchType) const;
         [[nodiscard]] AnnotatedCommit lookup_annotated_commit(const OID& id) const;
         OID create_commit(const string& update_ref, const Signature &author, const Signature &committer,
@@ -35,17 +53,38 @@ namespace git {
         void create_branch(const string& branch_name, Commit &target, bool force) const;
 
         [[nodiscard]] BranchIterator new_branch_iterator(const git_branch_t& flags) const;
+        // The objects every direct reference in the repo points to, such as branches, tags and stashes.
+        [[nodiscard]] vector<OID> reference_targets() const;
+        [[nodiscard]] RevWalk new_revwalk() const;
+        [[nodiscard]] PackBuilder new_packbuilder() const;
 
         [[nodiscard]] StatusList new_status_list(const git_status_options& options) const;
 
         void set_head(const string& name) const;
+        void set_head_detached(const OID& commit) const;
+
+        // Paths of the repo's submodules, relative to the working directory.
+        [[nodiscard]] vector<string> submodule_paths() const;
 
         void checkout_tree(const Tree& tree, const git_checkout_options& options) const;
 
+        // Add a linked worktree at path. A branch with the worktree's name is created at HEAD and checked out in it.
+        void add_worktree(const string& name, const string& path) const;
+        // Remove what the repo knows of the named linked worktree, if it has one. The working tree itself is left alone.
+        void prune_worktree(const string& name) const;
+        // Open each of the repo's linked worktrees that still exists.
+        [[nodiscard]] vector<Repository> worktrees() const;
+
         void cleanup_state() const;
 
         [[nodiscard]] git_merge_analysis_t merge_analysis(const vector<AnnotatedCommit>& sources) const;
         void merge(const vector<AnnotatedCommit>& sources, const git_merge_options& merge_opts, const git_checkout_options& checkout_opts) const;
+        [[nodiscard]] OID merge_base(const OID& one, const OID& two) const;
+        // Merge the trees in memory, returning an index of the result with any conflicts.
+        [[nodiscard]] Index merge_trees(const Tree& ancestor, const Tree& ours, const Tree& theirs,
+                                        const git_merge_options& options) const;
+
+        [[nodiscard]] Diff diff_tree_to_tree(const Tree& oldTree, const Tree& newTree, const git_diff_options& options) const;
     };
 
 }
\ No newline at end of file
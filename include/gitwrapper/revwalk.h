@@ -0,0 +1,28 @@
+#pragma once
+
+namespace git {
+    class RevWalk {
+    private:
+        shared_ptr<git_revwalk> walk;
+
+    public:
+        explicit RevWalk(git_revwalk *walk) : walk(walk, git_revwalk_free) {}
+
+        RevWalk() = delete;
+
+        RevWalk operator=(RevWalk w) = delete;
+
+        [[nodiscard]] shared_ptr<git_revwalk> ptr() const {
+            return walk;
+        }
+
+        void push(const OID& id) const;
+        void hide(const OID& id) const;
+        void sorting(unsigned int mode) const;
+        // Only follow the first parent of each commit.
+        void simplify_first_parent() const;
+
+        // Get the next commit in the walk. Returns false once all commits have been walked.
+        bool next(OID& out) const;
+    };
+}
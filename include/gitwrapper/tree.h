@@ -1,6 +1,28 @@
 #pragma once
 
 namespace git {
+    class TreeEntry {
+    private:
+        shared_ptr<git_tree_entry> entry;
+
+    public:
+        explicit TreeEntry(git_tree_entry *entry) : entry(entry, git_tree_entry_free) {}
+
+        TreeEntry() = default;
+
+        [[nodiscard]] shared_ptr<git_tree_entry> ptr() const {
+            return entry;
+        }
+
+        [[nodiscard]] OID id() const {
+            return OID(*git_tree_entry_id(entry.get()));
+        }
+
+        [[nodiscard]] git_filemode_t filemode() const {
+            return git_tree_entry_filemode(entry.get());
+        }
+    };
+
     class Tree {
     private:
         shared_ptr<git_tree> tree;
@@ -17,5 +39,22 @@ namespace git {
         [[nodiscard]] shared_ptr<git_tree> ptr() const {
             return tree;
         }
+
+        [[nodiscard]] OID id() const {
+            return OID(*git_tree_id(tree.get()));
+        }
+
+        [[nodiscard]] size_t entrycount() const {
+            return git_tree_entrycount(tree.get());
+        }
+
+        // The entry at index n, owned by this tree.
+        [[nodiscard]] const git_tree_entry *entry_byindex(size_t n) const {
+            return git_tree_entry_byindex(tree.get(), n);
+        }
+
+        // Find the entry at the given path relative to this tree, including in subtrees.
+        // Returns false if there is no entry at that path.
+        bool entry_bypath(const string& path, TreeEntry &out) const;
     };
-}
\ No newline at end of file
+}
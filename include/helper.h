@@ -6,4 +6,23 @@ void split_at_first(string const& str, char const& c, string & before, string &
 
 string read_all(const string& path);
 
-void write_all(const string& text, const string& path);
\ No newline at end of file
+void write_all(const string& text, const string& path);
+
+// Write the data to the file at path by writing a temporary file then renaming it over path,
+// so that readers never see a partly written file.
+void write_all_atomic(const string& data, const string& path);
+
+// Append value to out as a little-endian base-128 varint.
+void append_varint(string& out, uint64_t value);
+
+// Read a varint written by append_varint from data at pos, advancing pos past it.
+// Throws an exception if the data ends before the varint does.
+uint64_t read_varint(const string& data, size_t& pos);
+
+// Parse a length of time given as a number followed by a unit: s, m, h, d or w.
+// Returns false if text isn't in that form.
+bool parse_duration(const string& text, int64_t& seconds);
+
+// Parse a point in time given either as a local date, YYYY-MM-DD, or as a duration before now.
+// Returns false if text is in neither form.
+bool parse_time(const string& text, int64_t& time);
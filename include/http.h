@@ -0,0 +1,22 @@
+struct HttpRequest {
+    string method = "GET";
+    // An http:// or https:// URL. Credentials in the URL are sent with basic authentication.
+    string url;
+    map<string, string> headers;
+    string body;
+    // If set, the body is streamed from this file instead, so that large uploads aren't read into memory.
+    string bodyPath;
+};
+
+struct HttpResponse {
+    int status = 0;
+    // Header names are lowercase.
+    map<string, string> headers;
+    string body;
+};
+
+// Send a request and wait for the whole response, following redirects, except from HTTPS to plain HTTP.
+// If out is given the response body is written to it instead of to the response, so large downloads
+// aren't held in memory. Each request uses its own connection, so requests can be made from several threads.
+// Throws a TransferException if the server can't be reached or the response is malformed.
+HttpResponse http_request(const HttpRequest& request, ostream *out = nullptr);
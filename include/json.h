@@ -0,0 +1,20 @@
+// A parsed JSON value. Only the member for the value's type is set.
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+
+    Type type = Null;
+    bool boolean = false;
+    double number = 0;
+    string text;
+    vector<JsonValue> items;
+    map<string, JsonValue> fields;
+
+    // The member of an object with the given name, or a null value if there is none or this isn't an object.
+    const JsonValue& operator[](const string& name) const;
+};
+
+// Parse a JSON document. Throws an exception if it isn't valid JSON.
+JsonValue parse_json(const string& text);
+
+// Quote and escape text as a JSON string.
+string json_quote(const string& text);
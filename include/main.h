@@ -9,11 +9,33 @@ Command *allCommands[] = {
         &switchCmd,
         &info,
         &absorbCmd,
-        &resolve
+        &resolve,
+        &import,
+        &watchEvents,
+        &share,
+        &prewarmCmd,
+        &perf,
+        &bisectCmd,
+        &indexCmd,
+        &logCmd,
+        &stats,
+        &lfs,
+        &trim,
+        &repack,
+        &conflicts
 };
 
 const Option ALL_OPTIONS[] = {
         {"help", "h", false},
         {"timeout", "t", true},
-        {"force", "f", false}
+        {"force", "f", false},
+        {"refresh", "r", false},
+        {"checkout", "c", false},
+        {"window", "w", true},
+        {"jobs", "j", true},
+        {"author", "a", true},
+        {"since", "s", true},
+        {"grep", "g", true},
+        {"keep", "k", true},
+        {"depth", "d", true}
 };
\ No newline at end of file
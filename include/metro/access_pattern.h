@@ -0,0 +1,34 @@
+namespace metro {
+    // How an operation is going to read the object database.
+    enum class AccessPattern {
+        // Reads most of the objects it needs in pack order, e.g. checkout.
+        Sequential,
+        // Jumps between a few objects in many places, e.g. merges and history walks.
+        Random,
+        // Hardly touches packed objects, e.g. status and commit.
+        Minimal,
+        // Will soon read the objects it is about to touch, e.g. prewarming.
+        WillNeed
+    };
+
+    // Declares the access pattern of the operation for the lifetime of the scope, tuning libgit2's pack
+    // mapping windows to it and asking the kernel to read ahead the pack files that the pattern will need.
+    // libgit2's settings are process-wide, so only the outermost scope sets them, and they are restored when
+    // the last open scope ends, in whatever order scopes on different threads end. Scopes opened on task
+    // workers leave everything to the operation that started the tasks.
+    class AccessPatternScope {
+    private:
+        static atomic<bool> disabled;
+        bool counted = false;
+
+    public:
+        AccessPatternScope(const Repository& repo, AccessPattern pattern);
+        ~AccessPatternScope();
+
+        AccessPatternScope(const AccessPatternScope&) = delete;
+        AccessPatternScope& operator=(const AccessPatternScope&) = delete;
+
+        // Make every scope from now on do nothing, to measure how much the hints help.
+        static void disable();
+    };
+}
@@ -0,0 +1,22 @@
+namespace metro {
+    enum class BisectResult {
+        Good,
+        Bad,
+        Skip
+    };
+
+    // Find the commit that introduced a failure of the test command, between a good and a bad commit.
+    // Only the first parent of each commit is followed, so a merged branch is tested as a whole at its merge.
+    //
+    // Up to jobs candidate commits are checked out at once, into a pool of linked worktrees kept in .git/metro/bisect,
+    // and the test command is run in each concurrently. Each round splits the remaining range into jobs + 1 parts,
+    // so the search takes log_(jobs+1) rounds. The test's exit code decides the result: 0 is good,
+    // 125 means the commit can't be tested and is skipped, and any other code up to 127 is bad.
+    // Throws a TestCommandException if the test command couldn't run.
+    //
+    // onResult is called with each tested commit and its result as soon as each round finishes.
+    // Returns the commits that could be the first bad one, oldest first. This is a single commit,
+    // unless commits next to it had to be skipped.
+    vector<OID> bisect(const Repository& repo, const string& good, const string& bad, const vector<string>& command,
+                       unsigned int jobs, const function<void(const OID&, BisectResult)>& onResult);
+}
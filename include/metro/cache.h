@@ -0,0 +1,56 @@
+#define DEFAULT_QUERY_CACHE_SIZE (1024 * 1024)
+
+namespace metro {
+    // Kinds of query whose results can be memoized in a QueryCache.
+    // The values are stored on disk, so existing kinds must never be renumbered.
+    enum class QueryKind : uint8_t {
+        MergeAnalysis = 1,
+        MergeBase = 2,
+        MergeConflicts = 3
+    };
+
+    // Persistent memoization cache for read-only queries on immutable objects, stored in .git/metro/cache.
+    // Entries are keyed by the query kind, the OIDs of its inputs and a hash of any options affecting the result,
+    // so a stored result can never go stale. If the cache has grown past maxBytes when it is saved,
+    // the least recently used entries are evicted.
+    class QueryCache {
+    private:
+        struct Entry {
+            string value;
+            uint64_t lastUsed;
+        };
+
+        string path;
+        size_t maxBytes;
+        map<string, Entry> entries;
+        uint64_t clock = 0;
+        bool dirty = false;
+
+        void load();
+
+    public:
+        explicit QueryCache(const Repository& repo, size_t maxBytes = DEFAULT_QUERY_CACHE_SIZE);
+
+        // If a result is cached for the query, stores it in value and returns true.
+        bool get(QueryKind kind, const vector<OID>& inputs, uint64_t options, string& value);
+
+        void put(QueryKind kind, const vector<OID>& inputs, uint64_t options, const string& value);
+
+        // Write the cache back to disk if an entry has been added. The recency of entries that were only read is
+        // kept in memory until then.
+        void save();
+    };
+
+    // Delete every cached query result, for when commits they may refer to are removed from the repo.
+    void clear_query_cache(const Repository& repo);
+
+    // The merge analysis of merging other into head, memoized in the query cache.
+    // head must be the commit currently at HEAD.
+    git_merge_analysis_t cached_merge_analysis(const Repository& repo, const OID& head, const OID& other);
+
+    // The best common ancestor of the two commits, memoized in the query cache.
+    OID cached_merge_base(const Repository& repo, const OID& one, const OID& two);
+
+    // The same, looked up in and added to an open cache, which the caller saves.
+    OID cached_merge_base(const Repository& repo, QueryCache& cache, const OID& one, const OID& two);
+}
@@ -0,0 +1,47 @@
+namespace metro {
+    // How often a file or directory has changed and conflicted.
+    struct PathChurn {
+        // The number of commits that changed the path, or anything under it for a directory.
+        uint32_t changes = 0;
+        // The number of times the path conflicted during an absorb.
+        uint32_t conflicts = 0;
+        // The number of changes by each author, as "Name <email>".
+        map<string, uint32_t> authors;
+    };
+
+    // Change statistics for the history of the repo, stored in .git/metro/churn.
+    // Commits are read in the order of the commit index, so an update only diffs the commits indexed since the
+    // last one. Merge commits are skipped, since their changes were already counted on the merged branch.
+    class ChurnStats {
+    private:
+        string path;
+        // The number of commit index positions already counted, and the ID of the last one,
+        // to tell if the commit index was rebuilt since.
+        size_t processed = 0;
+        OID lastProcessed;
+        // Files, and directories with a trailing slash.
+        map<string, PathChurn> paths;
+        // The number of commits that changed both files of each pair, the first ordered before the second.
+        map<pair<string, string>, uint32_t> pairs;
+        bool dirty = false;
+
+        void load();
+        void clear();
+        void add_commit(const Repository& repo, const Commit& commit, const Tree& emptyTree);
+        void add_conflicts(const Repository& repo);
+
+    public:
+        explicit ChurnStats(const Repository& repo);
+
+        // Count the commits added to the index since the last update and the conflicts recorded since,
+        // then write the stats back to disk if they changed.
+        void update(const Repository& repo, const CommitIndex& index);
+
+        [[nodiscard]] const map<string, PathChurn>& path_stats() const;
+
+        [[nodiscard]] const map<pair<string, string>, uint32_t>& co_changes() const;
+    };
+
+    // Record that the given paths conflicted during an absorb, to be counted by the next churn update.
+    void record_conflicts(const Repository& repo, const vector<string>& paths);
+}
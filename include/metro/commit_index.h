@@ -0,0 +1,61 @@
+namespace metro {
+    // A filter for commit history. Empty fields match every commit.
+    struct LogQuery {
+        // Text the author's "Name <email>" must contain, ignoring case.
+        string author;
+        // The earliest commit time to include, in seconds since the Unix epoch.
+        int64_t since = INT64_MIN;
+        // Text the commit message must contain, ignoring case.
+        string grep;
+    };
+
+    // A columnar index of commit metadata, stored in .git/metro/commit-index, for filtering history
+    // without inflating every commit.
+    // Commits are numbered by their position in a topological order, parents first, and each column is a
+    // parallel array indexed by position: commit ID, dictionary-encoded author, commit time and parents.
+    // Message tokens are kept in an inverted index of delta-encoded positions.
+    // New commits are appended to a journal as they are made and folded into the index when it is next updated.
+    class CommitIndex {
+    private:
+        string path;
+        vector<OID> ids;
+        vector<uint32_t> authors;
+        vector<int64_t> times;
+        // The parents of the commit at position i are parents[parentStarts[i]] to parents[parentStarts[i + 1]].
+        vector<uint32_t> parentStarts {0};
+        vector<uint32_t> parents;
+        // Each distinct author's "Name <email>", indexed by author ID.
+        vector<string> authorNames;
+        map<string, uint32_t> authorIds;
+        // The positions of the commits whose messages contain each token, in ascending order.
+        map<string, vector<uint32_t>> postings;
+        map<OID, uint32_t> positions;
+        bool dirty = false;
+
+        void load();
+        void load_journal();
+        // Append a commit whose parents are already in the index.
+        void append(const OID& id, const vector<OID>& parentIds, const string& author, int64_t time, const string& message);
+        [[nodiscard]] vector<uint8_t> reachable_from(uint32_t position) const;
+        [[nodiscard]] vector<uint8_t> grep_candidates(const string& text) const;
+
+    public:
+        explicit CommitIndex(const Repository& repo);
+
+        // Add every commit reachable from a local branch or HEAD that isn't indexed yet, then write the index
+        // back to disk if it changed.
+        void update(const Repository& repo);
+
+        // The IDs of the commits reachable from HEAD that match the query, newest first.
+        // Only message matches need the commit itself, to check candidates the token index can't rule out.
+        [[nodiscard]] vector<OID> query(const Repository& repo, const LogQuery& query) const;
+
+        [[nodiscard]] size_t size() const;
+
+        // The ID of the commit at position. Commits keep their positions as more are added.
+        [[nodiscard]] OID id(size_t position) const;
+    };
+
+    // Record a new commit in the commit index's journal, without reading the index.
+    void record_commit(const Repository& repo, const Commit& commit);
+}
@@ -0,0 +1,34 @@
+namespace metro {
+    // What merging two branches would do.
+    struct BranchPairConflicts {
+        // The positions of the two branches in ConflictMatrix::branches.
+        size_t first;
+        size_t second;
+        // The number of files both branches changed since their merge base.
+        size_t sharedPaths;
+        // Whether the branches were merged. Branches that share no changed files can't conflict, so they aren't.
+        bool merged;
+        vector<string> conflicts;
+
+        // The share of the files both branches changed that conflict, from 0 to 1.
+        [[nodiscard]] double likelihood() const {
+            return sharedPaths == 0? 0 : (double) conflicts.size() / sharedPaths;
+        }
+    };
+
+    struct ConflictMatrix {
+        vector<string> branches;
+        // Every pair of branches, in order of their first then second branch.
+        vector<BranchPairConflicts> pairs;
+        // The number of pairs merged, and how many of those results came from the query cache.
+        size_t merges;
+        size_t cachedMerges;
+    };
+
+    // Work out which of the given branches would conflict with each other when merged.
+    // The files each branch changed since its merge base with the other are found first, with each distinct
+    // branch and merge base diffed only once, and only pairs that changed some of the same files are merged.
+    // Those merges are done in memory, in parallel on the task runtime, and their results are kept in the
+    // query cache, so pairs of branches that haven't moved aren't merged again.
+    ConflictMatrix conflict_matrix(const Repository& repo, const vector<string>& branches);
+}
@@ -0,0 +1,33 @@
+// Git's delta format can copy any run of bytes from the base, but only runs of at least this many are looked for.
+#define DELTA_BLOCK_SIZE 16
+// How many places in the base with the same block hash are checked for the longest match.
+#define DELTA_MAX_CANDIDATES 16
+
+namespace metro {
+    // An index of the blocks in an object, for encoding other objects as deltas against it.
+    // The object's data must outlive the index.
+    class DeltaIndex {
+    private:
+        const char *base;
+        size_t baseSize;
+        uint32_t mask;
+        // For each hash bucket, one more than the last block with that hash, or 0 if there is none.
+        vector<uint32_t> heads;
+        // For each block, one more than the previous block in the same bucket, or 0 if there is none.
+        vector<uint32_t> chains;
+
+    public:
+        DeltaIndex(const char *base, size_t size);
+
+        DeltaIndex(const DeltaIndex&) = delete;
+        DeltaIndex& operator=(const DeltaIndex&) = delete;
+
+        [[nodiscard]] size_t size() const {
+            return baseSize;
+        }
+
+        // Encode target in git's delta format, as instructions to copy runs of the base and insert new bytes.
+        // Returns false, leaving out unspecified, if the delta would be bigger than maxSize.
+        bool create_delta(const char *target, size_t size, size_t maxSize, string& out) const;
+    };
+}
@@ -0,0 +1,27 @@
+namespace metro {
+    // Metro commits everything in the working directory, so the index is only ever used as a stat cache.
+    // With the index disabled, commits and status checks hash the working directory against Metro's own
+    // stat cache and build trees directly, and the index is left out of date until something needs it.
+
+    // Whether the index is disabled in the repo.
+    bool index_disabled(const Repository& repo);
+
+    // Stop keeping the index up to date, using Metro's stat cache instead.
+    void disable_index(const Repository& repo);
+
+    // Bring the index up to date and go back to keeping it that way.
+    void enable_index(const Repository& repo);
+
+    // If the index is out of date, rebuild it from HEAD's tree with stat data from Metro's stat cache,
+    // so that git sees the files that haven't changed since the last commit as unchanged.
+    // Any merge conflicts in the index are kept.
+    // Anything that uses the index must call this first.
+    void ensure_index(const Repository& repo);
+
+    // Record that the index no longer matches HEAD. Does nothing unless the index is disabled.
+    void mark_index_stale(const Repository& repo);
+
+    // The ID of the tree of the working directory's current contents, excluding ignored files, built without the index.
+    // If write is true, the tree and the blobs of changed files are written to the object database.
+    OID workdir_tree(const Repository& repo, bool write);
+}
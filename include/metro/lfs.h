@@ -0,0 +1,62 @@
+// Pointer files are small; anything bigger is never read to check if it is one.
+#define LFS_MAX_POINTER_SIZE 1024
+// The most LFS objects transferred at once.
+#define LFS_TRANSFER_JOBS 8
+// How much of a cached object the lfs filter passes on to the next filter at a time.
+#define LFS_STREAM_CHUNK_SIZE (1024*1024)
+
+namespace metro {
+    // A Git LFS pointer: the small file committed in place of a large file, naming its content by SHA-256.
+    struct LfsPointer {
+        // The SHA-256 of the content, in hex.
+        string oid;
+        uint64_t size;
+    };
+
+    // Parse file contents as an LFS pointer. Returns false if they aren't one.
+    bool parse_lfs_pointer(const char *data, size_t size, LfsPointer& out);
+
+    string format_lfs_pointer(const LfsPointer& pointer);
+
+    // The path of an object in the repo's LFS cache, .git/lfs/objects, which is laid out as git-lfs does.
+    string lfs_object_path(const string& gitDir, const string& oid);
+
+    // Register the lfs filter with libgit2, so that files with the filter=lfs attribute are stored in the LFS
+    // cache and committed as pointers, and pointers are replaced with the cached contents on checkout.
+    // A pointer whose object isn't cached or being downloaded is checked out as is.
+    void register_lfs_filter();
+
+    // Downloads, started before a checkout, of the LFS objects it will need that aren't cached yet.
+    // They run on the task runtime while the checkout writes other files, in path order so that the objects
+    // the checkout reaches first arrive first. The lfs filter waits for an object being downloaded rather than
+    // leaving its pointer. Only one prefetch can be active at a time.
+    class LfsPrefetch {
+    private:
+        string gitDir;
+        mutex lock;
+        map<string, shared_future<bool>> downloads;
+        unique_ptr<TaskGroup> group;
+        size_t failed = 0;
+
+    public:
+        LfsPrefetch(const Repository& repo, const Tree& from, const Tree& to);
+
+        ~LfsPrefetch();
+
+        LfsPrefetch(const LfsPrefetch&) = delete;
+        LfsPrefetch& operator=(const LfsPrefetch&) = delete;
+
+        // If the object is being downloaded, wait for it and return whether it arrived.
+        bool wait_for(const string& oid);
+
+        // Wait for every download to finish. Returns the number that failed.
+        size_t finish();
+    };
+
+    // Download the LFS objects the tree points to that aren't cached, and replace any pointer files left in
+    // the working directory for them with their contents. Returns the number of objects downloaded.
+    size_t lfs_fetch(const Repository& repo, const Tree& tree);
+
+    // Upload the LFS objects the tree points to that the server doesn't have. Returns the number uploaded.
+    size_t lfs_push(const Repository& repo, const Tree& tree);
+}
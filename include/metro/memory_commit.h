@@ -0,0 +1,41 @@
+namespace metro {
+    // Builds a commit from file contents supplied by the caller rather than read from the working directory.
+    // The files are layered on top of HEAD's tree: blobs are written straight to the object database and
+    // subtrees without any changed files are reused as they are, so neither the working directory
+    // nor the index is touched.
+    class MemoryCommit {
+    private:
+        struct Change {
+            bool remove;
+            git_oid id;
+            git_filemode_t mode;
+        };
+
+        Repository repo;
+        map<string, Change> changes;
+        shared_ptr<Tree> baseTree;
+        shared_ptr<Tree> newTree;
+
+    public:
+        explicit MemoryCommit(const Repository& repo) : repo(repo) {
+            attach_shared_store(repo);
+        }
+
+        // Set the contents of the file at path, relative to the repo root.
+        void write(const string& path, const char *data, size_t size, git_filemode_t mode = GIT_FILEMODE_BLOB);
+
+        // Set the contents of the file at path to the next size bytes read from input,
+        // writing them to the object database as they are read.
+        void write(const string& path, istream& input, size_t size, git_filemode_t mode = GIT_FILEMODE_BLOB);
+
+        void remove(const string& path);
+
+        // Commit the changes on top of HEAD, moving the current branch to the new commit.
+        // Returns the ID of the new commit.
+        OID commit(const string& message);
+
+        // After committing, update the changed files in the working directory and index to match the new commit.
+        // Files that had been modified in the working directory are left alone.
+        void update_workdir() const;
+    };
+}
@@ -7,10 +7,23 @@ namespace metro {
     // Get the commit ID of the merge head. Assumes a merge is ongoing.
     string merge_head_id(const Repository& repo);
 
+    // The name of the branch the given branch is absorbing, as recorded when the absorb started.
+    // Returns false if none is recorded.
+    bool absorbed_branch(const Repository& repo, const string& branch, string& out);
+
     void start_merge(const Repository& repo, const string& sourceName);
 
     // Create a commit of the ongoing merge and clear the merge state and conflicts from the repo.
     void resolve(const Repository& repo);
 
     bool absorb(const Repository& repo, const string& mergeHead);
+
+    // Merge the ongoing absorb again against the new tip of the absorbed branch, which must be the one the absorb
+    // was started with.
+    // Only files whose merge inputs changed between the old and new tips are merged again,
+    // so resolutions already made in the working directory for other files are kept.
+    // onConflict is called with each path that is merged again and conflicts, as soon as it is found.
+    // Returns the number of such paths.
+    size_t refresh_absorb(const Repository& repo, const string& mergeHead,
+                          const function<void(const string&)>& onConflict);
 }
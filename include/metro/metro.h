@@ -1,13 +1,34 @@
 #define WIPString "#WIP"
+// The author and committer of every WIP commit.
+#define WIP_AUTHOR_NAME "Metro"
+#define WIP_AUTHOR_EMAIL "wip@metro"
 
 using namespace git;
 
 namespace metro {
+    // What a checkout had to leave undone, for the command to tell the user about.
+    struct CheckoutReport {
+        // Large files left as LFS pointers because they couldn't be downloaded.
+        size_t missingLfsFiles = 0;
+        // Paths of the submodules left where they were because they don't have their recorded commit yet.
+        vector<string> skippedSubmodules;
+
+        void add(const CheckoutReport& other) {
+            missingLfsFiles += other.missingLfsFiles;
+            skippedSubmodules.insert(skippedSubmodules.end(), other.skippedSubmodules.begin(),
+                                     other.skippedSubmodules.end());
+        }
+    };
+
     // Returns true if the repo is currently in merging state.
     bool merge_ongoing(const Repository& repo);
 
     void assert_merging(const Repository& repo);
 
+    // Returns the directory Metro keeps its own data in, inside the .git directory.
+    // The directory is created if it doesn't exist yet.
+    string metro_dir(const Repository& repo);
+
     // Commit all files in the repo directory (excluding those in .gitignore) to the head of the current branch.
     // repo: The repo
     // message: The commit message
@@ -20,6 +41,28 @@ namespace metro {
     // parentRevs: The revisions corresponding to the commit's parents
     void commit(const Repository& repo, const string& message, initializer_list<string> parentRevs);
 
+    // Commit all files in the repo directory (excluding those in .gitignore) to the given reference,
+    // creating it if it doesn't exist.
+    // Returns the new commit ID.
+    OID commit_to_ref(const Repository& repo, const string& updateRef, const string& message, const vector<Commit>& parentCommits);
+
+    // The same, with the given author and committer rather than the user's.
+    OID commit_to_ref(const Repository& repo, const string& updateRef, const string& message,
+                      const vector<Commit>& parentCommits, const Signature& signature);
+
+    // Commit all files in the repo directory to the given reference as a WIP commit.
+    // WIP commits have a fixed author and a time taken from their newest parent, so saving the same working state
+    // on the same parents always gives the same commit, wherever and whenever it is saved.
+    // The real time is kept in .git/metro/wip-times instead.
+    // Returns the new commit ID.
+    OID commit_wip(const Repository& repo, const string& updateRef, const string& message, const vector<Commit>& parentCommits);
+
+    // The time the WIP commit was last saved. Returns false if it isn't known.
+    bool wip_saved_time(const Repository& repo, const OID& wip, int64_t& out);
+
+    // Whether the commit was made by commit_wip, judging by its fixed author.
+    bool is_wip_commit(const Commit& commit);
+
     // Initialize an empty git repository in the specified directory,
     // with an initial commit.
     Repository create(const string& path);
@@ -47,7 +90,7 @@ namespace metro {
 
     void delete_branch(const Repository& repo, const string& name);
 
-    void checkout(const Repository& repo, const string& name);
+    CheckoutReport checkout(const Repository& repo, const string& name);
 
     bool has_uncommitted_changes(const Repository& repo);
 
@@ -55,13 +98,14 @@ namespace metro {
 
     // If the working directory has changes since the last commit, or a merge has been started,
     // Save these changes in a WIP commit in a new #wip branch.
+    // Changes in submodules are saved in WIP commits in the submodules themselves.
     void save_wip(const Repository& repo);
 
     // Deletes the WIP commit at head if any, restoring the contents to the working directory
-    // and resuming a merge if one was ongoing.
-    void restore_wip(const Repository& repo);
+    // and resuming a merge if one was ongoing. Submodule WIP commits are restored too.
+    CheckoutReport restore_wip(const Repository& repo);
 
-    void switch_branch(const Repository& repo, const string& name);
+    CheckoutReport switch_branch(const Repository& repo, const string& name);
 
     void move_head(const Repository& repo, const string& name);
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#define DEFAULT_OBJECT_CACHE_SIZE (256 * 1024 * 1024)
+#define OBJECT_CACHE_SHARDS 64
+// Blobs bigger than this are read straight from the repo rather than cached.
+#define OBJECT_CACHE_MAX_BLOB_SIZE (64 * 1024)
+
+namespace metro {
+    struct ObjectCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t bytes;
+    };
+
+    // A cache of parsed trees and commits and small blobs of a repo, for threads working on the same repo at once.
+    // libgit2's own object cache sits behind a single lock; this one is split into shards by object ID,
+    // each with its own reader-writer lock, so threads only contend when they touch the same shard
+    // and readers never block each other. A hit only takes the shard's lock shared and sets a reference bit.
+    // Each shard evicts with the clock algorithm when it goes over its share of the memory budget.
+    class ObjectCache {
+    private:
+        struct Entry {
+            shared_ptr<void> object;
+            size_t size;
+            mutable atomic<bool> referenced;
+        };
+
+        // Aligned so that shards used by different threads don't share cache lines.
+        struct alignas(64) Shard {
+            mutable shared_mutex mutex;
+            unordered_map<OID, unique_ptr<Entry>, OIDHash> entries;
+            // Clock ring of the cached IDs, and the position of the clock hand in it.
+            vector<OID> clock;
+            size_t hand = 0;
+            size_t bytes = 0;
+            mutable atomic<uint64_t> hits {0};
+            atomic<uint64_t> misses {0};
+            atomic<uint64_t> evictions {0};
+        };
+
+        Repository repo;
+        size_t shardBudget;
+        unique_ptr<Shard[]> shards;
+
+        Shard& shard_for(const OID& id) const;
+        shared_ptr<void> get(const OID& id) const;
+        // Add the object to the cache, returning the object already cached under the same ID if there is one.
+        shared_ptr<void> put(const OID& id, shared_ptr<void> object, size_t size);
+
+    public:
+        explicit ObjectCache(const Repository& repo, size_t maxBytes = DEFAULT_OBJECT_CACHE_SIZE);
+
+        ObjectCache(const ObjectCache&) = delete;
+        ObjectCache& operator=(const ObjectCache&) = delete;
+
+        [[nodiscard]] Tree tree(const OID& id);
+        [[nodiscard]] Commit commit(const OID& id);
+        // The blob with the given ID. Only small blobs are kept in the cache.
+        [[nodiscard]] Blob blob(const OID& id);
+
+        [[nodiscard]] ObjectCacheStats stats() const;
+    };
+}
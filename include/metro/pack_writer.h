@@ -0,0 +1,94 @@
+// How many of the objects sorted before an object are tried as its delta base.
+#define DEFAULT_PACK_WINDOW 10
+// The longest chain of deltas an object may be stored as. Reading an object applies every delta in its chain,
+// so this is well below git's default of 50, trading a little pack size for faster checkouts.
+#define DEFAULT_PACK_DEPTH 10
+// Objects outside these sizes are always stored whole: small ones gain nothing from being deltas,
+// and big ones would take too long to search and too much memory to keep in the window.
+#define PACK_MIN_DELTA_OBJECT_SIZE 50
+#define PACK_MAX_DELTA_OBJECT_SIZE (32 * 1024 * 1024)
+// How many objects, in sorted order, each delta search task takes. Deltas are only found within a task's objects.
+#define PACK_SEARCH_CHUNK 512
+// How many objects are compressed at once while the pack is written.
+#define PACK_WRITE_BATCH 1024
+
+namespace metro {
+    struct PackWriterOptions {
+        size_t window = DEFAULT_PACK_WINDOW;
+        size_t depth = DEFAULT_PACK_DEPTH;
+        // Leave out objects that are only in the shared store the repo borrows objects from.
+        bool localOnly = false;
+    };
+
+    struct PackWriterStats {
+        // The name of the written pack, the hash that follows "pack-" in its file names.
+        string name;
+        size_t objects;
+        size_t deltas;
+        // The total size of the objects before being stored as deltas and compressed.
+        uintmax_t objectBytes;
+        uintmax_t packBytes;
+        double searchSeconds;
+        double writeSeconds;
+    };
+
+    // Writes objects to a new pack, storing objects as deltas against similar ones in parallel.
+    // Objects are sorted by type, then by a hash of the name they were found at, then from biggest to smallest,
+    // so that versions of the same file end up next to each other. The sorted objects are split into chunks,
+    // which are searched for deltas as tasks on the task runtime, each object trying the previous objects in
+    // its window as bases. Idle workers steal waiting chunks, so an uneven spread of big objects doesn't
+    // leave threads waiting on one. Deltas are compressed in parallel too; only writing the pack is serial.
+    class PackWriter {
+    private:
+        struct Entry {
+            OID id;
+            git_object_t type;
+            size_t size;
+            uint32_t nameHash;
+            // The entry this is stored as a delta against, if base isn't SIZE_MAX, and the delta.
+            size_t base = SIZE_MAX;
+            size_t depth = 0;
+            string delta;
+            uint64_t offset = 0;
+        };
+
+        Repository repo;
+        ODB odb;
+        // The repo's own objects, without any in the shared store, if only they are packed.
+        unique_ptr<ODB> local;
+        PackWriterOptions options;
+        vector<Entry> entries;
+        map<OID, size_t> positions;
+        set<OID> leftOut;
+
+        void find_deltas(const vector<size_t>& order, size_t start, size_t end);
+
+    public:
+        explicit PackWriter(const Repository& repo, PackWriterOptions options = {});
+
+        PackWriter(const PackWriter&) = delete;
+        PackWriter& operator=(const PackWriter&) = delete;
+
+        // Add an object. The path it was found at, if any, is used to put it near other versions of the same file.
+        // Returns false if it was already added or is left out.
+        bool add(const OID& id, const string& path = "");
+
+        // Add a commit, its tree and everything in it, skipping trees that were already added.
+        void add_commit(const OID& id);
+
+        // Add a tree and everything in it, skipping trees that were already added.
+        void add_tree(const OID& id, const string& path);
+
+        [[nodiscard]] size_t object_count() const {
+            return entries.size();
+        }
+
+        // Find deltas and write the pack and its index to the given pack directory.
+        PackWriterStats write(const string& packDir);
+    };
+
+    // Write every object reachable from the repo's refs, reflogs, in-progress operations, and the HEADs and indexes
+    // of its worktrees to a single new pack, then delete the packs and loose objects it replaces. Packs with a .keep
+    // file are left alone, as are objects in the shared store and recent loose objects that aren't in the new pack.
+    PackWriterStats repack(const Repository& repo, const PackWriterOptions& options);
+}
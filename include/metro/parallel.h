@@ -0,0 +1,44 @@
+#define MAX_DEFAULT_PARALLELISM 16
+
+namespace metro {
+    // The number of threads parallel operations use by default.
+    inline unsigned int default_parallelism() {
+        unsigned int cores = thread::hardware_concurrency();
+        return cores == 0? 4 : min(cores, (unsigned int) MAX_DEFAULT_PARALLELISM);
+    }
+
+    // Call fn on every item on the shared task runtime, running at most maxThreads calls at once.
+    // The calling thread does some of the work.
+    // If any call throws, the first exception is rethrown once all the other calls have finished.
+    template<typename T, typename F>
+    void parallel_for_each(const vector<T>& items, F fn, unsigned int maxThreads = default_parallelism(),
+                           TaskPriority priority = TaskPriority::Interactive) {
+        atomic<size_t> next(0);
+        exception_ptr error;
+        mutex errorMutex;
+        auto worker = [&]() {
+            for (size_t i = next++; i < items.size(); i = next++) {
+                try {
+                    fn(items[i]);
+                } catch (...) {
+                    lock_guard<mutex> lock(errorMutex);
+                    if (!error) {
+                        error = current_exception();
+                    }
+                }
+            }
+        };
+
+        size_t runnerCount = min((size_t) maxThreads, items.size());
+        TaskGroup group(priority);
+        for (size_t i = 1; i < runnerCount; i++) {
+            group.run(worker);
+        }
+        worker();
+        group.wait();
+
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#define PERF_SEGMENT_RECORDS 1024
+#define PERF_SEGMENT_COUNT 16
+#define PERF_COMMAND_NAME_SIZE 24
+// The most commits from HEAD whose commits and trees the object cache benchmark looks up.
+#define CACHE_BENCHMARK_COMMITS 1000
+
+namespace metro {
+    // One run of a Metro command. Stored on disk as is, so the layout must stay fixed at 64 bytes.
+    struct PerfRecord {
+        // Unix time the command finished at, in seconds.
+        int64_t time;
+        uint64_t wallMicros;
+        uint64_t cpuMicros;
+        // Peak resident memory, in kilobytes.
+        uint64_t maxRssKb;
+        // Identifies the Metro build that ran the command, so upgrades can be told apart.
+        uint32_t buildId;
+        int32_t exitCode;
+        char command[PERF_COMMAND_NAME_SIZE];
+    };
+    static_assert(sizeof(PerfRecord) == 64, "PerfRecord is stored on disk and must stay 64 bytes");
+
+    // Latency summary of one command over one window of time.
+    struct PerfWindow {
+        string command;
+        int64_t start;
+        size_t runs;
+        uint64_t p50Micros;
+        uint64_t p90Micros;
+        uint64_t p99Micros;
+        // Whether a Metro build that didn't run this command in the previous window ran it in this one.
+        bool newBuild;
+        // Whether this window is significantly slower than the previous window the command ran in.
+        bool regression;
+        // The one-sided p-value of the test against the previous window, or 1 if there wasn't one.
+        double pValue;
+    };
+
+    // An identifier for the running Metro build.
+    uint32_t metro_build_id();
+
+    // Record a run of a command in the perf history of the repo in the working directory.
+    // Does nothing if the working directory isn't in a repo, since there's nowhere to store it.
+    void record_command_perf(const string& command, chrono::steady_clock::duration wallTime, int exitCode);
+
+    // Every run recorded in the repo's perf history, oldest first.
+    // The history is a ring of fixed size segment files in .git/metro/perf, so only recent runs are kept.
+    vector<PerfRecord> read_perf_history(const Repository& repo);
+
+    // Summarise the perf history per command and per window of windowSeconds, ordered by command then time.
+    // Each window is tested against the command's previous window with a one-sided Mann-Whitney U test.
+    vector<PerfWindow> perf_history(const Repository& repo, int64_t windowSeconds);
+
+    // Throughput of looking up objects from some number of threads at once.
+    struct CacheScaling {
+        unsigned int threads;
+        // Lookups per second through an ObjectCache, and straight through the shared repo for comparison.
+        double cachedRate;
+        double directRate;
+        // The share of the ObjectCache lookups that were hits.
+        double hitRate;
+    };
+
+    // Measure how ObjectCache lookups scale with threads, for 1, 2, 4 and so on up to maxThreads threads.
+    // Each thread makes lookupsPerThread lookups of the commits and root trees of the newest commits reachable
+    // from HEAD, in its own random order, first through a new ObjectCache and then straight through the repo,
+    // whose own object cache sits behind a single lock.
+    vector<CacheScaling> object_cache_scaling(const Repository& repo, unsigned int maxThreads, size_t lookupsPerThread);
+}
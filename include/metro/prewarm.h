@@ -0,0 +1,16 @@
+namespace metro {
+    // Record a switch between two branches in the repo's switch history.
+    void record_switch(const Repository& repo, const string& from, const string& to);
+
+    // The branches most often switched to from the given branch, most likely first.
+    vector<string> likely_switch_targets(const Repository& repo, const string& from, size_t count);
+
+    // Read the objects needed to switch from the current branch to each of its likely next targets,
+    // so that the next switch finds them in the page cache rather than reading them from disk.
+    // Returns the number of bytes read.
+    size_t prewarm(const Repository& repo, size_t targetCount = 2);
+
+    // Run metro prewarm for the repo in a detached background process, returning immediately.
+    // The repo must be the one in the current directory. Does nothing on platforms without posix_spawn.
+    void prewarm_in_background(const Repository& repo);
+}
@@ -0,0 +1,29 @@
+namespace metro {
+    struct SharedStoreStats {
+        // Number of repos still registered with the pool.
+        size_t repos;
+        // Number of objects kept in the pool.
+        size_t kept;
+        // Number of objects removed from the pool.
+        size_t removed;
+    };
+
+    // Path of the shared object pool the repo has joined, or "" if it doesn't use one.
+    string shared_store_path(const Repository& repo);
+
+    // Join the shared object pool at poolPath, creating the pool if it doesn't exist.
+    // Objects in the pool become visible to the repo through its alternates file,
+    // and from then on Metro writes new objects to the pool rather than the repo.
+    void join_shared_store(const Repository& repo, const string& poolPath);
+
+    // Stop using the repo's shared pool, first copying every object the repo needs from the pool into the repo.
+    void leave_shared_store(const Repository& repo);
+
+    // Make new objects written through this repo go to its shared pool, if it has joined one.
+    // Calling this again for the same repo does nothing.
+    void attach_shared_store(const Repository& repo);
+
+    // Remove the objects in the repo's shared pool that no registered repo references any more,
+    // and pack the remaining ones together. Repos that no longer exist are unregistered.
+    SharedStoreStats gc_shared_store(const Repository& repo);
+}
@@ -0,0 +1,58 @@
+namespace metro {
+    // The stat data of a file in the working directory, truncated to the widths the git index uses.
+    struct FileStat {
+        git_index_time ctime;
+        git_index_time mtime;
+        uint32_t dev;
+        uint32_t ino;
+        uint32_t uid;
+        uint32_t gid;
+        uint32_t size;
+        // The git filemode of the file, or GIT_FILEMODE_TREE for a directory.
+        uint32_t mode;
+    };
+
+    // Read the stat data of a file without following symlinks.
+    // Returns false if there is no file at path, or it isn't a regular file, symlink or directory.
+    bool stat_file(const string& path, FileStat& out);
+
+    // Metro's own record of the working directory's stat data, used in place of the index when it is disabled.
+    // Stored in .git/metro/statcache, it maps each file's path to its stat data and blob ID when it was last hashed.
+    // As with the index, an entry modified at or after the time the cache was written can't be trusted,
+    // since the file may have changed again within the timestamp's granularity.
+    class StatCache {
+    private:
+        struct Entry {
+            FileStat stat;
+            OID id;
+        };
+
+        string path;
+        map<string, Entry> entries;
+        git_index_time written {};
+        bool dirty = false;
+
+        void load();
+
+    public:
+        explicit StatCache(const Repository& repo);
+
+        // If the file at path hasn't changed since it was cached, store its blob ID in id and return true.
+        bool get(const string& path, const FileStat& stat, OID& id) const;
+
+        // Get the cached stat data and blob ID of the file, whether or not it has changed since.
+        bool lookup(const string& path, FileStat& stat, OID& id) const;
+
+        // Whether a file with this stat data was modified no earlier than the cache was written, so that
+        // it could have changed again since it was hashed without its stat data changing.
+        [[nodiscard]] bool racily_clean(const FileStat& stat) const;
+
+        void put(const string& path, const FileStat& stat, const OID& id);
+
+        // Forget every file not in paths.
+        void retain(const set<string>& paths);
+
+        // Write the cache back to disk if it has changed.
+        void save();
+    };
+}
@@ -0,0 +1,17 @@
+namespace metro {
+    // Returns true if any submodule has uncommitted changes of its own,
+    // or its HEAD differs from the commit recorded for it in the repo's HEAD.
+    bool submodules_changed(const Repository& repo);
+
+    // Save the uncommitted changes in each submodule in a WIP commit on a branch named after branchName,
+    // then reset the submodule's working directory to its HEAD. Submodule HEADs are not moved.
+    void save_submodule_wips(const Repository& repo, const string& branchName);
+
+    // Restore the submodule WIP commits saved for branchName to the submodules' working directories.
+    void restore_submodule_wips(const Repository& repo, const string& branchName);
+
+    // Check out the commit recorded for each submodule in tree, if the submodule isn't there already.
+    // Returns the paths of the submodules, nested ones included, left where they were because they don't have
+    // their recorded commit yet.
+    vector<string> checkout_submodules(const Repository& repo, const Tree& tree);
+}
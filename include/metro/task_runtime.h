@@ -0,0 +1,120 @@
+// How many extra threads may be started to stand in for threads blocked on I/O.
+#define MAX_COMPENSATION_THREADS 64
+
+namespace metro {
+    // Interactive tasks are always run before background ones.
+    enum class TaskPriority {
+        Interactive = 0,
+        Background = 1
+    };
+
+    struct TaskRuntimeStats {
+        // Number of worker threads, including those started to make up for blocked ones.
+        size_t threads;
+        // The most tasks that run at once, not counting threads in blocking() calls.
+        size_t concurrency;
+        uint64_t executed;
+        // Tasks taken from another worker's queue.
+        uint64_t steals;
+        // Worker threads started because others were blocked.
+        uint64_t compensations;
+        // The most tasks that were waiting in any one queue at once.
+        size_t maxQueueDepth;
+        // Tasks waiting in each worker's queue, then in the queue for tasks submitted from outside the workers.
+        vector<size_t> queueDepths;
+    };
+
+    // The work-stealing thread pool every parallel Metro operation shares, so that together they never run
+    // more tasks at once than the machine has cores. Each worker has its own queue for each priority:
+    // it runs its newest task first, and when it runs out it steals the oldest task of another worker.
+    // A task about to block on I/O or another process should do it in blocking(), which lets another worker
+    // take its place until it returns.
+    class TaskRuntime {
+    private:
+        struct alignas(64) TaskQueue {
+            mutex lock;
+            deque<function<void()>> tasks[2];
+        };
+
+        unsigned int concurrency;
+        unsigned int maxThreads;
+        // One queue per possible worker, allocated up front so workers can be added without moving them.
+        vector<unique_ptr<TaskQueue>> queues;
+        TaskQueue injected;
+        vector<thread> threads;
+        atomic<size_t> threadCount {0};
+
+        mutex stateMutex;
+        condition_variable wake;
+        unsigned int permits;
+        unsigned int idle = 0;
+        bool stopping = false;
+        atomic<size_t> pending {0};
+
+        atomic<uint64_t> executed {0};
+        atomic<uint64_t> steals {0};
+        atomic<uint64_t> compensations {0};
+        atomic<size_t> maxQueueDepth {0};
+
+        explicit TaskRuntime(unsigned int concurrency);
+
+        void spawn_worker();
+        void worker_loop(size_t index);
+        bool acquire_permit(bool needWork);
+        void release_permit();
+        void push(TaskQueue& queue, function<void()> task, TaskPriority priority);
+        bool pop(TaskQueue& queue, TaskPriority priority, bool newest, function<void()>& out);
+        bool find_task(TaskPriority maxPriority, function<void()>& out);
+
+    public:
+        ~TaskRuntime();
+
+        TaskRuntime(const TaskRuntime&) = delete;
+        TaskRuntime& operator=(const TaskRuntime&) = delete;
+
+        // The runtime, started the first time it is used.
+        static TaskRuntime& instance();
+
+        // Whether the runtime has been started.
+        static bool started();
+
+        // Whether the calling thread is one of the runtime's workers.
+        static bool in_worker();
+
+        // Queue a task to be run by a worker.
+        void submit(function<void()> task, TaskPriority priority);
+
+        // Run one queued task of at most the given priority on the calling thread, if there is one.
+        bool run_one(TaskPriority maxPriority);
+
+        // Call fn, which is expected to spend most of its time waiting, letting another worker run tasks meanwhile.
+        static void blocking(const function<void()>& fn);
+
+        [[nodiscard]] TaskRuntimeStats stats();
+    };
+
+    // A set of tasks submitted to the runtime that can be waited for together.
+    class TaskGroup {
+    private:
+        TaskPriority priority;
+        atomic<size_t> pending {0};
+        mutex doneMutex;
+        condition_variable done;
+        exception_ptr error;
+
+    public:
+        explicit TaskGroup(TaskPriority priority = TaskPriority::Interactive) : priority(priority) {}
+
+        // Waits for the tasks, ignoring any errors.
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        void run(function<void()> task);
+
+        // Wait for every task in the group to finish, running queued tasks on this thread meanwhile.
+        // If any task threw, the first exception is rethrown.
+        void wait();
+    };
+}
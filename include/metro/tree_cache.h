@@ -0,0 +1,143 @@
+#define DEFAULT_TREE_CACHE_SIZE (64 * 1024 * 1024)
+// Budget for tree caches kept on disk between commands, which are read in full when opened.
+#define PERSISTED_TREE_CACHE_SIZE (8 * 1024 * 1024)
+
+namespace metro {
+    struct FlatTreeEntry {
+        string_view name;
+        git_filemode_t mode;
+        OID id;
+    };
+
+    // A parsed tree laid out in one flat block: the entry count, the offsets of the entries' names,
+    // their modes packed into 16 bits each, their IDs back to back, and then the names themselves.
+    // Entries are sorted by name as plain bytes, rather than in git's order where directories sort as if their
+    // names ended in '/', so an entry can be found by binary search without building anything.
+    class FlatTree {
+    private:
+        // The block, in words so that the offsets are aligned.
+        vector<uint32_t> block;
+        size_t bytes;
+
+        FlatTree(vector<uint32_t> block, size_t bytes) : block(std::move(block)), bytes(bytes) {}
+
+        [[nodiscard]] const char *base() const {
+            return reinterpret_cast<const char*>(block.data());
+        }
+
+        [[nodiscard]] const uint32_t *name_offsets() const {
+            return block.data() + 1;
+        }
+
+        [[nodiscard]] const uint16_t *modes() const {
+            return reinterpret_cast<const uint16_t*>(base() + (size() + 2) * sizeof(uint32_t));
+        }
+
+        [[nodiscard]] const git_oid *ids() const {
+            return reinterpret_cast<const git_oid*>(reinterpret_cast<const char*>(modes()) + size() * sizeof(uint16_t));
+        }
+
+        [[nodiscard]] const char *names() const {
+            return reinterpret_cast<const char*>(ids() + size());
+        }
+
+    public:
+        // Parse the contents of a tree object. Throws an exception if they aren't a valid tree.
+        static shared_ptr<const FlatTree> parse(const char *data, size_t size);
+
+        // Rebuild a tree from the bytes serialized() gave. Returns nullptr if they aren't valid.
+        static shared_ptr<const FlatTree> deserialize(const char *data, size_t size);
+
+        // The block as bytes, to be stored and rebuilt with deserialize().
+        [[nodiscard]] string_view serialized() const {
+            return string_view(base(), bytes);
+        }
+
+        [[nodiscard]] size_t size() const {
+            return block[0];
+        }
+
+        [[nodiscard]] string_view name(size_t n) const {
+            return string_view(names() + name_offsets()[n], name_offsets()[n + 1] - name_offsets()[n]);
+        }
+
+        [[nodiscard]] git_filemode_t mode(size_t n) const {
+            return static_cast<git_filemode_t>(modes()[n]);
+        }
+
+        [[nodiscard]] const git_oid& id(size_t n) const {
+            return ids()[n];
+        }
+
+        [[nodiscard]] FlatTreeEntry entry(size_t n) const {
+            return {name(n), mode(n), OID(id(n))};
+        }
+
+        // The position of the entry with the given name, or SIZE_MAX if there is none.
+        [[nodiscard]] size_t find(string_view name) const;
+    };
+
+    struct TreeCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t trees;
+        size_t bytes;
+    };
+
+    // A cache of trees parsed into FlatTrees, for code that looks up paths in the same trees over and over.
+    // Looking a path up in a libgit2 tree parses each tree on the way into an entry struct per entry, and libgit2
+    // only keeps parsed trees while they are in use; FlatTrees take a fraction of the memory and stay parsed
+    // until the memory budget forces them out, least recently used first by the clock algorithm.
+    // A persistent cache is read from .git/metro/tree-cache when opened and written back by save(),
+    // so trees that don't change, such as HEAD's, are only parsed once across commands.
+    // The cache may be used by several threads at once.
+    class TreeCache {
+    private:
+        struct Entry {
+            shared_ptr<const FlatTree> tree;
+            mutable atomic<bool> referenced;
+        };
+
+        ODB odb;
+        // Where the cache is persisted, or empty if it isn't.
+        string path;
+        size_t maxBytes;
+
+        mutable shared_mutex mutex;
+        unordered_map<OID, unique_ptr<Entry>, OIDHash> entries;
+        // Clock ring of the cached IDs, and the position of the clock hand in it.
+        vector<OID> clock;
+        size_t hand = 0;
+        size_t bytes = 0;
+        bool dirty = false;
+        mutable atomic<uint64_t> hits {0};
+        atomic<uint64_t> misses {0};
+
+        void load();
+        // Add a tree, evicting others to make room. The lock must be held exclusively.
+        shared_ptr<const FlatTree> insert(const OID& id, shared_ptr<const FlatTree> tree);
+        void changed_files(const OID *from, const OID& to, const string& prefix,
+                           const function<void(const string&, const FlatTreeEntry&)>& fn);
+
+    public:
+        explicit TreeCache(const Repository& repo, size_t maxBytes = DEFAULT_TREE_CACHE_SIZE, bool persistent = false);
+
+        TreeCache(const TreeCache&) = delete;
+        TreeCache& operator=(const TreeCache&) = delete;
+
+        [[nodiscard]] shared_ptr<const FlatTree> tree(const OID& id);
+
+        // Find the entry at path, relative to the given tree, looking through subtrees for each '/' in it.
+        // Returns false if there is no entry at that path.
+        bool find_path(const OID& root, string_view path, FlatTreeEntry& out);
+
+        // Call fn with the path and entry of each file or gitlink in the to tree that the from tree doesn't have
+        // at the same path with the same ID and mode, in path order. Subtrees that are the same in both are skipped.
+        void changed_files(const OID& from, const OID& to, const function<void(const string&, const FlatTreeEntry&)>& fn);
+
+        // Write a persistent cache back to disk if trees were added to it.
+        void save();
+
+        [[nodiscard]] TreeCacheStats stats() const;
+    };
+}
@@ -0,0 +1,19 @@
+namespace metro {
+    // A file to put in a tree built by build_tree.
+    struct TreeWriterEntry {
+        // Path relative to the root of the tree, with '/' separators.
+        string path;
+        uint32_t mode;
+        OID id;
+    };
+
+    // Build the tree holding the given files and return its ID. Directories are created for the files' paths.
+    // Trees are serialized in git's canonical form, so the same files always give the same tree ID as git would.
+    // Big directories are built in parallel on the task runtime, each joined into its parent once built,
+    // and the trees are written to the object database together at the end, skipping any it already has.
+    // If write is false the trees are only hashed and nothing is written to the object database.
+    OID build_tree(const Repository& repo, vector<TreeWriterEntry> entries, bool write = true);
+
+    // Write the index's files as a tree with build_tree, giving the same tree as writing it with libgit2.
+    OID write_index_tree(const Repository& repo, Index& index);
+}
@@ -0,0 +1,54 @@
+// Loose objects younger than this are never deleted when a repo's objects are replaced by a new pack,
+// since another process may have just written them and not yet referenced them. Git's gc uses the same default.
+#define LOOSE_OBJECT_GRACE_SECONDS (14 * 24 * 60 * 60)
+
+namespace metro {
+    // How much history to keep when trimming: the newest count commits back from each ref if count isn't 0,
+    // otherwise the commits made since the given time. The commits refs point to are always kept.
+    struct TrimLimit {
+        size_t count = 0;
+        int64_t since = 0;
+    };
+
+    struct TrimStats {
+        size_t keptCommits;
+        // Kept commits whose parents were cut off.
+        size_t boundaryCommits;
+        uintmax_t bytesBefore;
+        uintmax_t bytesAfter;
+    };
+
+    // The objects that must survive rewriting a repo's objects.
+    struct ObjectRoots {
+        // The commits that refs, in-progress operations and the HEADs of the repo and its worktrees lead to.
+        vector<OID> commits;
+        // Annotated tags refs point to, through any chain of tags.
+        vector<OID> tags;
+        // Other objects refs point to, such as trees and blobs.
+        vector<OID> others;
+        // The blobs in the indexes of the repo and its worktrees, which may not be in any commit yet, with their paths.
+        vector<pair<OID, string>> staged;
+    };
+
+    ObjectRoots object_roots(const Repository& repo, const ODB& odb);
+
+    // The commits the repo's reflogs list, which must be kept so that the reflogs stay readable.
+    vector<OID> reflog_commits(const Repository& repo, const ODB& odb);
+
+    // The files a new pack of every kept object replaces: the loose object directories and the packs without a
+    // .keep file. They must be listed before the new pack is written.
+    vector<filesystem::path> replaceable_object_files(const string& objectsDir);
+
+    // Delete the replaced files listed by replaceable_object_files, except the new pack, named pack-<hash>,
+    // and any loose object that isn't in it and is younger than LOOSE_OBJECT_GRACE_SECONDS.
+    void remove_replaced_objects(const vector<filesystem::path>& files, const string& packDir, const string& newPack);
+
+    // The commits at the edge of a trimmed history, listed in .git/shallow, whose parents aren't in the repo.
+    set<OID> shallow_commits(const Repository& repo);
+
+    // Make the repo shallow: cut the history reachable from its refs at the limit, record the commits at the cut
+    // in .git/shallow, and repack everything still reachable into a single pack, deleting all other objects.
+    // Stashes are kept whole, along with the commits they were made on. Reflog entries that name cut commits are
+    // dropped, and the commit index and query cache are rebuilt when next used.
+    TrimStats trim_history(const Repository& repo, const TrimLimit& limit);
+}
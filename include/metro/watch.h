@@ -0,0 +1,29 @@
+namespace metro {
+    enum class RepoEventType {
+        BranchChanged,
+        CommitCreated,
+        MergeStarted,
+        MergeResolved,
+        PathsDirtied,
+        // The kernel dropped events, so changes may have been missed and anything derived from the repo state
+        // should be worked out again from scratch. Reported in place of PathsDirtied.
+        Rescan
+    };
+
+    struct RepoEvent {
+        RepoEventType type;
+        // The new branch name for BranchChanged, or the commit ID for CommitCreated and MergeStarted.
+        string detail;
+        // The changed working directory paths for PathsDirtied, relative to the repo root.
+        vector<string> paths;
+    };
+
+    // Short lowercase name of the event type, such as "branch-changed".
+    string event_type_name(RepoEventType type);
+
+    // Watch HEAD, the refs, the index, the merge state files and the working directory for changes
+    // and pass each change to callback as a typed event, until callback returns false.
+    // Filesystem changes arriving less than coalesceMillis apart are coalesced into a single batch of events.
+    // Only supported on Linux, where inotify is used so no polling is needed.
+    void watch_events(const Repository& repo, const function<bool(const RepoEvent&)>& callback, int coalesceMillis = 50);
+}
@@ -6,39 +6,98 @@ using namespace std;
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <iostream>
 #include <cstdio>
 #include <cstring>
 #include <sstream>
+#include <string_view>
 #include <fstream>
 #include <streambuf>
 #include <functional>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <filesystem>
+#include <shared_mutex>
+#include <unordered_map>
+#include <deque>
+#include <condition_variable>
+#include <cmath>
+#include <ctime>
+#include <future>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 #include "git2.h"
 #if (LIBGIT2_VER_MINOR < 28)
 #define git_error_last giterr_last
+#define GIT_INDEX_ENTRY_STAGE_SET GIT_IDXENTRY_STAGE_SET
 #endif
 
 
 #include "commands.h"
+#include "probes.h"
 #include "helper.h"
 #include "error.h"
+#include "json.h"
+#include "http.h"
+#include "digest.h"
 
 #include "gitwrapper/types.h"
 #include "gitwrapper/oid.h"
 #include "gitwrapper/branch.h"
 #include "gitwrapper/conflict_iterator.h"
-#include "gitwrapper/index.h"
 #include "gitwrapper/tree.h"
+#include "gitwrapper/index.h"
+#include "gitwrapper/blob_view.h"
+#include "gitwrapper/blob.h"
+#include "gitwrapper/blob_writer.h"
+#include "gitwrapper/diff.h"
+#include "gitwrapper/merge_file_result.h"
 #include "gitwrapper/commit.h"
 #include "gitwrapper/annotated_commit.h"
 #include "gitwrapper/object.h"
 #include "gitwrapper/branch_iterator.h"
+#include "gitwrapper/odb.h"
+#include "gitwrapper/revwalk.h"
+#include "gitwrapper/pack_builder.h"
+#include "gitwrapper/indexer.h"
 #include "gitwrapper/status_list.h"
+#include "gitwrapper/config.h"
 #include "gitwrapper/repository.h"
 
+#include "metro/task_runtime.h"
+#include "metro/parallel.h"
 #include "metro/metro.h"
+#include "metro/access_pattern.h"
 #include "metro/merging.h"
+#include "metro/cache.h"
+#include "metro/object_cache.h"
+#include "metro/shared_store.h"
+#include "metro/memory_commit.h"
+#include "metro/watch.h"
+#include "metro/submodules.h"
+#include "metro/prewarm.h"
+#include "metro/perf.h"
+#include "metro/bisect.h"
+#include "metro/tree_writer.h"
+#include "metro/tree_cache.h"
+#include "metro/stat_cache.h"
+#include "metro/indexless.h"
+#include "metro/commit_index.h"
+#include "metro/churn.h"
+#include "metro/lfs.h"
+#include "metro/trim.h"
+#include "metro/delta.h"
+#include "metro/pack_writer.h"
+#include "metro/conflict_matrix.h"
 
 #endif //PCH_H
@@ -0,0 +1,104 @@
+// USDT tracepoints for bpftrace, perf and other tracers, under the "metro" provider.
+// Each probe compiles to a single nop plus a note in the binary telling tracers where it is, so probes cost
+// nothing until a tracer attaches. Without <sys/sdt.h>, or with METRO_NO_PROBES defined, they compile to nothing
+// and their arguments aren't evaluated. The probes are:
+//   op__start(name, detail), op__done(name, detail, failed)
+//       around each Metro operation, such as switch_branch or absorb.
+//   git__start(function), git__done(function)
+//       around each gitwrapper call into libgit2.
+//   phase__start(name, detail), phase__done(name, detail, items, bytes)
+//       around each I/O-heavy phase: walk, hash, write_tree, checkout, merge, pack and transfer.
+//       The detail is a path where there is one, and bytes is the amount of data the phase read or wrote.
+#if defined(__has_include) && !defined(METRO_NO_PROBES)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define METRO_PROBES
+#endif
+#endif
+
+#ifdef METRO_PROBES
+// Fires op__start when a Metro operation starts and op__done when it returns or throws.
+class OperationProbe {
+private:
+    const char *name;
+    const char *detail;
+    int exceptions;
+
+public:
+    OperationProbe(const char *name, const char *detail) : name(name), detail(detail), exceptions(uncaught_exceptions()) {
+        DTRACE_PROBE2(metro, op__start, name, detail);
+    }
+
+    ~OperationProbe() {
+        int failed = uncaught_exceptions() > exceptions;
+        DTRACE_PROBE3(metro, op__done, name, detail, failed);
+    }
+
+    OperationProbe(const OperationProbe&) = delete;
+    OperationProbe& operator=(const OperationProbe&) = delete;
+};
+
+// Fires git__start and git__done around a gitwrapper call.
+class GitCallProbe {
+private:
+    const char *function;
+
+public:
+    explicit GitCallProbe(const char *function) : function(function) {
+        DTRACE_PROBE1(metro, git__start, function);
+    }
+
+    ~GitCallProbe() {
+        DTRACE_PROBE1(metro, git__done, function);
+    }
+
+    GitCallProbe(const GitCallProbe&) = delete;
+    GitCallProbe& operator=(const GitCallProbe&) = delete;
+};
+
+// Fires phase__start and phase__done around a phase, counting the items and bytes it handled on the way.
+// The counts may be added to from several threads.
+class PhaseProbe {
+private:
+    const char *name;
+    const char *detail;
+    atomic<uint64_t> items {0};
+    atomic<uint64_t> bytes {0};
+
+public:
+    PhaseProbe(const char *name, const char *detail) : name(name), detail(detail) {
+        DTRACE_PROBE2(metro, phase__start, name, detail);
+    }
+
+    ~PhaseProbe() {
+        uint64_t itemCount = items.load(memory_order_relaxed);
+        uint64_t byteCount = bytes.load(memory_order_relaxed);
+        DTRACE_PROBE4(metro, phase__done, name, detail, itemCount, byteCount);
+    }
+
+    PhaseProbe(const PhaseProbe&) = delete;
+    PhaseProbe& operator=(const PhaseProbe&) = delete;
+
+    void add(uint64_t byteCount, uint64_t itemCount = 1) {
+        items.fetch_add(itemCount, memory_order_relaxed);
+        bytes.fetch_add(byteCount, memory_order_relaxed);
+    }
+};
+
+// Probe the enclosing Metro operation, named after the function.
+#define METRO_OPERATION_PROBE(detail) OperationProbe operationProbe(__func__, detail)
+// Probe the enclosing gitwrapper call, named with its class and signature.
+#define GIT_CALL_PROBE() GitCallProbe gitCallProbe(__PRETTY_FUNCTION__)
+// Declare a phase probe named var, which lasts until the end of the scope.
+#define METRO_PHASE_PROBE(var, name, detail) PhaseProbe var(name, detail)
+// Count an item of the given size in a phase probe.
+#define METRO_PHASE_ADD(var, bytes) (var).add(bytes)
+// Count several items with the given total size at once.
+#define METRO_PHASE_ADD_ITEMS(var, items, bytes) (var).add(bytes, items)
+#else
+#define METRO_OPERATION_PROBE(detail) ((void) 0)
+#define GIT_CALL_PROBE() ((void) 0)
+#define METRO_PHASE_PROBE(var, name, detail) ((void) 0)
+#define METRO_PHASE_ADD(var, bytes) ((void) 0)
+#define METRO_PHASE_ADD_ITEMS(var, items, bytes) ((void) 0)
+#endif
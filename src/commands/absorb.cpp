@@ -15,8 +15,23 @@ Command absorbCmd {
             string name = args.positionals[0];
 
             Repository repo = git::Repository::open(".");
+            if (args.options.count("refresh") > 0) {
+                metro::refresh_absorb(repo, name, [](const string& path) {
+                    cout << "Conflict in " << path << "\n";
+                });
+                if (repo.index().has_conflicts()) {
+                    cout << "Refreshed absorb of " << name << ", please resolve the remaining conflicts." << endl;
+                } else {
+                    cout << "Refreshed absorb of " << name << ", no conflicts remain.\nRun metro resolve to finish absorbing." << endl;
+                }
+                return;
+            }
+
             bool hasConflicts = metro::absorb(repo, name);
             if (hasConflicts) {
+                repo.index().for_each_conflict([](const Conflict& conflict) {
+                    cout << "Conflict in " << conflict.path() << "\n";
+                });
                 cout << "Conflicts occurred, please resolve." << endl;
             } else {
                 string current = metro::current_branch_name(repo);
@@ -26,6 +41,6 @@ Command absorbCmd {
 
         // printHelp
         [](const Arguments &args) {
-            std::cout << "Usage: metro absorb <other-branch>\n";
+            std::cout << "Usage: metro absorb <other-branch> [--refresh]\n";
         }
 };
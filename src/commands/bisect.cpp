@@ -0,0 +1,54 @@
+#include "pch.h"
+
+Command bisectCmd {
+        "bisect",
+        "Find the commit that broke a test, testing several commits at once",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.size() < 2) {
+                throw MissingPositionalException(args.positionals.empty()? "good" : "bad");
+            }
+            if (args.positionals.size() > 2) {
+                throw UnexpectedPositionalException(args.positionals[2]);
+            }
+            if (args.passthrough.empty()) {
+                throw MissingPositionalException("test command");
+            }
+
+            unsigned int jobs = metro::default_parallelism();
+            if (args.options.count("jobs") > 0) {
+                try {
+                    jobs = stoul(args.options.at("jobs"));
+                } catch (logic_error&) {
+                    jobs = 0;
+                }
+                if (jobs == 0) {
+                    throw CommandArgumentException("jobs", "The number of jobs must be a positive number.");
+                }
+            }
+
+            Repository repo = git::Repository::open(".");
+            vector<OID> suspects = metro::bisect(repo, args.positionals[0], args.positionals[1], args.passthrough, jobs,
+                    [](const OID& commit, metro::BisectResult result) {
+                cout << commit.str() << " is "
+                     << (result == metro::BisectResult::Good? "good" : result == metro::BisectResult::Bad? "bad" : "skipped")
+                     << "\n";
+            });
+
+            if (suspects.size() == 1) {
+                Commit commit = repo.lookup_commit(suspects[0]);
+                cout << "First bad commit: " << commit.id().str() << "\n" << commit.message() << "\n";
+            } else {
+                cout << "Skipped commits hide the first bad commit, it is one of:\n";
+                for (const OID& suspect : suspects) {
+                    cout << suspect.str() << "\n";
+                }
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro bisect <good> <bad> [--jobs <n>] -- <test command>\n";
+        }
+};
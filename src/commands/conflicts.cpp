@@ -0,0 +1,83 @@
+#include "pch.h"
+
+// Width of each column of the matrix.
+#define MATRIX_CELL_WIDTH 6
+
+// Pad text on the left to the cell width.
+string matrix_cell(const string& text) {
+    return string(MATRIX_CELL_WIDTH > text.size()? MATRIX_CELL_WIDTH - text.size() : 1, ' ') + text;
+}
+
+Command conflicts {
+        "conflicts",
+        "Show which branches would conflict with each other when merged",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("report");
+            }
+            if (args.positionals[0] != "matrix") {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            vector<string> branches(args.positionals.begin() + 1, args.positionals.end());
+            if (branches.empty()) {
+                BranchIterator iter = repo.new_branch_iterator(GIT_BRANCH_LOCAL);
+                for (Branch branch; iter.next(&branch);) {
+                    if (!has_suffix(branch.name(), WIPString)) {
+                        branches.push_back(branch.name());
+                    }
+                }
+                sort(branches.begin(), branches.end());
+            }
+            if (branches.size() < 2) {
+                throw MissingPositionalException("branch");
+            }
+
+            metro::ConflictMatrix matrix = metro::conflict_matrix(repo, branches);
+            for (size_t i = 0; i < branches.size(); i++) {
+                cout << matrix_cell(to_string(i + 1)) << "  " << branches[i] << "\n";
+            }
+
+            // Each cell is the share of the files both branches changed that conflict,
+            // or a dot if they changed none of the same files.
+            vector<vector<string>> cells(branches.size(), vector<string>(branches.size(), "-"));
+            for (const metro::BranchPairConflicts& pair : matrix.pairs) {
+                string cell = pair.merged? to_string((int) round(pair.likelihood() * 100)) + "%" : ".";
+                cells[pair.first][pair.second] = cell;
+                cells[pair.second][pair.first] = cell;
+            }
+            cout << "\n" << matrix_cell("");
+            for (size_t i = 0; i < branches.size(); i++) {
+                cout << matrix_cell(to_string(i + 1));
+            }
+            cout << "\n";
+            for (size_t i = 0; i < branches.size(); i++) {
+                cout << matrix_cell(to_string(i + 1));
+                for (const string& cell : cells[i]) {
+                    cout << matrix_cell(cell);
+                }
+                cout << "\n";
+            }
+
+            for (const metro::BranchPairConflicts& pair : matrix.pairs) {
+                if (pair.conflicts.empty()) {
+                    continue;
+                }
+                cout << "\n" << branches[pair.first] << " and " << branches[pair.second] << ": "
+                     << pair.conflicts.size() << " of " << pair.sharedPaths << " shared files conflict\n";
+                for (const string& path : pair.conflicts) {
+                    cout << "  " << path << "\n";
+                }
+            }
+            cout << "\nMerged " << matrix.merges << " of " << matrix.pairs.size() << " pairs, "
+                 << matrix.cachedMerges << " from the cache.\n";
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro conflicts matrix [<branch>...]\n";
+        }
+};
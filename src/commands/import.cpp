@@ -0,0 +1,80 @@
+#include "pch.h"
+
+// Parse the mode in a file header, which must be that of a regular, executable or symlink blob.
+git_filemode_t parse_import_mode(const string& text, const string& header) {
+    if (!text.empty() && text.find_first_not_of("01234567") == string::npos && text.size() <= 7) {
+        auto mode = static_cast<git_filemode_t>(stoul(text, nullptr, 8));
+        if (mode == GIT_FILEMODE_BLOB || mode == GIT_FILEMODE_BLOB_EXECUTABLE || mode == GIT_FILEMODE_LINK) {
+            return mode;
+        }
+    }
+    throw CommandArgumentException(header, "Invalid file mode " + text + " in header: " + header);
+}
+
+size_t parse_import_size(const string& text, const string& header) {
+    if (!text.empty() && text.find_first_not_of("0123456789") == string::npos) {
+        try {
+            return stoull(text);
+        } catch (out_of_range&) {}
+    }
+    throw CommandArgumentException(header, "Invalid file size " + text + " in header: " + header);
+}
+
+// Read files from stdin and commit them on top of HEAD.
+// Each file is a header line "<octal mode> <size> <path>" followed by exactly size bytes of content.
+// A line "delete <path>" removes a file instead.
+Command import {
+        "import",
+        "Commit file contents read from stdin",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("message");
+            }
+            if (args.positionals.size() > 1) {
+                throw UnexpectedPositionalException(args.positionals[1]);
+            }
+            string message = args.positionals[0];
+
+            Repository repo = git::Repository::open(".");
+            metro::assert_merging(repo);
+
+#ifdef _WIN32
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            metro::MemoryCommit commit(repo);
+            size_t count = 0;
+            for (string line; getline(cin, line);) {
+                if (line.empty()) {
+                    continue;
+                }
+
+                string first, rest;
+                split_at_first(line, ' ', first, rest);
+                if (first == "delete") {
+                    commit.remove(rest);
+                } else {
+                    string sizeString, path;
+                    split_at_first(rest, ' ', sizeString, path);
+                    if (path.empty()) {
+                        throw CommandArgumentException(line, "Invalid file header: " + line);
+                    }
+                    git_filemode_t mode = parse_import_mode(first, line);
+                    commit.write(path, cin, parse_import_size(sizeString, line), mode);
+                }
+                count++;
+            }
+
+            OID id = commit.commit(message);
+            if (args.options.count("checkout") > 0) {
+                commit.update_workdir();
+            }
+            cout << "Saved commit " << id.str() << " with " << count << " changed files to current branch.\n";
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro import <message> [--checkout]\n";
+        }
+};
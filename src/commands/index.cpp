@@ -0,0 +1,36 @@
+#include "pch.h"
+
+Command indexCmd {
+        "index",
+        "Turn the git index off to speed up commits, or write it for other git tools",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("action");
+            }
+            if (args.positionals.size() > 1) {
+                throw UnexpectedPositionalException(args.positionals[1]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            string action = args.positionals[0];
+            if (action == "disable") {
+                metro::disable_index(repo);
+                cout << "Disabled the index. Run metro index write before using other git tools.\n";
+            } else if (action == "enable") {
+                metro::enable_index(repo);
+                cout << "Enabled the index.\n";
+            } else if (action == "write") {
+                metro::ensure_index(repo);
+                cout << "The index is up to date.\n";
+            } else {
+                throw UnexpectedPositionalException(action);
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro index <enable/disable/write>\n";
+        }
+};
@@ -9,6 +9,24 @@ Command info {
             Repository repo = git::Repository::open(".");
             cout << "Current branch: " << metro::current_branch_name(repo) << endl;
             cout << "Merging: " << (metro::merge_ongoing(repo)? "yes" : "no") << endl;
+
+            // WIP commits carry their parent's time, so the time they were saved comes from Metro's record.
+            BranchIterator iter = repo.new_branch_iterator(GIT_BRANCH_LOCAL);
+            for (Branch branch; iter.next(&branch);) {
+                string name = branch.name();
+                if (!has_suffix(name, WIPString)) {
+                    continue;
+                }
+                cout << "Work in progress on " << name.substr(0, name.size() - strlen(WIPString));
+                int64_t savedTime;
+                if (metro::wip_saved_time(repo, branch.target(), savedTime)) {
+                    char date[32];
+                    time_t saved = savedTime;
+                    strftime(date, sizeof(date), "%Y-%m-%d %H:%M", localtime(&saved));
+                    cout << ", saved " << date;
+                }
+                cout << endl;
+            }
         },
 
         // printHelp
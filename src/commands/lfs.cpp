@@ -0,0 +1,34 @@
+#include "pch.h"
+
+Command lfs {
+        "lfs",
+        "Download or upload the large files on this branch stored with Git LFS",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("action");
+            }
+            if (args.positionals.size() > 1) {
+                throw UnexpectedPositionalException(args.positionals[1]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            Tree tree = metro::get_commit(repo, "HEAD").tree();
+            string action = args.positionals[0];
+            if (action == "fetch") {
+                size_t count = metro::lfs_fetch(repo, tree);
+                cout << "Downloaded " << count << " large files.\n";
+            } else if (action == "push") {
+                size_t count = metro::lfs_push(repo, tree);
+                cout << "Uploaded " << count << " large files.\n";
+            } else {
+                throw UnexpectedPositionalException(action);
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro lfs <fetch/push>\n";
+        }
+};
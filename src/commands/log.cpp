@@ -0,0 +1,43 @@
+#include "pch.h"
+
+Command logCmd {
+        "log",
+        "Show the commits on this branch, filtered by author, date or message",
+
+        // execute
+        [](const Arguments &args) {
+            if (!args.positionals.empty()) {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+
+            metro::LogQuery query;
+            if (args.options.count("author") > 0) {
+                query.author = args.options.at("author");
+            }
+            if (args.options.count("since") > 0 && !parse_time(args.options.at("since"), query.since)) {
+                throw CommandArgumentException("since", "Give a date as YYYY-MM-DD or a time ago such as 2w.");
+            }
+            if (args.options.count("grep") > 0) {
+                query.grep = args.options.at("grep");
+            }
+
+            Repository repo = git::Repository::open(".");
+            metro::CommitIndex index(repo);
+            index.update(repo);
+            for (const OID& id : index.query(repo, query)) {
+                Commit commit = repo.lookup_commit(id);
+                string message = commit.message();
+                string summary = message.substr(0, message.find('\n'));
+
+                char date[16];
+                time_t time = commit.time();
+                strftime(date, sizeof(date), "%Y-%m-%d", localtime(&time));
+                cout << id.str().substr(0, 7) << "  " << date << "  " << commit.author()->name << "  " << summary << "\n";
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro log [--author <name>] [--since <YYYY-MM-DD|time ago>] [--grep <text>]\n";
+        }
+};
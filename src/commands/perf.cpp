@@ -0,0 +1,105 @@
+#include "pch.h"
+
+#define DEFAULT_PERF_WINDOW_DAYS 7
+#define DEFAULT_CACHE_BENCHMARK_THREADS 64
+#define DEFAULT_CACHE_BENCHMARK_LOOKUPS 200000
+
+// Format a duration in microseconds as milliseconds.
+string format_millis(uint64_t micros) {
+    stringstream out;
+    out.setf(ios::fixed);
+    out.precision(1);
+    out << micros / 1000.0 << "ms";
+    return out.str();
+}
+
+// Read a positive whole number option, or return fallback if it isn't given.
+uint64_t positive_option(const Arguments &args, const string& name, uint64_t fallback, const string& message) {
+    if (args.options.count(name) == 0) {
+        return fallback;
+    }
+    const string& text = args.options.at(name);
+    uint64_t value = 0;
+    if (!text.empty() && all_of(text.begin(), text.end(), ::isdigit)) {
+        try {
+            value = stoull(text);
+        } catch (out_of_range&) {}
+    }
+    if (value == 0) {
+        throw CommandArgumentException(name, message);
+    }
+    return value;
+}
+
+void print_perf_history(const Repository& repo, int64_t days) {
+    string command;
+    for (const metro::PerfWindow& window : metro::perf_history(repo, days * 24 * 60 * 60)) {
+        if (window.command != command) {
+            command = window.command;
+            cout << command << "\n";
+        }
+
+        char date[16];
+        time_t start = window.start;
+        strftime(date, sizeof(date), "%Y-%m-%d", localtime(&start));
+        cout << "  " << date << "  " << window.runs << " runs  p50 " << format_millis(window.p50Micros)
+             << "  p90 " << format_millis(window.p90Micros) << "  p99 " << format_millis(window.p99Micros);
+        if (window.newBuild) {
+            cout << "  (new Metro build)";
+        }
+        if (window.regression) {
+            cout << "  REGRESSION (p=" << window.pValue << ")";
+        }
+        cout << "\n";
+    }
+}
+
+void print_cache_scaling(const Repository& repo, unsigned int threads, size_t lookups) {
+    cout << "threads  cached lookups/s  direct lookups/s  hit rate\n";
+    cout.setf(ios::fixed);
+    for (const metro::CacheScaling& result : metro::object_cache_scaling(repo, threads, lookups)) {
+        cout.precision(0);
+        cout << setw(7) << result.threads << setw(18) << result.cachedRate << setw(18) << result.directRate;
+        cout.precision(1);
+        cout << setw(9) << result.hitRate * 100 << "%\n";
+        cout.flush();
+    }
+}
+
+Command perf {
+        "perf",
+        "Show how long Metro commands have taken in this repo, or benchmark the object cache",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("action");
+            }
+            string action = args.positionals[0];
+            if (action != "history" && action != "cache") {
+                throw UnexpectedPositionalException(action);
+            }
+            if (args.positionals.size() > 1) {
+                throw UnexpectedPositionalException(args.positionals[1]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            if (action == "history") {
+                int64_t days = (int64_t) positive_option(args, "window", DEFAULT_PERF_WINDOW_DAYS,
+                                                         "The window must be a positive number of days.");
+                print_perf_history(repo, days);
+            } else {
+                uint64_t threads = positive_option(args, "threads", DEFAULT_CACHE_BENCHMARK_THREADS,
+                                                   "The threads must be a positive number.");
+                uint64_t lookups = positive_option(args, "lookups", DEFAULT_CACHE_BENCHMARK_LOOKUPS,
+                                                   "The lookups must be a positive number.");
+                print_cache_scaling(repo, (unsigned int) min<uint64_t>(threads, 1024), lookups);
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro perf history [--window <days>]\n"
+                      << "       metro perf cache [--threads <max threads>] [--lookups <lookups per thread>]\n";
+        }
+};
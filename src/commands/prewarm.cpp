@@ -0,0 +1,22 @@
+#include "pch.h"
+
+Command prewarmCmd {
+        "prewarm",
+        "Read ahead the files of the branches you are likely to switch to",
+
+        // execute
+        [](const Arguments &args) {
+            if (!args.positionals.empty()) {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            size_t bytes = metro::prewarm(repo);
+            cout << "Prewarmed " << bytes << " bytes.\n";
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro prewarm\n";
+        }
+};
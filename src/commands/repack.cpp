@@ -0,0 +1,49 @@
+#include "pch.h"
+
+// Parse a positive number given for an option.
+size_t positive_option(const Arguments& args, const string& name, size_t defaultValue) {
+    if (args.options.count(name) == 0) {
+        return defaultValue;
+    }
+    size_t value = 0;
+    try {
+        value = stoull(args.options.at(name));
+    } catch (logic_error&) {}
+    if (value == 0) {
+        throw CommandArgumentException(name, "The " + name + " must be a positive number.");
+    }
+    return value;
+}
+
+Command repack {
+        "repack",
+        "Pack this repo's objects into one pack, storing similar objects as deltas",
+
+        // execute
+        [](const Arguments &args) {
+            if (!args.positionals.empty()) {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+            metro::PackWriterOptions options;
+            options.window = positive_option(args, "window", DEFAULT_PACK_WINDOW);
+            options.depth = positive_option(args, "depth", DEFAULT_PACK_DEPTH);
+
+            Repository repo = git::Repository::open(".");
+            metro::PackWriterStats stats = metro::repack(repo, options);
+            double seconds = stats.searchSeconds + stats.writeSeconds;
+            cout << "Packed " << stats.objects << " objects, " << stats.deltas << " as deltas, into pack-"
+                 << stats.name << ".\n";
+            cout.setf(ios::fixed);
+            cout.precision(1);
+            cout << "Objects take " << format_megabytes(stats.packBytes) << " packed, down from "
+                 << format_megabytes(stats.objectBytes) << " (" << (double) stats.objectBytes / max(stats.packBytes, (uintmax_t) 1)
+                 << "x).\n";
+            cout << "Searched for deltas in " << stats.searchSeconds << "s and wrote the pack in " << stats.writeSeconds
+                 << "s, " << stats.objectBytes / (1024.0 * 1024.0) / max(seconds, 0.001) << "MB/s.\n";
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro repack [--window <objects>] [--depth <deltas>]\n";
+        }
+};
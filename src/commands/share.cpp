@@ -0,0 +1,46 @@
+#include "pch.h"
+
+Command share {
+        "share",
+        "Share object storage with other repos on this machine",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("action");
+            }
+
+            Repository repo = git::Repository::open(".");
+            string action = args.positionals[0];
+            if (action == "join") {
+                if (args.positionals.size() < 2) {
+                    throw MissingPositionalException("pool");
+                }
+                if (args.positionals.size() > 2) {
+                    throw UnexpectedPositionalException(args.positionals[2]);
+                }
+                metro::join_shared_store(repo, args.positionals[1]);
+                cout << "Joined shared object store " << metro::shared_store_path(repo) << ".\n";
+                return;
+            }
+
+            if (args.positionals.size() > 1) {
+                throw UnexpectedPositionalException(args.positionals[1]);
+            }
+            if (action == "leave") {
+                metro::leave_shared_store(repo);
+                cout << "Left shared object store.\n";
+            } else if (action == "gc") {
+                metro::SharedStoreStats stats = metro::gc_shared_store(repo);
+                cout << "Kept " << stats.kept << " objects used by " << stats.repos << " repos, removed "
+                     << stats.removed << " unused objects.\n";
+            } else {
+                throw UnexpectedPositionalException(action);
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro share <join <pool>/leave/gc>\n";
+        }
+};
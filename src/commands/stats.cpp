@@ -0,0 +1,97 @@
+#include "pch.h"
+
+// The number of entries shown in each list.
+#define CHURN_REPORT_SIZE 10
+// The number of authors shown for each path.
+#define CHURN_REPORT_AUTHORS 3
+
+// The authors who changed a path most, by name, most changes first.
+string top_authors(const metro::PathChurn& churn) {
+    vector<pair<uint32_t, string>> authors;
+    for (const auto& [author, count] : churn.authors) {
+        authors.emplace_back(count, author.substr(0, author.find(" <")));
+    }
+    sort(authors.begin(), authors.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    string names;
+    for (size_t i = 0; i < authors.size() && i < CHURN_REPORT_AUTHORS; i++) {
+        names += (i == 0? "" : ", ") + authors[i].second + " (" + to_string(authors[i].first) + ")";
+    }
+    return names;
+}
+
+// Print the paths with the highest value of count, ignoring those where it is zero.
+void print_top_paths(const string& title, const vector<pair<const string*, const metro::PathChurn*>>& paths,
+                     const function<uint32_t(const metro::PathChurn&)>& count) {
+    vector<pair<const string*, const metro::PathChurn*>> top;
+    for (const auto& path : paths) {
+        if (count(*path.second) > 0) {
+            top.push_back(path);
+        }
+    }
+    size_t size = min(top.size(), (size_t) CHURN_REPORT_SIZE);
+    partial_sort(top.begin(), top.begin() + size, top.end(), [&](const auto& a, const auto& b) {
+        return count(*a.second) > count(*b.second);
+    });
+
+    cout << title << "\n";
+    for (size_t i = 0; i < size; i++) {
+        cout << "  " << count(*top[i].second) << "  " << *top[i].first;
+        if (!top[i].second->authors.empty()) {
+            cout << "  " << top_authors(*top[i].second);
+        }
+        cout << "\n";
+    }
+}
+
+Command stats {
+        "stats",
+        "Show which files change and conflict most often",
+
+        // execute
+        [](const Arguments &args) {
+            if (args.positionals.empty()) {
+                throw MissingPositionalException("report");
+            }
+            if (args.positionals[0] != "churn") {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+            if (args.positionals.size() > 1) {
+                throw UnexpectedPositionalException(args.positionals[1]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            metro::CommitIndex index(repo);
+            index.update(repo);
+            metro::ChurnStats churn(repo);
+            churn.update(repo, index);
+
+            vector<pair<const string*, const metro::PathChurn*>> files, dirs;
+            for (const auto& [path, pathChurn] : churn.path_stats()) {
+                (has_suffix(path, "/")? dirs : files).emplace_back(&path, &pathChurn);
+            }
+            auto changes = [](const metro::PathChurn& pathChurn) { return pathChurn.changes; };
+            auto conflicts = [](const metro::PathChurn& pathChurn) { return pathChurn.conflicts; };
+            print_top_paths("Most changed files:", files, changes);
+            print_top_paths("Most changed directories:", dirs, changes);
+            print_top_paths("Most conflicted files:", files, conflicts);
+
+            vector<pair<const pair<string, string>*, uint32_t>> pairs;
+            for (const auto& [pair, count] : churn.co_changes()) {
+                pairs.emplace_back(&pair, count);
+            }
+            size_t size = min(pairs.size(), (size_t) CHURN_REPORT_SIZE);
+            partial_sort(pairs.begin(), pairs.begin() + size, pairs.end(), [](const auto& a, const auto& b) {
+                return a.second > b.second;
+            });
+            cout << "Files most often changed together:\n";
+            for (size_t i = 0; i < size; i++) {
+                cout << "  " << pairs[i].second << "  " << pairs[i].first->first << "  " << pairs[i].first->second << "\n";
+            }
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro stats churn\n";
+        }
+};
@@ -15,8 +15,18 @@ Command switchCmd {
             string name = args.positionals[0];
 
             Repository repo = git::Repository::open(".");
-            metro::switch_branch(repo, name);
+            metro::CheckoutReport report = metro::switch_branch(repo, name);
             cout << "Switched to branch " << name << ".\n";
+            if (report.missingLfsFiles > 0) {
+                cerr << report.missingLfsFiles << " large files couldn't be downloaded and were left as LFS pointers. "
+                     << "Run metro lfs fetch to try again.\n";
+            }
+            for (const string& path : report.skippedSubmodules) {
+                cerr << "Submodule " << path << " doesn't have the commit recorded for it yet, so it was left as it was. "
+                     << "Fetch it and switch again to update it.\n";
+            }
+            // Get ready for the next switch while the user works.
+            metro::prewarm_in_background(repo);
         },
 
         // printHelp
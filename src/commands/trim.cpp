@@ -0,0 +1,50 @@
+#include "pch.h"
+
+// Format a number of bytes in megabytes.
+string format_megabytes(uintmax_t bytes) {
+    stringstream out;
+    out.setf(ios::fixed);
+    out.precision(1);
+    out << bytes / (1024.0 * 1024.0) << "MB";
+    return out.str();
+}
+
+Command trim {
+        "trim",
+        "Delete old history from this repo to save space",
+
+        // execute
+        [](const Arguments &args) {
+            if (!args.positionals.empty()) {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+            if (args.options.count("keep") == 0) {
+                throw CommandArgumentException("keep", "Give how much history to keep with --keep.");
+            }
+
+            // A plain number is a count of commits, anything else a length of time.
+            string keep = args.options.at("keep");
+            metro::TrimLimit limit;
+            int64_t seconds;
+            if (!keep.empty() && keep.find_first_not_of("0123456789") == string::npos) {
+                limit.count = stoull(keep);
+            } else if (parse_duration(keep, seconds)) {
+                limit.since = chrono::duration_cast<chrono::seconds>(
+                        chrono::system_clock::now().time_since_epoch()).count() - seconds;
+            }
+            if (limit.count == 0 && limit.since == 0) {
+                throw CommandArgumentException("keep", "Give a number of commits or a length of time such as 90d.");
+            }
+
+            Repository repo = git::Repository::open(".");
+            metro::TrimStats stats = metro::trim_history(repo, limit);
+            cout << "Kept " << stats.keptCommits << " commits, cut off at " << stats.boundaryCommits << ".\n";
+            cout << "Objects take " << format_megabytes(stats.bytesAfter) << ", down from "
+                 << format_megabytes(stats.bytesBefore) << ".\n";
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro trim --keep <number of commits|time such as 90d>\n";
+        }
+};
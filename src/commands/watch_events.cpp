@@ -0,0 +1,35 @@
+#include "pch.h"
+
+Command watchEvents {
+        "watch-events",
+        "Print changes to the repo as they happen",
+
+        // execute
+        [](const Arguments &args) {
+            if (!args.positionals.empty()) {
+                throw UnexpectedPositionalException(args.positionals[0]);
+            }
+
+            Repository repo = git::Repository::open(".");
+            metro::watch_events(repo, [](const metro::RepoEvent& event) {
+                string name = metro::event_type_name(event.type);
+                if (event.type == metro::RepoEventType::PathsDirtied) {
+                    for (const string& path : event.paths) {
+                        cout << name << " " << path << "\n";
+                    }
+                } else if (event.detail.empty()) {
+                    cout << name << "\n";
+                } else {
+                    cout << name << " " << event.detail << "\n";
+                }
+                // Flush each batch so that tools reading the output see it straight away.
+                cout.flush();
+                return true;
+            });
+        },
+
+        // printHelp
+        [](const Arguments &args) {
+            std::cout << "Usage: metro watch-events\n";
+        }
+};
@@ -0,0 +1,34 @@
+#include "pch.h"
+
+#ifndef _WIN32
+#include <openssl/evp.h>
+
+Digest::Digest(DigestType type) : context(EVP_MD_CTX_new()) {
+    EVP_DigestInit_ex(static_cast<EVP_MD_CTX*>(context), type == DigestType::Sha1? EVP_sha1() : EVP_sha256(), nullptr);
+}
+
+Digest::~Digest() {
+    EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(context));
+}
+
+void Digest::update(const char *data, size_t size) {
+    EVP_DigestUpdate(static_cast<EVP_MD_CTX*>(context), data, size);
+}
+
+string Digest::finish() {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int size;
+    EVP_DigestFinal_ex(static_cast<EVP_MD_CTX*>(context), digest, &size);
+    return string(reinterpret_cast<char*>(digest), size);
+}
+
+string Digest::hex() {
+    string out;
+    char byte[3];
+    for (char c : finish()) {
+        snprintf(byte, sizeof(byte), "%02x", (unsigned char) c);
+        out += byte;
+    }
+    return out;
+}
+#endif
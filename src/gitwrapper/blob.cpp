@@ -0,0 +1,16 @@
+namespace git {
+    const char *Blob::rawcontent() const {
+        GIT_CALL_PROBE();
+        return static_cast<const char*>(git_blob_rawcontent(blob.get()));
+    }
+
+    size_t Blob::rawsize() const {
+        GIT_CALL_PROBE();
+        return git_blob_rawsize(blob.get());
+    }
+
+    BlobView Blob::view() const {
+        GIT_CALL_PROBE();
+        return BlobView(blob, rawcontent(), rawsize());
+    }
+}
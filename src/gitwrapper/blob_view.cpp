@@ -0,0 +1,46 @@
+#ifdef __unix__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace git {
+#ifdef __unix__
+    BlobView BlobView::map_file(const string& path) {
+        GIT_CALL_PROBE();
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw MetroException("Failed to open " + path + ": " + strerror(errno));
+        }
+        struct stat info {};
+        if (fstat(fd, &info) < 0) {
+            close(fd);
+            throw MetroException("Failed to read " + path + ": " + strerror(errno));
+        }
+        // Zero-length mappings aren't allowed.
+        if (info.st_size == 0) {
+            close(fd);
+            return BlobView();
+        }
+
+        size_t size = info.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw MetroException("Failed to map " + path + ": " + strerror(errno));
+        }
+
+        shared_ptr<const void> owner(mapped, [size](const void *start) {
+            munmap(const_cast<void*>(start), size);
+        });
+        return BlobView(owner, static_cast<const char*>(mapped), size);
+    }
+#else
+    BlobView BlobView::map_file(const string& path) {
+        GIT_CALL_PROBE();
+        auto contents = make_shared<string>(read_all(path));
+        return BlobView(contents, contents->data(), contents->size());
+    }
+#endif
+}
@@ -0,0 +1,16 @@
+namespace git {
+    void BlobWriter::write(const char *data, size_t size) {
+        GIT_CALL_PROBE();
+        int err = stream->write(stream, data, size);
+        check_error(err);
+    }
+
+    OID BlobWriter::commit() {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_blob_create_from_stream_commit(&id, stream);
+        stream = nullptr;
+        check_error(err);
+        return OID(id);
+    }
+}
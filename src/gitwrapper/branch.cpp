@@ -1,5 +1,6 @@
 namespace git {
     string Branch::name() const {
+        GIT_CALL_PROBE();
         const char *out;
         int err = git_branch_name(&out, ref.get());
         check_error(err);
@@ -7,17 +8,25 @@ namespace git {
     }
 
     bool Branch::is_head() const {
+        GIT_CALL_PROBE();
         int result = git_branch_is_head(ref.get());
         check_error(result);
         return result;
     }
 
     void Branch::delete_branch() {
+        GIT_CALL_PROBE();
         int err = git_branch_delete(ref.get());
         check_error(err);
     }
 
+    OID Branch::target() const {
+        GIT_CALL_PROBE();
+        return OID(*git_reference_target(ref.get()));
+    }
+
     string Branch::reference_name() const {
+        GIT_CALL_PROBE();
         const char *out;
         out = git_reference_name(ref.get());
         return string(out);
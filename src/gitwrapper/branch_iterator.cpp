@@ -1,5 +1,6 @@
 namespace git {
     bool BranchIterator::next(Branch *branch) const {
+        GIT_CALL_PROBE();
         git_reference* ref;
         git_branch_t branchType;
         int err = git_branch_next(&ref, &branchType, iter.get());
@@ -2,14 +2,27 @@
 
 namespace git {
     string Commit::message() const {
+        GIT_CALL_PROBE();
         return string(git_commit_message(commit.get()));
     }
 
     OID Commit::id() const {
+        GIT_CALL_PROBE();
         return OID(*git_commit_id(commit.get()));
     }
 
+    const git_signature *Commit::author() const {
+        GIT_CALL_PROBE();
+        return git_commit_author(commit.get());
+    }
+
+    int64_t Commit::time() const {
+        GIT_CALL_PROBE();
+        return git_commit_time(commit.get());
+    }
+
     Tree Commit::tree() const {
+        GIT_CALL_PROBE();
         git_tree *tree;
         int err = git_commit_tree(&tree, commit.get());
         check_error(err);
@@ -17,17 +30,25 @@ namespace git {
     }
 
     unsigned int Commit::parentcount() const {
+        GIT_CALL_PROBE();
         return git_commit_parentcount(commit.get());
     }
 
     Commit Commit::parent(unsigned int n) const {
+        GIT_CALL_PROBE();
         git_commit *parent;
         int err = git_commit_parent(&parent, commit.get(), n);
         check_error(err);
         return Commit(parent);
     }
 
+    OID Commit::parent_id(unsigned int n) const {
+        GIT_CALL_PROBE();
+        return OID(*git_commit_parent_id(commit.get(), n));
+    }
+
     vector<Commit> Commit::parents() const {
+        GIT_CALL_PROBE();
         vector<Commit> parents;
         unsigned int count = parentcount();
         for (unsigned int i = 0; i < count; i++) {
@@ -0,0 +1,24 @@
+#include "pch.h"
+
+namespace git {
+    Config Config::open_file(const string& path) {
+        GIT_CALL_PROBE();
+        git_config *config;
+        int err = git_config_open_ondisk(&config, path.c_str());
+        check_error(err);
+        return Config(config);
+    }
+
+    bool Config::get_string(const string& name, string& out) const {
+        GIT_CALL_PROBE();
+        git_buf buf {};
+        int err = git_config_get_string_buf(&buf, config.get(), name.c_str());
+        if (err == GIT_ENOTFOUND) {
+            return false;
+        }
+        check_error(err);
+        out = string(buf.ptr, buf.size);
+        git_buf_dispose(&buf);
+        return true;
+    }
+}
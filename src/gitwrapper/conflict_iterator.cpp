@@ -1,5 +1,6 @@
 namespace git {
     bool ConflictIterator::next(Conflict &out) const {
+        GIT_CALL_PROBE();
         const git_index_entry *ancestor;
         const git_index_entry *ours;
         const git_index_entry *theirs;
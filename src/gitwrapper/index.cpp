@@ -1,11 +1,37 @@
 namespace git {
 
     void Index::add_all(const StrArray pathspec, unsigned int flags, MatchedPathCallback callback) {
+        GIT_CALL_PROBE();
         int err = git_index_add_all(index.get(), &pathspec, flags, callback, nullptr);
         check_error(err);
     }
 
+    void Index::add(const git_index_entry& entry) {
+        GIT_CALL_PROBE();
+        int err = git_index_add(index.get(), &entry);
+        check_error(err);
+    }
+
+    void Index::add_bypath(const string& path) {
+        GIT_CALL_PROBE();
+        int err = git_index_add_bypath(index.get(), path.c_str());
+        check_error(err);
+    }
+
+    void Index::read_tree(const Tree& tree) {
+        GIT_CALL_PROBE();
+        int err = git_index_read_tree(index.get(), tree.ptr().get());
+        check_error(err);
+    }
+
+    void Index::remove_bypath(const string& path) {
+        GIT_CALL_PROBE();
+        int err = git_index_remove_bypath(index.get(), path.c_str());
+        check_error(err);
+    }
+
     OID Index::write_tree() {
+        GIT_CALL_PROBE();
         git_oid oid;
         int err = git_index_write_tree(&oid, index.get());
         check_error(err);
@@ -13,10 +39,49 @@ namespace git {
     }
 
     void Index::write() {
+        GIT_CALL_PROBE();
         git_index_write(index.get());
     }
 
+    // Order entries the way the index does: by path, then by stage.
+    bool entry_before(const git_index_entry& a, const git_index_entry& b) {
+        GIT_CALL_PROBE();
+        int cmp = strcmp(a.path, b.path);
+        return cmp < 0 || (cmp == 0 && git_index_entry_stage(&a) < git_index_entry_stage(&b));
+    }
+
+    void Index::replace_entries(const set<string>& paths, vector<git_index_entry> entries) {
+        GIT_CALL_PROBE();
+        sort(entries.begin(), entries.end(), entry_before);
+
+        git_index *rebuiltIndex;
+        int err = git_index_new(&rebuiltIndex);
+        check_error(err);
+        Index rebuilt(rebuiltIndex);
+
+        // Merge the kept entries with the new ones, so every insertion is at the end of the index.
+        size_t next = 0;
+        size_t count = entrycount();
+        for (size_t i = 0; i < count; i++) {
+            const git_index_entry *entry = get_byindex(i);
+            if (paths.count(entry->path) > 0) {
+                continue;
+            }
+            for (; next < entries.size() && entry_before(entries[next], *entry); next++) {
+                rebuilt.add(entries[next]);
+            }
+            rebuilt.add(*entry);
+        }
+        for (; next < entries.size(); next++) {
+            rebuilt.add(entries[next]);
+        }
+
+        err = git_index_read_index(index.get(), rebuilt.ptr().get());
+        check_error(err);
+    }
+
     ConflictIterator Index::conflict_iterator() const {
+        GIT_CALL_PROBE();
         git_index_conflict_iterator *it;
         int err = git_index_conflict_iterator_new(&it, index.get());
         check_error(err);
@@ -24,20 +89,65 @@ namespace git {
     }
 
     size_t Index::entrycount() const {
+        GIT_CALL_PROBE();
         return git_index_entrycount(index.get());
     }
 
+    const git_index_entry *Index::get_byindex(size_t n) const {
+        GIT_CALL_PROBE();
+        return git_index_get_byindex(index.get(), n);
+    }
+
+    void Index::for_each_conflict(const function<void(const Conflict&)>& callback) const {
+        GIT_CALL_PROBE();
+        size_t count = entrycount();
+        for (size_t i = 0; i < count;) {
+            const git_index_entry *entry = get_byindex(i);
+            if (git_index_entry_stage(entry) == 0) {
+                i++;
+                continue;
+            }
+
+            // The stages of a conflicted path are next to each other in the index.
+            Conflict conflict(nullptr, nullptr, nullptr);
+            const char *path = entry->path;
+            for (; i < count && (entry = get_byindex(i)) != nullptr && strcmp(entry->path, path) == 0; i++) {
+                // Stages 1, 2 and 3 are the ancestor, ours and theirs.
+                switch (git_index_entry_stage(entry)) {
+                    case 1: conflict.ancestor = entry; break;
+                    case 2: conflict.ours = entry; break;
+                    case 3: conflict.theirs = entry; break;
+                }
+            }
+            callback(conflict);
+        }
+    }
+
     void Index::add_conflict(const git::Conflict &conflict) const {
+        GIT_CALL_PROBE();
         int err = git_index_conflict_add(index.get(), conflict.ancestor, conflict.ours, conflict.theirs);
         check_error(err);
     }
 
+    void Index::add_conflicts(const vector<StandaloneConflict>& conflicts) {
+        GIT_CALL_PROBE();
+        set<string> paths;
+        vector<git_index_entry> entries;
+        for (const Conflict& conflict : conflicts) {
+            conflict.append_entries(entries);
+            paths.insert(conflict.path());
+        }
+        replace_entries(paths, entries);
+    }
+
     void Index::cleanup_conflicts() const {
+        GIT_CALL_PROBE();
         int err = git_index_conflict_cleanup(index.get());
         check_error(err);
     }
 
     bool Index::has_conflicts() const {
+        GIT_CALL_PROBE();
         return git_index_has_conflicts(index.get());
     }
 }
\ No newline at end of file
@@ -0,0 +1,25 @@
+#include "pch.h"
+
+namespace git {
+    Indexer Indexer::open(const string& packDir) {
+        GIT_CALL_PROBE();
+        git_indexer *indexer;
+        int err = git_indexer_new(&indexer, packDir.c_str(), 0, nullptr, nullptr);
+        check_error(err);
+        return Indexer(indexer);
+    }
+
+    void Indexer::append(const char *data, size_t size) const {
+        GIT_CALL_PROBE();
+        git_indexer_progress stats;
+        int err = git_indexer_append(indexer.get(), data, size, &stats);
+        check_error(err);
+    }
+
+    void Indexer::commit() const {
+        GIT_CALL_PROBE();
+        git_indexer_progress stats;
+        int err = git_indexer_commit(indexer.get(), &stats);
+        check_error(err);
+    }
+}
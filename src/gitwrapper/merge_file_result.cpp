@@ -0,0 +1,13 @@
+namespace git {
+    MergeFileResult MergeFileResult::merge(const git_merge_file_input *ancestor, const git_merge_file_input& ours,
+                                           const git_merge_file_input& theirs, const git_merge_file_options& options) {
+        GIT_CALL_PROBE();
+        auto result = new git_merge_file_result();
+        int err = git_merge_file(result, ancestor, &ours, &theirs, &options);
+        if (err < 0) {
+            delete result;
+        }
+        check_error(err);
+        return MergeFileResult(result);
+    }
+}
@@ -0,0 +1,78 @@
+namespace git {
+    ODB ODB::open_directory(const string& objectsDir) {
+        GIT_CALL_PROBE();
+        git_odb *odb;
+        int err = git_odb_new(&odb);
+        check_error(err);
+        ODB result(odb);
+
+        result.add_loose_backend(objectsDir, 1);
+        git_odb_backend *packed;
+        err = git_odb_backend_pack(&packed, objectsDir.c_str());
+        check_error(err);
+        err = git_odb_add_backend(odb, packed, 2);
+        check_error(err);
+        return result;
+    }
+
+    void ODB::add_loose_backend(const string& objectsDir, int priority) const {
+        GIT_CALL_PROBE();
+        git_odb_backend *loose;
+        int err = git_odb_backend_loose(&loose, objectsDir.c_str(), -1, 0, 0, 0);
+        check_error(err);
+        err = git_odb_add_backend(odb.get(), loose, priority);
+        check_error(err);
+    }
+
+    bool ODB::exists(const OID& id) const {
+        GIT_CALL_PROBE();
+        return git_odb_exists(odb.get(), &id.oid);
+    }
+
+    OdbObject ODB::read(const OID& id) const {
+        GIT_CALL_PROBE();
+        git_odb_object *object;
+        int err = git_odb_read(&object, odb.get(), &id.oid);
+        check_error(err);
+        return OdbObject(object);
+    }
+
+    size_t ODB::read_size(const OID& id) const {
+        GIT_CALL_PROBE();
+        size_t size;
+        git_object_t type;
+        read_header(id, type, size);
+        return size;
+    }
+
+    void ODB::read_header(const OID& id, git_object_t& type, size_t& size) const {
+        GIT_CALL_PROBE();
+        int err = git_odb_read_header(&size, &type, odb.get(), &id.oid);
+        check_error(err);
+    }
+
+    OID ODB::write(const char *data, size_t size, git_object_t type) const {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_odb_write(&id, odb.get(), data, size, type);
+        check_error(err);
+        return OID(id);
+    }
+
+    OID ODB::hash(const char *data, size_t size, git_object_t type) {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_odb_hash(&id, data, size, type);
+        check_error(err);
+        return OID(id);
+    }
+
+    void ODB::foreach(const function<void(const OID&)>& callback) const {
+        GIT_CALL_PROBE();
+        int err = git_odb_foreach(odb.get(), [](const git_oid *id, void *payload) {
+            (*static_cast<const function<void(const OID&)>*>(payload))(OID(*id));
+            return 0;
+        }, const_cast<function<void(const OID&)>*>(&callback));
+        check_error(err);
+    }
+}
@@ -0,0 +1,25 @@
+namespace git {
+    void PackBuilder::insert(const OID& id) const {
+        GIT_CALL_PROBE();
+        int err = git_packbuilder_insert(builder.get(), &id.oid, nullptr);
+        check_error(err);
+    }
+
+    void PackBuilder::insert_recursive(const OID& id) const {
+        GIT_CALL_PROBE();
+        int err = git_packbuilder_insert_recur(builder.get(), &id.oid, nullptr);
+        check_error(err);
+    }
+
+    void PackBuilder::insert_commit(const OID& id) const {
+        GIT_CALL_PROBE();
+        int err = git_packbuilder_insert_commit(builder.get(), &id.oid);
+        check_error(err);
+    }
+
+    void PackBuilder::write(const string& packDir) const {
+        GIT_CALL_PROBE();
+        int err = git_packbuilder_write(builder.get(), packDir.c_str(), 0, nullptr, nullptr);
+        check_error(err);
+    }
+}
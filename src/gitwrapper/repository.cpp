@@ -2,6 +2,7 @@
 
 namespace git {
     Repository Repository::init(const string& path, bool isBare) {
+        GIT_CALL_PROBE();
         git_repository *gitRepo = nullptr;
         int err = git_repository_init(&gitRepo, path.c_str(), isBare);
         check_error(err);
@@ -10,6 +11,7 @@ namespace git {
     }
 
     Repository Repository::open(const string& path) {
+        GIT_CALL_PROBE();
         git_repository *gitRepo = nullptr;
         int err = git_repository_open(&gitRepo, path.c_str());
         check_error(err);
@@ -18,11 +20,13 @@ namespace git {
     }
 
     bool Repository::exists(const string& path) {
+        GIT_CALL_PROBE();
         int err = git_repository_open_ext(nullptr, path.c_str(), GIT_REPOSITORY_OPEN_NO_SEARCH, nullptr);
         return err >= 0;
     }
 
     Signature &Repository::default_signature() const {
+        GIT_CALL_PROBE();
         git_signature *sig;
         int err = git_signature_default(&sig, repo.get());
         check_error(err);
@@ -30,24 +34,113 @@ namespace git {
     }
 
     string Repository::path() const {
+        GIT_CALL_PROBE();
         return string(git_repository_path(repo.get()));
     }
 
+    string Repository::workdir() const {
+        GIT_CALL_PROBE();
+        return string(git_repository_workdir(repo.get()));
+    }
+
+    bool Repository::is_ignored(const string& path) const {
+        GIT_CALL_PROBE();
+        int ignored;
+        int err = git_ignore_path_is_ignored(&ignored, repo.get(), path.c_str());
+        check_error(err);
+        return ignored;
+    }
+
     Index Repository::index() const {
+        GIT_CALL_PROBE();
         git_index *index;
         int err = git_repository_index(&index, repo.get());
         check_error(err);
         return Index(index);
     }
 
+    ODB Repository::odb() const {
+        GIT_CALL_PROBE();
+        git_odb *odb;
+        int err = git_repository_odb(&odb, repo.get());
+        check_error(err);
+        return ODB(odb);
+    }
+
+    Config Repository::config() const {
+        GIT_CALL_PROBE();
+        git_config *config;
+        int err = git_repository_config(&config, repo.get());
+        check_error(err);
+        return Config(config);
+    }
+
+    Commit Repository::lookup_commit(const OID &oid) const {
+        GIT_CALL_PROBE();
+        git_commit *commit;
+        int err = git_commit_lookup(&commit, repo.get(), &oid.oid);
+        check_error(err);
+        return Commit(commit);
+    }
+
     Tree Repository::lookup_tree(const OID &oid) const {
+        GIT_CALL_PROBE();
         git_tree *tree;
         int err = git_tree_lookup(&tree, repo.get(), &oid.oid);
         check_error(err);
         return Tree(tree);
     }
 
+    Blob Repository::lookup_blob(const OID &oid) const {
+        GIT_CALL_PROBE();
+        git_blob *blob;
+        int err = git_blob_lookup(&blob, repo.get(), &oid.oid);
+        check_error(err);
+        return Blob(blob);
+    }
+
+    OID Repository::create_blob(const char *data, size_t size) const {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_blob_create_from_buffer(&id, repo.get(), data, size);
+        check_error(err);
+        return OID(id);
+    }
+
+    OID Repository::create_blob_from_workdir(const string& path) const {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_blob_create_from_workdir(&id, repo.get(), path.c_str());
+        check_error(err);
+        return OID(id);
+    }
+
+    OID Repository::hash_workdir_file(const string& path) const {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_repository_hashfile(&id, repo.get(), (workdir() + path).c_str(), GIT_OBJECT_BLOB, path.c_str());
+        check_error(err);
+        return OID(id);
+    }
+
+    unique_ptr<BlobWriter> Repository::create_blob_writer() const {
+        GIT_CALL_PROBE();
+        git_writestream *stream;
+        int err = git_blob_create_from_stream(&stream, repo.get(), nullptr);
+        check_error(err);
+        return make_unique<BlobWriter>(stream);
+    }
+
+    OID Repository::create_updated_tree(const Tree& baseline, const vector<git_tree_update>& updates) const {
+        GIT_CALL_PROBE();
+        git_oid id;
+        int err = git_tree_create_updated(&id, repo.get(), baseline.ptr().get(), updates.size(), updates.data());
+        check_error(err);
+        return OID(id);
+    }
+
     Branch Repository::lookup_branch(const string &name, git_branch_t branchType) const {
+        GIT_CALL_PROBE();
         git_reference *branch;
         int err = git_branch_lookup(&branch, repo.get(), name.c_str(), branchType);
         check_error(err);
@@ -55,6 +148,7 @@ namespace git {
     }
 
     AnnotatedCommit Repository::lookup_annotated_commit(const OID& id) const {
+        GIT_CALL_PROBE();
         git_annotated_commit *commit;
         int err = git_annotated_commit_lookup(&commit, repo.get(), &id.oid);
         check_error(err);
@@ -64,6 +158,7 @@ namespace git {
     OID Repository::create_commit(const string& update_ref, const Signature &author, const Signature &committer,
                               const string& message_encoding, const string& message, const Tree& tree,
                               vector<Commit> parents) const {
+        GIT_CALL_PROBE();
         auto parents_array = new const git_commit *[parents.size()];
         for (unsigned long long i = 0; i < parents.size(); i++) {
             parents_array[i] = parents[i].ptr().get();
@@ -78,6 +173,7 @@ namespace git {
     }
 
     Object Repository::revparse_single(const string& spec) const {
+        GIT_CALL_PROBE();
         git_object *obj;
         int err = git_revparse_single(&obj, repo.get(), spec.c_str());
         check_error(err);
@@ -85,24 +181,67 @@ namespace git {
     }
 
     void Repository::reset_to_commit(const Commit &commit, ResetType type, const CheckoutOptions ops) const {
+        GIT_CALL_PROBE();
         int err = git_reset(repo.get(), (git_object*) commit.ptr().get(), type, &ops);
         check_error(err);
     }
 
     void Repository::create_branch(const string& branch_name, Commit &target, bool force) const {
+        GIT_CALL_PROBE();
         git_reference *ref;
         int err = git_branch_create(&ref, repo.get(), branch_name.c_str(), target.ptr().get(), force);
         check_error(err);
     }
 
     BranchIterator Repository::new_branch_iterator(const git_branch_t& flags) const {
+        GIT_CALL_PROBE();
         git_branch_iterator *iter;
         int err = git_branch_iterator_new(&iter, repo.get(), flags);
         check_error(err);
         return BranchIterator(iter);
     }
 
+    vector<OID> Repository::reference_targets() const {
+        GIT_CALL_PROBE();
+        git_reference_iterator *iter;
+        int err = git_reference_iterator_new(&iter, repo.get());
+        check_error(err);
+        shared_ptr<git_reference_iterator> iterPtr(iter, git_reference_iterator_free);
+
+        vector<OID> targets;
+        git_reference *ref;
+        while ((err = git_reference_next(&ref, iter)) == 0) {
+            // Symbolic references have no target of their own.
+            const git_oid *target = git_reference_target(ref);
+            if (target != nullptr) {
+                targets.emplace_back(*target);
+            }
+            git_reference_free(ref);
+        }
+        if (err != GIT_ITEROVER) {
+            check_error(err);
+        }
+        return targets;
+    }
+
+    RevWalk Repository::new_revwalk() const {
+        GIT_CALL_PROBE();
+        git_revwalk *walk;
+        int err = git_revwalk_new(&walk, repo.get());
+        check_error(err);
+        return RevWalk(walk);
+    }
+
+    PackBuilder Repository::new_packbuilder() const {
+        GIT_CALL_PROBE();
+        git_packbuilder *builder;
+        int err = git_packbuilder_new(&builder, repo.get());
+        check_error(err);
+        return PackBuilder(builder);
+    }
+
     StatusList Repository::new_status_list(const git_status_options &options) const {
+        GIT_CALL_PROBE();
         git_status_list *status;
         int err = git_status_list_new(&status, repo.get(), &options);
         check_error(err);
@@ -110,21 +249,89 @@ namespace git {
     }
 
     void Repository::set_head(const string& name) const {
+        GIT_CALL_PROBE();
         int err = git_repository_set_head(repo.get(), name.c_str());
         check_error(err);
     }
 
+    void Repository::set_head_detached(const OID& commit) const {
+        GIT_CALL_PROBE();
+        int err = git_repository_set_head_detached(repo.get(), &commit.oid);
+        check_error(err);
+    }
+
+    vector<string> Repository::submodule_paths() const {
+        GIT_CALL_PROBE();
+        vector<string> paths;
+        int err = git_submodule_foreach(repo.get(), [](git_submodule *submodule, const char *name, void *payload) {
+            static_cast<vector<string>*>(payload)->emplace_back(git_submodule_path(submodule));
+            return 0;
+        }, &paths);
+        check_error(err);
+        return paths;
+    }
+
     void Repository::checkout_tree(const Tree& tree, const git_checkout_options& options) const {
+        GIT_CALL_PROBE();
         int err = git_checkout_tree(repo.get(), reinterpret_cast<git_object*>(tree.ptr().get()), &options);
         check_error(err);
     }
 
+    void Repository::add_worktree(const string& name, const string& path) const {
+        GIT_CALL_PROBE();
+        git_worktree *worktree;
+        int err = git_worktree_add(&worktree, repo.get(), name.c_str(), path.c_str(), nullptr);
+        check_error(err);
+        git_worktree_free(worktree);
+    }
+
+    void Repository::prune_worktree(const string& name) const {
+        GIT_CALL_PROBE();
+        git_worktree *worktree;
+        int err = git_worktree_lookup(&worktree, repo.get(), name.c_str());
+        if (err == GIT_ENOTFOUND) {
+            return;
+        }
+        check_error(err);
+
+        git_worktree_prune_options options = GIT_WORKTREE_PRUNE_OPTIONS_INIT;
+        options.flags = GIT_WORKTREE_PRUNE_VALID | GIT_WORKTREE_PRUNE_LOCKED;
+        err = git_worktree_prune(worktree, &options);
+        git_worktree_free(worktree);
+        check_error(err);
+    }
+
+    vector<Repository> Repository::worktrees() const {
+        GIT_CALL_PROBE();
+        git_strarray names;
+        int err = git_worktree_list(&names, repo.get());
+        check_error(err);
+        shared_ptr<git_strarray> namesPtr(&names, git_strarray_dispose);
+
+        vector<Repository> worktrees;
+        for (size_t i = 0; i < names.count; i++) {
+            git_worktree *worktree;
+            if (git_worktree_lookup(&worktree, repo.get(), names.strings[i]) < 0) {
+                continue;
+            }
+            shared_ptr<git_worktree> worktreePtr(worktree, git_worktree_free);
+            // A worktree whose directory was deleted without pruning it can't be opened.
+            git_repository *gitRepo = nullptr;
+            if (git_worktree_validate(worktree) == 0 && git_repository_open_from_worktree(&gitRepo, worktree) == 0) {
+                worktrees.push_back(Repository(gitRepo));
+            }
+        }
+        return worktrees;
+    }
+
     void Repository::cleanup_state() const {
+        GIT_CALL_PROBE();
         int err = git_repository_state_cleanup(repo.get());
         check_error(err);
     }
 
     git_merge_analysis_t Repository::merge_analysis(const vector<AnnotatedCommit>& sources) const {
+        GIT_CALL_PROBE();
         git_merge_analysis_t analysis;
         git_merge_preference_t preference;
 
@@ -141,6 +348,7 @@ namespace git {
 
     void Repository::merge(const vector<AnnotatedCommit>& sources, const git_merge_options &merge_opts,
                            const git_checkout_options &checkout_opts) const {
+        GIT_CALL_PROBE();
         auto sources_array = new const git_annotated_commit*[sources.size()];
         for (size_t i = 0; i < sources.size(); i++) {
             sources_array[i] = sources[i].ptr().get();
@@ -150,4 +358,29 @@ namespace git {
         delete[] sources_array;
         check_error(err);
     }
+
+    OID Repository::merge_base(const OID& one, const OID& two) const {
+        GIT_CALL_PROBE();
+        git_oid base;
+        int err = git_merge_base(&base, repo.get(), &one.oid, &two.oid);
+        check_error(err);
+        return OID(base);
+    }
+
+    Index Repository::merge_trees(const Tree& ancestor, const Tree& ours, const Tree& theirs,
+                                  const git_merge_options& options) const {
+        GIT_CALL_PROBE();
+        git_index *index;
+        int err = git_merge_trees(&index, repo.get(), ancestor.ptr().get(), ours.ptr().get(), theirs.ptr().get(), &options);
+        check_error(err);
+        return Index(index);
+    }
+
+    Diff Repository::diff_tree_to_tree(const Tree& oldTree, const Tree& newTree, const git_diff_options& options) const {
+        GIT_CALL_PROBE();
+        git_diff *diff;
+        int err = git_diff_tree_to_tree(&diff, repo.get(), oldTree.ptr().get(), newTree.ptr().get(), &options);
+        check_error(err);
+        return Diff(diff);
+    }
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+namespace git {
+    void RevWalk::push(const OID& id) const {
+        GIT_CALL_PROBE();
+        int err = git_revwalk_push(walk.get(), &id.oid);
+        check_error(err);
+    }
+
+    void RevWalk::hide(const OID& id) const {
+        GIT_CALL_PROBE();
+        int err = git_revwalk_hide(walk.get(), &id.oid);
+        check_error(err);
+    }
+
+    void RevWalk::sorting(unsigned int mode) const {
+        GIT_CALL_PROBE();
+        int err = git_revwalk_sorting(walk.get(), mode);
+        check_error(err);
+    }
+
+    void RevWalk::simplify_first_parent() const {
+        GIT_CALL_PROBE();
+        int err = git_revwalk_simplify_first_parent(walk.get());
+        check_error(err);
+    }
+
+    bool RevWalk::next(OID& out) const {
+        GIT_CALL_PROBE();
+        int err = git_revwalk_next(&out.oid, walk.get());
+        if (err == GIT_ITEROVER) {
+            return false;
+        }
+        check_error(err);
+        return true;
+    }
+}
@@ -0,0 +1,13 @@
+namespace git {
+    bool Tree::entry_bypath(const string& path, TreeEntry &out) const {
+        GIT_CALL_PROBE();
+        git_tree_entry *entry;
+        int err = git_tree_entry_bypath(&entry, tree.get(), path.c_str());
+        if (err == GIT_ENOTFOUND) {
+            return false;
+        }
+        check_error(err);
+        out = TreeEntry(entry);
+        return true;
+    }
+}
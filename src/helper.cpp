@@ -1,4 +1,5 @@
 #include "pch.h"
+#include <random>
 
 using namespace std;
 
@@ -45,4 +46,89 @@ void write_all(const string& text, const string& path) {
     ofstream file(path);
     file << text;
     file.close();
-}
\ No newline at end of file
+}
+
+void write_all_atomic(const string& data, const string& path) {
+    // Each write gets its own temporary file, so that processes and threads writing the same file at once
+    // don't write into each other's. Whichever renames its file last wins.
+    static const uint64_t processToken = ((uint64_t) random_device()() << 32) ^ random_device()();
+    static atomic<uint64_t> writeCount(0);
+    stringstream tempName;
+    tempName << path << "." << hex << processToken << "-" << writeCount++ << ".tmp";
+    string tempPath = tempName.str();
+    ofstream file(tempPath, ios::binary | ios::trunc);
+    file.write(data.data(), data.size());
+    file.close();
+    if (file.fail() || rename(tempPath.c_str(), path.c_str()) != 0) {
+        remove(tempPath.c_str());
+        throw MetroException("Failed to write " + path);
+    }
+}
+
+void append_varint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+uint64_t read_varint(const string& data, size_t& pos) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos >= data.size()) {
+            break;
+        }
+        auto byte = static_cast<uint8_t>(data[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return value;
+        }
+    }
+    throw MetroException("Corrupt varint in Metro data file");
+}
+
+bool parse_duration(const string& text, int64_t& seconds) {
+    size_t end = 0;
+    int64_t count;
+    try {
+        count = stoll(text, &end);
+    } catch (logic_error&) {
+        return false;
+    }
+    if (count < 0 || end + 1 != text.size()) {
+        return false;
+    }
+
+    switch (text[end]) {
+        case 's': seconds = count; return true;
+        case 'm': seconds = count * 60; return true;
+        case 'h': seconds = count * 60 * 60; return true;
+        case 'd': seconds = count * 24 * 60 * 60; return true;
+        case 'w': seconds = count * 7 * 24 * 60 * 60; return true;
+        default: return false;
+    }
+}
+
+bool parse_time(const string& text, int64_t& time) {
+    int64_t ago;
+    if (parse_duration(text, ago)) {
+        time = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count() - ago;
+        return true;
+    }
+
+    tm date {};
+    char rest;
+    if (sscanf(text.c_str(), "%d-%d-%d%c", &date.tm_year, &date.tm_mon, &date.tm_mday, &rest) != 3) {
+        return false;
+    }
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    date.tm_isdst = -1;
+    time_t local = mktime(&date);
+    if (local == -1) {
+        return false;
+    }
+    time = local;
+    return true;
+}
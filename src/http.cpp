@@ -0,0 +1,370 @@
+#include "pch.h"
+
+#ifndef _WIN32
+#include <csignal>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#endif
+
+#define HTTP_MAX_REDIRECTS 5
+#define HTTP_TIMEOUT_SECONDS 60
+#define HTTP_BUFFER_SIZE (64 * 1024)
+
+struct ParsedUrl {
+    bool tls;
+    string host;
+    string port;
+    // The path and query, starting with a slash.
+    string target;
+    string userinfo;
+};
+
+ParsedUrl parse_url(const string& url) {
+    ParsedUrl parsed;
+    string rest;
+    if (has_prefix(url, "https://")) {
+        parsed.tls = true;
+        rest = url.substr(8);
+    } else if (has_prefix(url, "http://")) {
+        parsed.tls = false;
+        rest = url.substr(7);
+    } else {
+        throw TransferException("Only http and https URLs are supported: " + url);
+    }
+
+    size_t slash = rest.find('/');
+    string authority = rest.substr(0, slash);
+    parsed.target = slash == string::npos? "/" : rest.substr(slash);
+    size_t at = authority.rfind('@');
+    if (at != string::npos) {
+        parsed.userinfo = authority.substr(0, at);
+        authority = authority.substr(at + 1);
+    }
+    // A colon after any IPv6 brackets separates the port.
+    size_t colon = authority.rfind(':');
+    if (colon != string::npos && authority.find(']', colon) == string::npos) {
+        parsed.host = authority.substr(0, colon);
+        parsed.port = authority.substr(colon + 1);
+    } else {
+        parsed.host = authority;
+        parsed.port = parsed.tls? "443" : "80";
+    }
+    if (parsed.host.size() > 1 && parsed.host.front() == '[' && parsed.host.back() == ']') {
+        parsed.host = parsed.host.substr(1, parsed.host.size() - 2);
+    }
+    return parsed;
+}
+
+string base64_encode(const string& data) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    string out;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t group = (uint8_t) data[i] << 16;
+        if (i + 1 < data.size()) group |= (uint8_t) data[i + 1] << 8;
+        if (i + 2 < data.size()) group |= (uint8_t) data[i + 2];
+        out.push_back(digits[(group >> 18) & 0x3F]);
+        out.push_back(digits[(group >> 12) & 0x3F]);
+        out.push_back(i + 1 < data.size()? digits[(group >> 6) & 0x3F] : '=');
+        out.push_back(i + 2 < data.size()? digits[group & 0x3F] : '=');
+    }
+    return out;
+}
+
+// Decode %XX escapes, as used for credentials in URLs.
+string percent_decode(const string& text) {
+    string out;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == '%' && i + 2 < text.size() && isxdigit((unsigned char) text[i + 1]) && isxdigit((unsigned char) text[i + 2])) {
+            out.push_back((char) stoi(text.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            out.push_back(text[i]);
+        }
+    }
+    return out;
+}
+
+#ifndef _WIN32
+// A connection to a server, over TLS if the URL asked for it, with buffered reads.
+class HttpConnection {
+private:
+    int fd = -1;
+    SSL *ssl = nullptr;
+    char buffer[HTTP_BUFFER_SIZE];
+    size_t bufferStart = 0;
+    size_t bufferEnd = 0;
+
+    static SSL_CTX *tls_context() {
+        static SSL_CTX *context = []() {
+            SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+            if (ctx == nullptr) {
+                throw TransferException("Couldn't set up TLS");
+            }
+            SSL_CTX_set_default_verify_paths(ctx);
+            SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, nullptr);
+            SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+            return ctx;
+        }();
+        return context;
+    }
+
+    // Read more data into the buffer. Returns false at the end of the stream.
+    bool fill() {
+        bufferStart = 0;
+        ssize_t count;
+        if (ssl != nullptr) {
+            count = SSL_read(ssl, buffer, sizeof(buffer));
+            if (count <= 0 && SSL_get_error(ssl, count) == SSL_ERROR_ZERO_RETURN) {
+                count = 0;
+            }
+        } else {
+            count = recv(fd, buffer, sizeof(buffer), 0);
+        }
+        if (count < 0) {
+            throw TransferException("Connection failed while reading the response");
+        }
+        bufferEnd = count;
+        return count > 0;
+    }
+
+public:
+    explicit HttpConnection(const ParsedUrl& url) {
+        // Writing to a connection the server closed must fail rather than kill the process.
+        static bool ignoringSigpipe = (signal(SIGPIPE, SIG_IGN), true);
+        (void) ignoringSigpipe;
+
+        addrinfo hints {};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *addresses;
+        if (getaddrinfo(url.host.c_str(), url.port.c_str(), &hints, &addresses) != 0) {
+            throw TransferException("Couldn't resolve " + url.host);
+        }
+        for (addrinfo *address = addresses; address != nullptr; address = address->ai_next) {
+            fd = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+            if (fd < 0) {
+                continue;
+            }
+            timeval timeout {HTTP_TIMEOUT_SECONDS, 0};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+            if (connect(fd, address->ai_addr, address->ai_addrlen) == 0) {
+                break;
+            }
+            close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addresses);
+        if (fd < 0) {
+            throw TransferException("Couldn't connect to " + url.host + ":" + url.port);
+        }
+
+        if (url.tls) {
+            ssl = SSL_new(tls_context());
+            SSL_set_fd(ssl, fd);
+            SSL_set_tlsext_host_name(ssl, url.host.c_str());
+            SSL_set1_host(ssl, url.host.c_str());
+            if (SSL_connect(ssl) != 1) {
+                throw TransferException("TLS handshake with " + url.host + " failed");
+            }
+        }
+    }
+
+    ~HttpConnection() {
+        if (ssl != nullptr) {
+            SSL_shutdown(ssl);
+            SSL_free(ssl);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    HttpConnection(const HttpConnection&) = delete;
+    HttpConnection& operator=(const HttpConnection&) = delete;
+
+    void write(const char *data, size_t size) {
+        while (size > 0) {
+            ssize_t count = ssl != nullptr? SSL_write(ssl, data, (int) min(size, (size_t) INT32_MAX))
+                                          : send(fd, data, size, 0);
+            if (count <= 0) {
+                throw TransferException("Connection failed while sending the request");
+            }
+            data += count;
+            size -= count;
+        }
+    }
+
+    // Read a line ending in CRLF, without the line ending.
+    string read_line() {
+        string line;
+        while (true) {
+            if (bufferStart == bufferEnd && !fill()) {
+                throw TransferException("Connection closed in the middle of the response");
+            }
+            char c = buffer[bufferStart++];
+            if (c == '\n') {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                return line;
+            }
+            line.push_back(c);
+        }
+    }
+
+    // Pass up to size bytes to sink, or everything until the connection closes if size is SIZE_MAX.
+    void read_body(size_t size, const function<void(const char*, size_t)>& sink) {
+        while (size > 0) {
+            if (bufferStart == bufferEnd && !fill()) {
+                if (size == SIZE_MAX) {
+                    return;
+                }
+                throw TransferException("Connection closed in the middle of the response");
+            }
+            size_t count = min(size, bufferEnd - bufferStart);
+            sink(buffer + bufferStart, count);
+            bufferStart += count;
+            if (size != SIZE_MAX) {
+                size -= count;
+            }
+        }
+    }
+};
+
+// The Host header for a URL: the port is left out only when it is the default for the scheme,
+// and an IPv6 address gets its brackets back.
+string host_header(const ParsedUrl& url) {
+    string host = url.host.find(':') == string::npos? url.host : "[" + url.host + "]";
+    if (url.port != (url.tls? "443" : "80")) {
+        host += ":" + url.port;
+    }
+    return host;
+}
+
+HttpResponse http_request_once(const HttpRequest& request, ostream *out) {
+    ParsedUrl url = parse_url(request.url);
+    // Only the host, since URLs can carry credentials and signed query strings.
+    METRO_PHASE_PROBE(phase, "transfer", url.host.c_str());
+    HttpConnection connection(url);
+
+    ifstream bodyFile;
+    uintmax_t bodySize = request.body.size();
+    if (!request.bodyPath.empty()) {
+        bodyFile.open(request.bodyPath, ios::binary);
+        bodySize = filesystem::file_size(request.bodyPath);
+    }
+
+    string head = request.method + " " + url.target + " HTTP/1.1\r\n";
+    head += "Host: " + host_header(url) + "\r\n";
+    head += "Connection: close\r\n";
+    head += "User-Agent: metro\r\n";
+    if (!url.userinfo.empty() && request.headers.count("Authorization") == 0) {
+        head += "Authorization: Basic " + base64_encode(percent_decode(url.userinfo)) + "\r\n";
+    }
+    if (bodySize > 0 || request.method == "POST" || request.method == "PUT") {
+        head += "Content-Length: " + to_string(bodySize) + "\r\n";
+    }
+    for (const auto& [name, value] : request.headers) {
+        head += name + ": " + value + "\r\n";
+    }
+    head += "\r\n";
+    connection.write(head.data(), head.size());
+
+    if (!request.bodyPath.empty()) {
+        vector<char> chunk(HTTP_BUFFER_SIZE);
+        while (bodyFile.read(chunk.data(), chunk.size()) || bodyFile.gcount() > 0) {
+            connection.write(chunk.data(), bodyFile.gcount());
+        }
+    } else {
+        connection.write(request.body.data(), request.body.size());
+    }
+    METRO_PHASE_ADD(phase, head.size() + bodySize);
+
+    HttpResponse response;
+    string statusLine = connection.read_line();
+    if (!has_prefix(statusLine, "HTTP/1.") || statusLine.size() < 12) {
+        throw TransferException("Malformed response from " + url.host);
+    }
+    response.status = atoi(statusLine.c_str() + 9);
+    for (string line = connection.read_line(); !line.empty(); line = connection.read_line()) {
+        string name, value;
+        split_at_first(line, ':', name, value);
+        for (char& c : name) {
+            c = (char) tolower((unsigned char) c);
+        }
+        value.erase(0, value.find_first_not_of(" \t"));
+        response.headers[name] = value;
+    }
+
+    bool success = response.status >= 200 && response.status < 300;
+    auto sink = [&](const char *data, size_t size) {
+        METRO_PHASE_ADD_ITEMS(phase, 0, size);
+        if (out != nullptr && success) {
+            out->write(data, size);
+        } else {
+            response.body.append(data, size);
+        }
+    };
+    if (request.method == "HEAD" || response.status == 204 || response.status == 304) {
+        return response;
+    }
+    if (response.headers["transfer-encoding"].find("chunked") != string::npos) {
+        while (true) {
+            size_t chunkSize = strtoull(connection.read_line().c_str(), nullptr, 16);
+            if (chunkSize == 0) {
+                break;
+            }
+            connection.read_body(chunkSize, sink);
+            connection.read_line();
+        }
+    } else if (response.headers.count("content-length") > 0) {
+        connection.read_body(strtoull(response.headers["content-length"].c_str(), nullptr, 10), sink);
+    } else {
+        connection.read_body(SIZE_MAX, sink);
+    }
+    return response;
+}
+
+HttpResponse http_request(const HttpRequest& request, ostream *out) {
+    HttpRequest current = request;
+    for (int redirects = 0;; redirects++) {
+        HttpResponse response = http_request_once(current, out);
+        bool redirect = response.status == 301 || response.status == 302 || response.status == 303
+                        || response.status == 307 || response.status == 308;
+        if (!redirect || response.headers.count("location") == 0 || redirects == HTTP_MAX_REDIRECTS) {
+            return response;
+        }
+
+        string location = response.headers["location"];
+        ParsedUrl from = parse_url(current.url);
+        if (has_prefix(location, "/")) {
+            location = (from.tls? "https://" : "http://") + host_header(from) + location;
+        }
+        ParsedUrl to = parse_url(location);
+        // Following a redirect to plain HTTP would send the request, and any credentials, unencrypted.
+        if (from.tls && !to.tls) {
+            throw TransferException("Refusing to follow a redirect from " + from.host + " to unencrypted " + to.host);
+        }
+        // Credentials are only sent to the server they were given for.
+        if (to.host != from.host || to.port != from.port) {
+            current.headers.erase("Authorization");
+        }
+        if (response.status == 303) {
+            current.method = "GET";
+            current.body.clear();
+            current.bodyPath.clear();
+        }
+        current.url = location;
+    }
+}
+#else
+HttpResponse http_request(const HttpRequest& request, ostream *out) {
+    throw UnsupportedOperationException("HTTP transfers aren't supported on Windows yet.");
+}
+#endif
@@ -0,0 +1,228 @@
+#include "pch.h"
+
+const JsonValue& JsonValue::operator[](const string& name) const {
+    static const JsonValue null;
+    auto field = fields.find(name);
+    return field == fields.end()? null : field->second;
+}
+
+// A recursive descent parser over the text of a JSON document.
+class JsonParser {
+private:
+    const string& text;
+    size_t pos = 0;
+
+    [[noreturn]] void fail() const {
+        throw MetroException("Invalid JSON at offset " + to_string(pos));
+    }
+
+    void skip_space() {
+        while (pos < text.size() && isspace((unsigned char) text[pos])) {
+            pos++;
+        }
+    }
+
+    void expect(const char *literal) {
+        size_t size = strlen(literal);
+        if (text.compare(pos, size, literal) != 0) {
+            fail();
+        }
+        pos += size;
+    }
+
+    // Append a code point to out as UTF-8.
+    static void append_utf8(string& out, uint32_t code) {
+        if (code < 0x80) {
+            out.push_back((char) code);
+        } else if (code < 0x800) {
+            out.push_back((char) (0xC0 | (code >> 6)));
+            out.push_back((char) (0x80 | (code & 0x3F)));
+        } else if (code < 0x10000) {
+            out.push_back((char) (0xE0 | (code >> 12)));
+            out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char) (0x80 | (code & 0x3F)));
+        } else {
+            out.push_back((char) (0xF0 | (code >> 18)));
+            out.push_back((char) (0x80 | ((code >> 12) & 0x3F)));
+            out.push_back((char) (0x80 | ((code >> 6) & 0x3F)));
+            out.push_back((char) (0x80 | (code & 0x3F)));
+        }
+    }
+
+    uint32_t parse_hex4() {
+        if (pos + 4 > text.size()) {
+            fail();
+        }
+        uint32_t code = 0;
+        for (int i = 0; i < 4; i++) {
+            char c = text[pos++];
+            code <<= 4;
+            if (c >= '0' && c <= '9') {
+                code |= c - '0';
+            } else if (c >= 'a' && c <= 'f') {
+                code |= c - 'a' + 10;
+            } else if (c >= 'A' && c <= 'F') {
+                code |= c - 'A' + 10;
+            } else {
+                fail();
+            }
+        }
+        return code;
+    }
+
+    string parse_string() {
+        expect("\"");
+        string out;
+        while (true) {
+            if (pos >= text.size()) {
+                fail();
+            }
+            char c = text[pos++];
+            if (c == '"') {
+                return out;
+            }
+            if (c != '\\') {
+                out.push_back(c);
+                continue;
+            }
+            if (pos >= text.size()) {
+                fail();
+            }
+            switch (text[pos++]) {
+                case '"': out.push_back('"'); break;
+                case '\\': out.push_back('\\'); break;
+                case '/': out.push_back('/'); break;
+                case 'b': out.push_back('\b'); break;
+                case 'f': out.push_back('\f'); break;
+                case 'n': out.push_back('\n'); break;
+                case 'r': out.push_back('\r'); break;
+                case 't': out.push_back('\t'); break;
+                case 'u': {
+                    uint32_t code = parse_hex4();
+                    // A surrogate pair encodes a code point outside the basic plane.
+                    if (code >= 0xD800 && code < 0xDC00 && text.compare(pos, 2, "\\u") == 0) {
+                        pos += 2;
+                        uint32_t low = parse_hex4();
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    append_utf8(out, code);
+                    break;
+                }
+                default:
+                    fail();
+            }
+        }
+    }
+
+public:
+    explicit JsonParser(const string& text) : text(text) {}
+
+    JsonValue parse_value() {
+        skip_space();
+        if (pos >= text.size()) {
+            fail();
+        }
+
+        JsonValue value;
+        char c = text[pos];
+        if (c == '{') {
+            value.type = JsonValue::Object;
+            pos++;
+            skip_space();
+            if (pos < text.size() && text[pos] == '}') {
+                pos++;
+                return value;
+            }
+            while (true) {
+                skip_space();
+                string name = parse_string();
+                skip_space();
+                expect(":");
+                value.fields[name] = parse_value();
+                skip_space();
+                if (pos < text.size() && text[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                expect("}");
+                return value;
+            }
+        } else if (c == '[') {
+            value.type = JsonValue::Array;
+            pos++;
+            skip_space();
+            if (pos < text.size() && text[pos] == ']') {
+                pos++;
+                return value;
+            }
+            while (true) {
+                value.items.push_back(parse_value());
+                skip_space();
+                if (pos < text.size() && text[pos] == ',') {
+                    pos++;
+                    continue;
+                }
+                expect("]");
+                return value;
+            }
+        } else if (c == '"') {
+            value.type = JsonValue::String;
+            value.text = parse_string();
+        } else if (c == 't') {
+            expect("true");
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+        } else if (c == 'f') {
+            expect("false");
+            value.type = JsonValue::Bool;
+        } else if (c == 'n') {
+            expect("null");
+        } else {
+            const char *start = text.c_str() + pos;
+            char *end;
+            value.type = JsonValue::Number;
+            value.number = strtod(start, &end);
+            if (end == start) {
+                fail();
+            }
+            pos += end - start;
+        }
+        return value;
+    }
+
+    void expect_end() {
+        skip_space();
+        if (pos != text.size()) {
+            fail();
+        }
+    }
+};
+
+JsonValue parse_json(const string& text) {
+    JsonParser parser(text);
+    JsonValue value = parser.parse_value();
+    parser.expect_end();
+    return value;
+}
+
+string json_quote(const string& text) {
+    string out = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char) c < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    return out + "\"";
+}
@@ -33,6 +33,7 @@ Option lookup_option(string const& flag) {
 // Using the wrong prefix will result in the Option not being recognised.
 // The --help and -h flags are excluded from the options; instead hashHelpFlag is set.
 // The mame of the executable is excluded from the returned arguments.
+// Everything after a "--" argument is put in passthrough as is, without being parsed.
 //
 // The returned option map maps the long name of each option to its value,
 // even if a contraction is used. Prefix -'s are excluded.
@@ -56,7 +57,13 @@ Arguments parse_args(int argc, char *argv[]) {
     for (int i = 1; i < argc; i++) {
         // If this is an option flag... (long or contracted, they both start with -)
         string arg(argv[i]);
-        if (has_prefix(arg, "-")) {
+        if (arg == "--") {
+            if (optionOpen) {
+                throw MissingValueException(string(argv[i - 1]));
+            }
+            args.passthrough.assign(argv + i + 1, argv + argc);
+            return args;
+        } else if (has_prefix(arg, "-")) {
             // Once an option is found, stop allowing positionals.
             acceptingPositionals = false;
             // If the last option still needs a value, the argument directly after it can't also be an option name.
@@ -120,8 +127,45 @@ void printHelp() {
     cout << "Use --help for help.\n";
 }
 
+// Run a command, printing any error it throws followed by its help.
+// Returns the exit code for Metro.
+int run_command(const Command& cmd, const Arguments& args) {
+    try {
+        cmd.execute(args);
+        return 0;
+    } catch (MetroException& e) {
+        cout << e.what() << "\n";
+        cmd.printHelp(args);
+        return -1;
+    } catch (GitException& e) {
+        cout << "Git Error: " << e.what() << "\n";
+        cmd.printHelp(args);
+        return -1;
+    } catch (exception& e) {
+        cout << "Internal Error: " << e.what() << "\n";
+        cmd.printHelp(args);
+        return -1;
+    }
+}
+
+// Print how the task runtime was used to stderr, if the METRO_RUNTIME_STATS environment variable is set.
+void print_runtime_stats() {
+    if (getenv("METRO_RUNTIME_STATS") == nullptr || !metro::TaskRuntime::started()) {
+        return;
+    }
+    metro::TaskRuntimeStats stats = metro::TaskRuntime::instance().stats();
+    cerr << "Task runtime: " << stats.threads << " threads for " << stats.concurrency << " cores, "
+         << stats.executed << " tasks run, " << stats.steals << " stolen, "
+         << stats.compensations << " threads added for blocked tasks, max queue depth " << stats.maxQueueDepth << "\n";
+}
+
 int main(int argc, char *argv[]) {
     git_libgit2_init();
+    metro::register_lfs_filter();
+    // For comparing performance with and without the access pattern hints, as tools/pagecache does.
+    if (getenv("METRO_NO_ACCESS_HINTS") != nullptr) {
+        metro::AccessPatternScope::disable();
+    }
 
     try {
         Arguments args = parse_args(argc, argv);
@@ -140,22 +184,11 @@ int main(int argc, char *argv[]) {
                     cmd->printHelp(args);
                     return 0;
                 } else {
-                    try {
-                        cmd->execute(args);
-                        return 0;
-                    } catch (MetroException& e) {
-                        cout << e.what() << "\n";
-                        cmd->printHelp(args);
-                        return -1;
-                    } catch (GitException& e) {
-                        cout << "Git Error: " << e.what() << "\n";
-                        cmd->printHelp(args);
-                        return -1;
-                    } catch (exception& e) {
-                        cout << "Internal Error: " << e.what() << "\n";
-                        cmd->printHelp(args);
-                        return -1;
-                    }
+                    auto start = chrono::steady_clock::now();
+                    int status = run_command(*cmd, args);
+                    metro::record_command_perf(cmd->name, chrono::steady_clock::now() - start, status);
+                    print_runtime_stats();
+                    return status;
                 }
             }
         }
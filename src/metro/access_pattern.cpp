@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Mapping windows for random access are kept small so that a lookup doesn't map far more of a pack than it reads.
+#define RANDOM_MWINDOW_SIZE (64 * 1024 * 1024)
+#define MINIMAL_MWINDOW_SIZE (8 * 1024 * 1024)
+#define MINIMAL_MWINDOW_MAPPED_LIMIT (256 * 1024 * 1024)
+// Don't ask for more than this much of the packs to be read ahead, so the page cache isn't flushed for nothing.
+// Prewarming is done in the background ahead of need, so it may read ahead more than an operation the user
+// is waiting for, such as the checkout in every switch.
+#define WILLNEED_READAHEAD_SIZE (1024ull * 1024 * 1024)
+#define SEQUENTIAL_READAHEAD_SIZE (128ull * 1024 * 1024)
+
+namespace metro {
+    mutex scopeLock;
+    // The open scopes that count towards the libgit2 settings, and the settings from before the first of them.
+    size_t openScopes = 0;
+    size_t savedWindowSize;
+    size_t savedMappedLimit;
+
+    // Ask the kernel to start reading the files into the page cache in the background, up to budget bytes.
+    // Pack indexes are always read ahead, since every object lookup searches them.
+    void read_ahead_packs(const Repository& repo, bool includePacks, uintmax_t budget) {
+#if defined(__unix__) && defined(POSIX_FADV_WILLNEED)
+        vector<string> packDirs = {repo.path() + "objects/pack"};
+        string pool = shared_store_path(repo);
+        if (!pool.empty()) {
+            packDirs.push_back(pool + "/objects/pack");
+        }
+
+        for (const string& dir : packDirs) {
+            error_code err;
+            for (const filesystem::directory_entry& file : filesystem::directory_iterator(dir, err)) {
+                string path = file.path().string();
+                bool isIndex = has_suffix(path, ".idx");
+                if (!isIndex && !(includePacks && has_suffix(path, ".pack"))) {
+                    continue;
+                }
+                uintmax_t size = file.file_size(err);
+                if (err || size > budget) {
+                    continue;
+                }
+                int fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    continue;
+                }
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                close(fd);
+                budget -= size;
+            }
+        }
+#endif
+    }
+
+    // Set libgit2's mapping windows for the pattern, given the settings from before any scope.
+    void apply_mwindow_settings(AccessPattern pattern) {
+        switch (pattern) {
+            case AccessPattern::Random:
+                git_libgit2_opts(GIT_OPT_SET_MWINDOW_SIZE, min(savedWindowSize, (size_t) RANDOM_MWINDOW_SIZE));
+                break;
+            case AccessPattern::Minimal:
+                git_libgit2_opts(GIT_OPT_SET_MWINDOW_SIZE, min(savedWindowSize, (size_t) MINIMAL_MWINDOW_SIZE));
+                git_libgit2_opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT,
+                                 min(savedMappedLimit, (size_t) MINIMAL_MWINDOW_MAPPED_LIMIT));
+                break;
+            case AccessPattern::Sequential:
+            case AccessPattern::WillNeed:
+                break;
+        }
+    }
+
+    atomic<bool> AccessPatternScope::disabled(false);
+
+    void AccessPatternScope::disable() {
+        disabled = true;
+    }
+
+    AccessPatternScope::AccessPatternScope(const Repository& repo, AccessPattern pattern) {
+        if (disabled || TaskRuntime::in_worker()) {
+            return;
+        }
+
+        {
+            lock_guard<mutex> guard(scopeLock);
+            if (openScopes == 0) {
+                git_libgit2_opts(GIT_OPT_GET_MWINDOW_SIZE, &savedWindowSize);
+                git_libgit2_opts(GIT_OPT_GET_MWINDOW_MAPPED_LIMIT, &savedMappedLimit);
+                apply_mwindow_settings(pattern);
+            }
+            openScopes++;
+            counted = true;
+        }
+
+        switch (pattern) {
+            case AccessPattern::Sequential:
+                read_ahead_packs(repo, true, SEQUENTIAL_READAHEAD_SIZE);
+                break;
+            case AccessPattern::Random:
+                read_ahead_packs(repo, false, SEQUENTIAL_READAHEAD_SIZE);
+                break;
+            case AccessPattern::Minimal:
+                break;
+            case AccessPattern::WillNeed:
+                read_ahead_packs(repo, true, WILLNEED_READAHEAD_SIZE);
+                break;
+        }
+    }
+
+    AccessPatternScope::~AccessPatternScope() {
+        if (!counted) {
+            return;
+        }
+        lock_guard<mutex> guard(scopeLock);
+        if (--openScopes == 0) {
+            git_libgit2_opts(GIT_OPT_SET_MWINDOW_SIZE, savedWindowSize);
+            git_libgit2_opts(GIT_OPT_SET_MWINDOW_MAPPED_LIMIT, savedMappedLimit);
+        }
+    }
+}
@@ -0,0 +1,236 @@
+#include "pch.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#define BISECT_WORKTREE_PREFIX "metro-bisect-"
+#define BISECT_SKIP_CODE 125
+// Exit code of the test process if the test command can't be started.
+#define BISECT_EXEC_FAILED 128
+
+namespace metro {
+    string bisect_dir(const Repository& repo) {
+        string dir = metro_dir(repo) + "/bisect";
+        filesystem::create_directories(dir);
+        return dir;
+    }
+
+    // Open the pooled worktree with the given number, adding it to the pool if it isn't there yet.
+    Repository open_bisect_worktree(const Repository& repo, size_t number) {
+        string name = BISECT_WORKTREE_PREFIX + to_string(number);
+        string path = bisect_dir(repo) + "/" + name;
+        if (Repository::exists(path)) {
+            return Repository::open(path);
+        }
+
+        // Clear out anything left behind by a worktree that was deleted or only partly created. Its branch is only
+        // deleted if the leftover worktree is still on it, so that a user's branch of the same name is never lost.
+        string leftoverHead = repo.path() + "worktrees/" + name + "/HEAD";
+        bool leftoverBranch = filesystem::exists(leftoverHead)
+                              && read_all(leftoverHead) == "ref: refs/heads/" + name + "\n";
+        filesystem::remove_all(path);
+        repo.prune_worktree(name);
+        if (leftoverBranch) {
+            delete_branch(repo, name);
+        }
+        if (branch_exists(repo, name)) {
+            throw MetroException("Branch " + name + " is in the way of the bisect worktrees, please rename it.");
+        }
+
+        // libgit2 always makes a branch for a new worktree. This one was just made, so it is ours to delete.
+        repo.add_worktree(name, path);
+        Repository worktree = Repository::open(path);
+        // The branch made for the worktree is only in the way, but it can't be deleted while checked out.
+        worktree.set_head_detached(get_commit(worktree, "HEAD").id());
+        delete_branch(repo, name);
+        return worktree;
+    }
+
+    // Move the worktree to the commit. Checkout only rewrites the files that differ from the worktree's HEAD,
+    // so moving between nearby candidates is cheap, and untracked build outputs are kept for incremental builds.
+    void checkout_candidate(const Repository& worktree, const OID& commit) {
+        git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
+        checkoutOpts.checkout_strategy = GIT_CHECKOUT_FORCE;
+        string path = worktree.workdir();
+        METRO_PHASE_PROBE(phase, "checkout", path.c_str());
+        worktree.checkout_tree(worktree.lookup_commit(commit).tree(), checkoutOpts);
+        worktree.set_head_detached(commit);
+    }
+
+#ifdef __unix__
+    // Start the test command in the worktree with its output going to the log file.
+    pid_t start_test(const Repository& worktree, const vector<string>& command, const string& logPath) {
+        // Prepare everything before forking, since the child should do no more than set up and exec.
+        string workdir = worktree.workdir();
+        vector<char*> argv;
+        for (const string& arg : command) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        int log = open(logPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (log < 0) {
+            throw MetroException("Couldn't create bisect log " + logPath);
+        }
+        cout.flush();
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(log, STDOUT_FILENO);
+            dup2(log, STDERR_FILENO);
+            if (chdir(workdir.c_str()) == 0) {
+                execvp(argv[0], argv.data());
+            }
+            _exit(BISECT_EXEC_FAILED);
+        }
+        close(log);
+        if (pid < 0) {
+            throw MetroException("Couldn't start the test command.");
+        }
+        return pid;
+    }
+
+    // Wait for the test to finish and get its result, or return false if it couldn't run.
+    bool wait_for_test(pid_t pid, BisectResult& out) {
+        int status;
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        if (!WIFEXITED(status) || WEXITSTATUS(status) >= BISECT_EXEC_FAILED) {
+            return false;
+        }
+
+        int code = WEXITSTATUS(status);
+        out = code == 0? BisectResult::Good : code == BISECT_SKIP_CODE? BisectResult::Skip : BisectResult::Bad;
+        return true;
+    }
+
+    vector<OID> bisect(const Repository& repo, const string& good, const string& bad, const vector<string>& command,
+                       unsigned int jobs, const function<void(const OID&, BisectResult)>& onResult) {
+        METRO_OPERATION_PROBE(bad.c_str());
+        AccessPatternScope pattern(repo, AccessPattern::Sequential);
+        // List the commits after good up to bad, oldest first.
+        RevWalk walk = repo.new_revwalk();
+        walk.simplify_first_parent();
+        walk.sorting(GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+        walk.push(get_commit(repo, bad).id());
+        walk.hide(get_commit(repo, good).id());
+        vector<OID> commits;
+        for (OID id; walk.next(id);) {
+            commits.push_back(id);
+        }
+        if (commits.empty()) {
+            throw MetroException("The bad commit must come after the good commit.");
+        }
+
+        // The first bad commit is somewhere in commits[lo...hi]. commits[hi] is known to be bad.
+        size_t lo = 0;
+        size_t hi = commits.size() - 1;
+        vector<bool> skipped(commits.size(), false);
+        // Which commit each pooled worktree has checked out, so candidates go to the worktree closest to them.
+        vector<Repository> worktrees;
+        vector<size_t> positions;
+        string dir = bisect_dir(repo);
+
+        while (true) {
+            vector<size_t> untested;
+            for (size_t i = lo; i < hi; i++) {
+                if (!skipped[i]) {
+                    untested.push_back(i);
+                }
+            }
+            if (untested.empty()) {
+                break;
+            }
+
+            // Pick candidates evenly spread through the untested commits.
+            size_t count = min((size_t) jobs, untested.size());
+            vector<size_t> candidates;
+            for (size_t i = 1; i <= count; i++) {
+                candidates.push_back(untested[i * untested.size() / (count + 1)]);
+            }
+
+            while (worktrees.size() < count) {
+                worktrees.push_back(open_bisect_worktree(repo, worktrees.size()));
+                positions.push_back(SIZE_MAX);
+            }
+            vector<size_t> assigned;
+            vector<bool> used(worktrees.size(), false);
+            for (size_t candidate : candidates) {
+                size_t best = SIZE_MAX;
+                size_t bestDistance = SIZE_MAX;
+                for (size_t w = 0; w < worktrees.size(); w++) {
+                    size_t distance = positions[w] == SIZE_MAX? SIZE_MAX - 1
+                            : max(positions[w], candidate) - min(positions[w], candidate);
+                    if (!used[w] && distance < bestDistance) {
+                        best = w;
+                        bestDistance = distance;
+                    }
+                }
+                used[best] = true;
+                assigned.push_back(best);
+            }
+
+            vector<size_t> slots;
+            for (size_t i = 0; i < candidates.size(); i++) {
+                slots.push_back(i);
+            }
+            parallel_for_each(slots, [&](size_t slot) {
+                checkout_candidate(worktrees[assigned[slot]], commits[candidates[slot]]);
+            }, jobs);
+
+            vector<pid_t> tests;
+            vector<string> logs;
+            for (size_t slot : slots) {
+                positions[assigned[slot]] = candidates[slot];
+                logs.push_back(dir + "/" + BISECT_WORKTREE_PREFIX + to_string(assigned[slot]) + ".log");
+                tests.push_back(start_test(worktrees[assigned[slot]], command, logs.back()));
+            }
+
+            // Wait for every test before reporting a failure, so none are left running.
+            vector<BisectResult> results(slots.size());
+            size_t failed = SIZE_MAX;
+            for (size_t slot : slots) {
+                if (!wait_for_test(tests[slot], results[slot]) && failed == SIZE_MAX) {
+                    failed = slot;
+                }
+            }
+            if (failed != SIZE_MAX) {
+                throw TestCommandException(commits[candidates[failed]].str(), logs[failed]);
+            }
+
+            for (size_t slot : slots) {
+                onResult(commits[candidates[slot]], results[slot]);
+                if (results[slot] == BisectResult::Bad) {
+                    hi = min(hi, candidates[slot]);
+                } else if (results[slot] == BisectResult::Skip) {
+                    skipped[candidates[slot]] = true;
+                }
+            }
+            for (size_t slot : slots) {
+                if (results[slot] == BisectResult::Good && candidates[slot] < hi) {
+                    lo = max(lo, candidates[slot] + 1);
+                }
+            }
+        }
+
+        // Any skipped commit left in the range could be the first bad one.
+        vector<OID> suspects;
+        for (size_t i = lo; i <= hi; i++) {
+            if (skipped[i] || i == hi) {
+                suspects.push_back(commits[i]);
+            }
+        }
+        return suspects;
+    }
+#else
+    vector<OID> bisect(const Repository& repo, const string& good, const string& bad, const vector<string>& command,
+                       unsigned int jobs, const function<void(const OID&, BisectResult)>& onResult) {
+        throw UnsupportedOperationException("Bisect is only supported on unix.");
+    }
+#endif
+}
@@ -0,0 +1,150 @@
+#include "pch.h"
+
+#define QUERY_CACHE_MAGIC "MQC1"
+
+namespace metro {
+    // Encode the key of a query as its kind, the raw bytes of its input OIDs and its options hash.
+    string query_key(QueryKind kind, const vector<OID>& inputs, uint64_t options) {
+        string key;
+        key.push_back(static_cast<char>(kind));
+        for (const OID& input : inputs) {
+            key.append(reinterpret_cast<const char*>(input.oid.id), GIT_OID_RAWSZ);
+        }
+        append_varint(key, options);
+        return key;
+    }
+
+    QueryCache::QueryCache(const Repository& repo, size_t maxBytes) :
+            path(metro_dir(repo) + "/cache"), maxBytes(maxBytes) {
+        filesystem::create_directories(path);
+        path += "/queries";
+        load();
+    }
+
+    // Read all entries from the cache file. A missing or corrupt file is treated as an empty cache,
+    // since everything in it can be recomputed.
+    void QueryCache::load() {
+        ifstream file(path, ios::binary);
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (!has_prefix(data, QUERY_CACHE_MAGIC)) {
+            return;
+        }
+
+        try {
+            size_t pos = strlen(QUERY_CACHE_MAGIC);
+            clock = read_varint(data, pos);
+            while (pos < data.size()) {
+                size_t keySize = read_varint(data, pos);
+                string key = data.substr(pos, keySize);
+                pos += keySize;
+                uint64_t lastUsed = read_varint(data, pos);
+                size_t valueSize = read_varint(data, pos);
+                if (pos + valueSize > data.size()) {
+                    throw MetroException("Truncated query cache");
+                }
+                entries[key] = {data.substr(pos, valueSize), lastUsed};
+                pos += valueSize;
+            }
+        } catch (MetroException&) {
+            entries.clear();
+            clock = 0;
+        }
+    }
+
+    bool QueryCache::get(QueryKind kind, const vector<OID>& inputs, uint64_t options, string& value) {
+        auto entry = entries.find(query_key(kind, inputs, options));
+        if (entry == entries.end()) {
+            return false;
+        }
+        // A hit alone doesn't make the cache dirty: rewriting the whole file to record recency would cost more than
+        // the query. The new recency is written along with the next change instead.
+        entry->second.lastUsed = ++clock;
+        value = entry->second.value;
+        return true;
+    }
+
+    void QueryCache::put(QueryKind kind, const vector<OID>& inputs, uint64_t options, const string& value) {
+        entries[query_key(kind, inputs, options)] = {value, ++clock};
+        dirty = true;
+    }
+
+    void QueryCache::save() {
+        if (!dirty) {
+            return;
+        }
+
+        // Keep the most recently used entries that fit in the size limit.
+        vector<const pair<const string, Entry>*> byRecency;
+        for (const auto& entry : entries) {
+            byRecency.push_back(&entry);
+        }
+        sort(byRecency.begin(), byRecency.end(), [](auto a, auto b) {
+            return a->second.lastUsed > b->second.lastUsed;
+        });
+
+        string data = QUERY_CACHE_MAGIC;
+        append_varint(data, clock);
+        for (auto entry : byRecency) {
+            string record;
+            append_varint(record, entry->first.size());
+            record += entry->first;
+            append_varint(record, entry->second.lastUsed);
+            append_varint(record, entry->second.value.size());
+            record += entry->second.value;
+            if (data.size() + record.size() > maxBytes) {
+                break;
+            }
+            data += record;
+        }
+
+        write_all_atomic(data, path);
+        dirty = false;
+    }
+
+    void clear_query_cache(const Repository& repo) {
+        filesystem::remove(metro_dir(repo) + "/cache/queries");
+    }
+
+    git_merge_analysis_t cached_merge_analysis(const Repository& repo, const OID& head, const OID& other) {
+        QueryCache cache(repo);
+        string value;
+        if (cache.get(QueryKind::MergeAnalysis, {head, other}, 0, value)) {
+            size_t pos = 0;
+            return static_cast<git_merge_analysis_t>(read_varint(value, pos));
+        }
+
+        vector<AnnotatedCommit> sources = {repo.lookup_annotated_commit(other)};
+        git_merge_analysis_t analysis = repo.merge_analysis(sources);
+
+        append_varint(value, analysis);
+        cache.put(QueryKind::MergeAnalysis, {head, other}, 0, value);
+        cache.save();
+        return analysis;
+    }
+
+    OID cached_merge_base(const Repository& repo, const OID& one, const OID& two) {
+        QueryCache cache(repo);
+        OID base = cached_merge_base(repo, cache, one, two);
+        cache.save();
+        return base;
+    }
+
+    OID cached_merge_base(const Repository& repo, QueryCache& cache, const OID& one, const OID& two) {
+        // The merge base is symmetric, so order the inputs to share one entry between both argument orders.
+        vector<OID> inputs = {one, two};
+        if (two < one) {
+            inputs = {two, one};
+        }
+
+        string value;
+        if (cache.get(QueryKind::MergeBase, inputs, 0, value) && value.size() == GIT_OID_RAWSZ) {
+            git_oid base;
+            git_oid_fromraw(&base, reinterpret_cast<const unsigned char*>(value.data()));
+            return OID(base);
+        }
+
+        OID base = repo.merge_base(one, two);
+        cache.put(QueryKind::MergeBase, inputs, 0, string(reinterpret_cast<const char*>(base.oid.id), GIT_OID_RAWSZ));
+        return base;
+    }
+}
@@ -0,0 +1,282 @@
+#include "pch.h"
+
+#define CHURN_MAGIC "MCH1"
+// Commits that change more files than this, such as reformats or imports, aren't counted in co-change pairs,
+// since they would add a pair for every two files they touch.
+#define CHURN_MAX_PAIR_FILES 32
+
+namespace metro {
+    string churn_path(const Repository& repo) {
+        return metro_dir(repo) + "/churn";
+    }
+
+    string conflict_log_path(const Repository& repo) {
+        return metro_dir(repo) + "/conflict-log";
+    }
+
+    // The directories containing a file, each with a trailing slash.
+    vector<string> parent_dirs(const string& file) {
+        vector<string> dirs;
+        for (size_t slash = file.find('/'); slash != string::npos; slash = file.find('/', slash + 1)) {
+            dirs.push_back(file.substr(0, slash + 1));
+        }
+        return dirs;
+    }
+
+    ChurnStats::ChurnStats(const Repository& repo) : path(churn_path(repo)) {
+        load();
+    }
+
+    // Read the stats file. A missing or corrupt file is treated as empty, so everything is counted again.
+    void ChurnStats::load() {
+        if (!filesystem::exists(path)) {
+            return;
+        }
+        string data = read_all(path);
+        if (!has_prefix(data, CHURN_MAGIC)) {
+            dirty = true;
+            return;
+        }
+
+        try {
+            size_t pos = strlen(CHURN_MAGIC);
+            processed = read_varint(data, pos);
+            if (processed > 0) {
+                lastProcessed = read_oid(data, pos);
+            }
+
+            size_t authorCount = read_varint(data, pos);
+            if (authorCount > data.size()) {
+                throw MetroException("Corrupt churn stats");
+            }
+            vector<string> authors(authorCount);
+            for (string& author : authors) {
+                author = read_string(data, pos);
+            }
+
+            // Paths are stored in order, each as the length it shares with the previous path then the rest of it.
+            size_t pathCount = read_varint(data, pos);
+            vector<const string*> pathsByIndex;
+            string entryPath;
+            for (size_t i = 0; i < pathCount; i++) {
+                size_t shared = read_varint(data, pos);
+                if (shared > entryPath.size()) {
+                    throw MetroException("Corrupt churn stats");
+                }
+                entryPath = entryPath.substr(0, shared) + read_string(data, pos);
+                auto entry = paths.emplace(entryPath, PathChurn {}).first;
+                pathsByIndex.push_back(&entry->first);
+
+                PathChurn& churn = entry->second;
+                churn.changes = read_varint(data, pos);
+                churn.conflicts = read_varint(data, pos);
+                size_t authorCount = read_varint(data, pos);
+                for (size_t j = 0; j < authorCount; j++) {
+                    size_t author = read_varint(data, pos);
+                    if (author >= authors.size()) {
+                        throw MetroException("Corrupt churn stats");
+                    }
+                    churn.authors[authors[author]] = read_varint(data, pos);
+                }
+            }
+
+            size_t pairCount = read_varint(data, pos);
+            for (size_t i = 0; i < pairCount; i++) {
+                size_t first = read_varint(data, pos);
+                size_t second = read_varint(data, pos);
+                if (first >= pathsByIndex.size() || second >= pathsByIndex.size()) {
+                    throw MetroException("Corrupt churn stats");
+                }
+                pairs[{*pathsByIndex[first], *pathsByIndex[second]}] = read_varint(data, pos);
+            }
+        } catch (MetroException&) {
+            paths.clear();
+            pairs.clear();
+            processed = 0;
+            dirty = true;
+        }
+    }
+
+    // Forget all counted commits. Conflict counts are kept, since they can't be recounted from history.
+    void ChurnStats::clear() {
+        for (auto entry = paths.begin(); entry != paths.end();) {
+            if (entry->second.conflicts == 0) {
+                entry = paths.erase(entry);
+            } else {
+                entry->second.changes = 0;
+                entry->second.authors.clear();
+                entry++;
+            }
+        }
+        pairs.clear();
+        processed = 0;
+        dirty = true;
+    }
+
+    void ChurnStats::add_commit(const Repository& repo, const Commit& commit, const Tree& emptyTree) {
+        // The commit index includes the #WIP branches, but WIP snapshots aren't changes anyone made.
+        if (commit.parentcount() > 1 || is_wip_commit(commit)) {
+            return;
+        }
+        unique_ptr<Tree> parentTree;
+        if (commit.parentcount() == 1) {
+            try {
+                parentTree = make_unique<Tree>(commit.parent(0).tree());
+            } catch (GitException&) {
+                // The parent is past the boundary of a shallow history, so count the commit as a root.
+            }
+        }
+
+        git_diff_options diffOpts = GIT_DIFF_OPTIONS_INIT;
+        Diff diff = repo.diff_tree_to_tree(parentTree != nullptr? *parentTree : emptyTree, commit.tree(), diffOpts);
+        vector<string> files;
+        set<string> dirs;
+        for (size_t i = 0; i < diff.num_deltas(); i++) {
+            const git_diff_delta *delta = diff.get_delta(i);
+            files.emplace_back(delta->status == GIT_DELTA_DELETED? delta->old_file.path : delta->new_file.path);
+            for (const string& dir : parent_dirs(files.back())) {
+                dirs.insert(dir);
+            }
+        }
+        if (files.empty()) {
+            return;
+        }
+
+        string author = signature_name(commit.author());
+        for (const string& file : files) {
+            paths[file].changes++;
+            paths[file].authors[author]++;
+        }
+        for (const string& dir : dirs) {
+            paths[dir].changes++;
+            paths[dir].authors[author]++;
+        }
+
+        if (files.size() <= CHURN_MAX_PAIR_FILES) {
+            sort(files.begin(), files.end());
+            for (size_t i = 0; i < files.size(); i++) {
+                for (size_t j = i + 1; j < files.size(); j++) {
+                    pairs[{files[i], files[j]}]++;
+                }
+            }
+        }
+        dirty = true;
+    }
+
+    // Count the conflicts recorded since the last update.
+    void ChurnStats::add_conflicts(const Repository& repo) {
+        string logPath = conflict_log_path(repo);
+        if (!filesystem::exists(logPath)) {
+            return;
+        }
+
+        stringstream log(read_all(logPath));
+        for (string file; getline(log, file);) {
+            if (file.empty()) {
+                continue;
+            }
+            paths[file].conflicts++;
+            for (const string& dir : parent_dirs(file)) {
+                paths[dir].conflicts++;
+            }
+            dirty = true;
+        }
+    }
+
+    void ChurnStats::update(const Repository& repo, const CommitIndex& index) {
+        if (processed > index.size() || (processed > 0 && index.id(processed - 1) != lastProcessed)) {
+            // The commit index was rebuilt, so its positions no longer match.
+            clear();
+        }
+
+        if (processed < index.size()) {
+            AccessPatternScope pattern(repo, AccessPattern::Sequential);
+            Tree emptyTree = repo.lookup_tree(build_tree(repo, {}));
+            for (; processed < index.size(); processed++) {
+                add_commit(repo, repo.lookup_commit(index.id(processed)), emptyTree);
+            }
+            lastProcessed = index.id(processed - 1);
+            dirty = true;
+        }
+        add_conflicts(repo);
+
+        if (!dirty) {
+            filesystem::remove(conflict_log_path(repo));
+            return;
+        }
+
+        string data = CHURN_MAGIC;
+        append_varint(data, processed);
+        if (processed > 0) {
+            data.append(reinterpret_cast<const char*>(lastProcessed.oid.id), GIT_OID_RAWSZ);
+        }
+
+        map<string, size_t> authorIds;
+        for (const auto& [entryPath, churn] : paths) {
+            for (const auto& [author, count] : churn.authors) {
+                authorIds.emplace(author, authorIds.size());
+            }
+        }
+        vector<const string*> authors(authorIds.size());
+        for (const auto& [author, id] : authorIds) {
+            authors[id] = &author;
+        }
+        append_varint(data, authors.size());
+        for (const string *author : authors) {
+            append_string(data, *author);
+        }
+
+        map<string, size_t> pathIds;
+        const string *previous = nullptr;
+        append_varint(data, paths.size());
+        for (const auto& [entryPath, churn] : paths) {
+            pathIds.emplace(entryPath, pathIds.size());
+            size_t shared = 0;
+            if (previous != nullptr) {
+                while (shared < previous->size() && shared < entryPath.size() && (*previous)[shared] == entryPath[shared]) {
+                    shared++;
+                }
+            }
+            append_varint(data, shared);
+            append_string(data, entryPath.substr(shared));
+            previous = &entryPath;
+
+            append_varint(data, churn.changes);
+            append_varint(data, churn.conflicts);
+            append_varint(data, churn.authors.size());
+            for (const auto& [author, count] : churn.authors) {
+                append_varint(data, authorIds[author]);
+                append_varint(data, count);
+            }
+        }
+
+        append_varint(data, pairs.size());
+        for (const auto& [pair, count] : pairs) {
+            append_varint(data, pathIds[pair.first]);
+            append_varint(data, pathIds[pair.second]);
+            append_varint(data, count);
+        }
+
+        write_all_atomic(data, path);
+        // Only now that the conflicts are counted in the saved stats can the log of them go.
+        filesystem::remove(conflict_log_path(repo));
+        dirty = false;
+    }
+
+    const map<string, PathChurn>& ChurnStats::path_stats() const {
+        return paths;
+    }
+
+    const map<pair<string, string>, uint32_t>& ChurnStats::co_changes() const {
+        return pairs;
+    }
+
+    void record_conflicts(const Repository& repo, const vector<string>& paths) {
+        string lines;
+        for (const string& file : paths) {
+            lines += file + "\n";
+        }
+        ofstream log(conflict_log_path(repo), ios::app);
+        log << lines;
+    }
+}
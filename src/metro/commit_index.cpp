@@ -0,0 +1,468 @@
+#include "pch.h"
+
+#define COMMIT_INDEX_MAGIC "MCI1"
+// Message tokens shorter than this aren't indexed.
+#define COMMIT_INDEX_MIN_TOKEN 2
+
+namespace metro {
+    string commit_index_path(const Repository& repo) {
+        return metro_dir(repo) + "/commit-index";
+    }
+
+    string commit_journal_path(const Repository& repo) {
+        return metro_dir(repo) + "/commit-index.journal";
+    }
+
+    string lowercase(const string& text) {
+        string lower = text;
+        for (char& c : lower) {
+            c = (char) tolower((unsigned char) c);
+        }
+        return lower;
+    }
+
+    // Split text into the lowercase runs of letters and digits it contains. Bytes outside ASCII count as
+    // letters, so that words in other scripts are kept whole.
+    vector<string> tokenize(const string& text) {
+        vector<string> tokens;
+        string token;
+        for (size_t i = 0; i <= text.size(); i++) {
+            auto c = i < text.size()? (unsigned char) text[i] : '\0';
+            if (c >= 0x80 || isalnum(c)) {
+                token.push_back((char) tolower(c));
+                continue;
+            }
+            if (token.size() >= COMMIT_INDEX_MIN_TOKEN) {
+                tokens.push_back(token);
+            }
+            token.clear();
+        }
+        return tokens;
+    }
+
+    // Map signed values to unsigned ones so that small negative numbers stay small as varints.
+    uint64_t zigzag(int64_t value) {
+        return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) {
+        return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+    }
+
+    string signature_name(const git_signature *signature) {
+        return string(signature->name) + " <" + signature->email + ">";
+    }
+
+    // Read a varint length followed by that many bytes.
+    string read_string(const string& data, size_t& pos) {
+        size_t size = read_varint(data, pos);
+        if (pos + size > data.size()) {
+            throw MetroException("Corrupt commit index");
+        }
+        string text = data.substr(pos, size);
+        pos += size;
+        return text;
+    }
+
+    OID read_oid(const string& data, size_t& pos) {
+        if (pos + GIT_OID_RAWSZ > data.size()) {
+            throw MetroException("Corrupt commit index");
+        }
+        OID id;
+        git_oid_fromraw(&id.oid, reinterpret_cast<const unsigned char*>(data.data() + pos));
+        pos += GIT_OID_RAWSZ;
+        return id;
+    }
+
+    void append_string(string& out, const string& text) {
+        append_varint(out, text.size());
+        out.append(text);
+    }
+
+    CommitIndex::CommitIndex(const Repository& repo) : path(commit_index_path(repo)) {
+        load();
+    }
+
+    // Read the index file. A missing or corrupt file is treated as an empty index, since it can be rebuilt.
+    void CommitIndex::load() {
+        if (!filesystem::exists(path)) {
+            return;
+        }
+        string data = read_all(path);
+        if (!has_prefix(data, COMMIT_INDEX_MAGIC)) {
+            dirty = true;
+            return;
+        }
+
+        try {
+            size_t pos = strlen(COMMIT_INDEX_MAGIC);
+            size_t count = read_varint(data, pos);
+            if (count > data.size()) {
+                throw MetroException("Corrupt commit index");
+            }
+            ids.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                ids.push_back(read_oid(data, pos));
+                positions[ids.back()] = i;
+            }
+
+            size_t authorCount = read_varint(data, pos);
+            for (size_t i = 0; i < authorCount; i++) {
+                authorNames.push_back(read_string(data, pos));
+                authorIds[authorNames.back()] = i;
+            }
+            authors.reserve(count);
+            for (size_t i = 0; i < count; i++) {
+                authors.push_back(read_varint(data, pos));
+                if (authors.back() >= authorCount) {
+                    throw MetroException("Corrupt commit index");
+                }
+            }
+
+            // Times are stored as the difference from the previous commit's time.
+            times.reserve(count);
+            int64_t time = 0;
+            for (size_t i = 0; i < count; i++) {
+                time += unzigzag(read_varint(data, pos));
+                times.push_back(time);
+            }
+
+            // Parents are stored as the distance back from the child, which is always positive.
+            parentStarts.reserve(count + 1);
+            for (size_t i = 0; i < count; i++) {
+                size_t parentCount = read_varint(data, pos);
+                for (size_t j = 0; j < parentCount; j++) {
+                    uint64_t distance = read_varint(data, pos);
+                    if (distance == 0 || distance > i) {
+                        throw MetroException("Corrupt commit index");
+                    }
+                    parents.push_back(i - distance);
+                }
+                parentStarts.push_back(parents.size());
+            }
+
+            size_t tokenCount = read_varint(data, pos);
+            for (size_t i = 0; i < tokenCount; i++) {
+                vector<uint32_t>& list = postings[read_string(data, pos)];
+                size_t size = read_varint(data, pos);
+                uint64_t position = 0;
+                for (size_t j = 0; j < size; j++) {
+                    position += read_varint(data, pos);
+                    if (position >= count) {
+                        throw MetroException("Corrupt commit index");
+                    }
+                    list.push_back(position);
+                }
+            }
+        } catch (MetroException&) {
+            ids.clear();
+            authors.clear();
+            times.clear();
+            parentStarts = {0};
+            parents.clear();
+            authorNames.clear();
+            authorIds.clear();
+            postings.clear();
+            positions.clear();
+            dirty = true;
+        }
+    }
+
+    // Append the commits recorded in the journal, stopping at the first one whose parents aren't indexed
+    // or that was only partly written. Any commits left out are found by the walk in update.
+    void CommitIndex::load_journal() {
+        if (!filesystem::exists(path + ".journal")) {
+            return;
+        }
+        string data = read_all(path + ".journal");
+
+        try {
+            size_t pos = 0;
+            while (pos < data.size()) {
+                size_t size = read_varint(data, pos);
+                if (pos + size > data.size()) {
+                    return;
+                }
+                string row = data.substr(pos, size);
+                pos += size;
+
+                size_t rowPos = 0;
+                OID id = read_oid(row, rowPos);
+                size_t parentCount = read_varint(row, rowPos);
+                if (parentCount > row.size() / GIT_OID_RAWSZ) {
+                    return;
+                }
+                vector<OID> parentIds(parentCount);
+                for (OID& parent : parentIds) {
+                    parent = read_oid(row, rowPos);
+                }
+                string author = read_string(row, rowPos);
+                int64_t time = unzigzag(read_varint(row, rowPos));
+                string message = read_string(row, rowPos);
+
+                if (positions.count(id) > 0) {
+                    continue;
+                }
+                for (const OID& parent : parentIds) {
+                    if (positions.count(parent) == 0) {
+                        return;
+                    }
+                }
+                append(id, parentIds, author, time, message);
+            }
+        } catch (MetroException&) {
+            // A corrupt row: leave the rest to the walk.
+        }
+    }
+
+    void CommitIndex::append(const OID& id, const vector<OID>& parentIds, const string& author, int64_t time, const string& message) {
+        auto position = (uint32_t) ids.size();
+        ids.push_back(id);
+        positions[id] = position;
+
+        auto authorId = authorIds.find(author);
+        if (authorId == authorIds.end()) {
+            authorId = authorIds.emplace(author, authorNames.size()).first;
+            authorNames.push_back(author);
+        }
+        authors.push_back(authorId->second);
+        times.push_back(time);
+
+        for (const OID& parent : parentIds) {
+            // Parents missing from a shallow clone are left out, making the commit a root.
+            auto parentPosition = positions.find(parent);
+            if (parentPosition != positions.end()) {
+                parents.push_back(parentPosition->second);
+            }
+        }
+        parentStarts.push_back(parents.size());
+
+        for (const string& token : tokenize(message)) {
+            vector<uint32_t>& list = postings[token];
+            if (list.empty() || list.back() != position) {
+                list.push_back(position);
+            }
+        }
+        dirty = true;
+    }
+
+    void CommitIndex::update(const Repository& repo) {
+        load_journal();
+
+        vector<OID> tips;
+        BranchIterator iter = repo.new_branch_iterator(GIT_BRANCH_LOCAL);
+        for (Branch branch; iter.next(&branch);) {
+            tips.push_back(branch.target());
+        }
+        if (commit_exists(repo, "HEAD")) {
+            tips.push_back(get_commit(repo, "HEAD").id());
+        }
+
+        RevWalk walk = repo.new_revwalk();
+        walk.sorting(GIT_SORT_TOPOLOGICAL | GIT_SORT_REVERSE);
+        bool pushed = false;
+        for (const OID& tip : tips) {
+            if (positions.count(tip) == 0) {
+                walk.push(tip);
+                pushed = true;
+            }
+        }
+
+        if (pushed) {
+            // Hiding the indexed commits nothing else indexed descends from hides them all.
+            vector<uint8_t> hasChild(ids.size(), 0);
+            for (uint32_t parent : parents) {
+                hasChild[parent] = 1;
+            }
+            for (size_t i = 0; i < ids.size(); i++) {
+                if (hasChild[i]) {
+                    continue;
+                }
+                try {
+                    walk.hide(ids[i]);
+                } catch (GitException&) {
+                    // The commit was on a branch that has since been deleted and collected.
+                }
+            }
+
+            AccessPatternScope pattern(repo, AccessPattern::Sequential);
+            for (OID id; walk.next(id);) {
+                if (positions.count(id) > 0) {
+                    continue;
+                }
+                Commit commit = repo.lookup_commit(id);
+                vector<OID> parentIds;
+                for (unsigned int i = 0; i < commit.parentcount(); i++) {
+                    parentIds.push_back(commit.parent_id(i));
+                }
+                append(id, parentIds, signature_name(commit.author()), commit.time(), commit.message());
+            }
+        }
+
+        if (dirty) {
+            string data = COMMIT_INDEX_MAGIC;
+            append_varint(data, ids.size());
+            for (const OID& id : ids) {
+                data.append(reinterpret_cast<const char*>(id.oid.id), GIT_OID_RAWSZ);
+            }
+
+            append_varint(data, authorNames.size());
+            for (const string& author : authorNames) {
+                append_string(data, author);
+            }
+            for (uint32_t author : authors) {
+                append_varint(data, author);
+            }
+
+            int64_t previousTime = 0;
+            for (int64_t time : times) {
+                append_varint(data, zigzag(time - previousTime));
+                previousTime = time;
+            }
+
+            for (size_t i = 0; i < ids.size(); i++) {
+                append_varint(data, parentStarts[i + 1] - parentStarts[i]);
+                for (uint32_t j = parentStarts[i]; j < parentStarts[i + 1]; j++) {
+                    append_varint(data, i - parents[j]);
+                }
+            }
+
+            append_varint(data, postings.size());
+            for (const auto& [token, list] : postings) {
+                append_string(data, token);
+                append_varint(data, list.size());
+                uint32_t previous = 0;
+                for (uint32_t position : list) {
+                    append_varint(data, position - previous);
+                    previous = position;
+                }
+            }
+
+            write_all_atomic(data, path);
+            dirty = false;
+        }
+        // Every commit in the journal is either in the index now or no longer reachable.
+        filesystem::remove(path + ".journal");
+    }
+
+    // Mark the commits reachable from the one at position. Parents always come before their children,
+    // so a single pass down from position finds them all.
+    vector<uint8_t> CommitIndex::reachable_from(uint32_t position) const {
+        vector<uint8_t> reachable(ids.size(), 0);
+        reachable[position] = 1;
+        for (size_t i = position + 1; i-- > 0;) {
+            if (!reachable[i]) {
+                continue;
+            }
+            for (uint32_t j = parentStarts[i]; j < parentStarts[i + 1]; j++) {
+                reachable[parents[j]] = 1;
+            }
+        }
+        return reachable;
+    }
+
+    // Mark the commits whose messages might contain text. Every token of text must be part of a token of
+    // the message, so the candidates are those with, for each token of text, some indexed token containing it.
+    vector<uint8_t> CommitIndex::grep_candidates(const string& text) const {
+        vector<uint8_t> candidates(ids.size(), 1);
+        for (const string& token : tokenize(text)) {
+            vector<uint8_t> matches(ids.size(), 0);
+            for (const auto& [indexed, list] : postings) {
+                if (indexed.find(token) == string::npos) {
+                    continue;
+                }
+                for (uint32_t position : list) {
+                    matches[position] = 1;
+                }
+            }
+            for (size_t i = 0; i < candidates.size(); i++) {
+                candidates[i] &= matches[i];
+            }
+        }
+        return candidates;
+    }
+
+    vector<OID> CommitIndex::query(const Repository& repo, const LogQuery& query) const {
+        if (!commit_exists(repo, "HEAD")) {
+            return {};
+        }
+        auto head = positions.find(get_commit(repo, "HEAD").id());
+        if (head == positions.end()) {
+            throw MetroException("The commit index is out of date.");
+        }
+
+        // Each filter is a byte mask over the columns, combined with branch-free loops the compiler can vectorize.
+        vector<uint8_t> matches = reachable_from(head->second);
+        size_t count = head->second + 1;
+
+        if (query.since != INT64_MIN) {
+            const int64_t *columnTimes = times.data();
+            uint8_t *mask = matches.data();
+            for (size_t i = 0; i < count; i++) {
+                mask[i] &= (uint8_t) (columnTimes[i] >= query.since);
+            }
+        }
+
+        if (!query.author.empty()) {
+            string author = lowercase(query.author);
+            vector<uint8_t> authorMatches(authorNames.size(), 0);
+            for (size_t i = 0; i < authorNames.size(); i++) {
+                authorMatches[i] = lowercase(authorNames[i]).find(author) != string::npos;
+            }
+            const uint32_t *columnAuthors = authors.data();
+            uint8_t *mask = matches.data();
+            for (size_t i = 0; i < count; i++) {
+                mask[i] &= authorMatches[columnAuthors[i]];
+            }
+        }
+
+        string grep = lowercase(query.grep);
+        if (!grep.empty()) {
+            vector<uint8_t> candidates = grep_candidates(grep);
+            for (size_t i = 0; i < count; i++) {
+                matches[i] &= candidates[i];
+            }
+        }
+
+        vector<OID> results;
+        for (size_t i = count; i-- > 0;) {
+            if (!matches[i]) {
+                continue;
+            }
+            if (!grep.empty() && lowercase(repo.lookup_commit(ids[i]).message()).find(grep) == string::npos) {
+                continue;
+            }
+            results.push_back(ids[i]);
+        }
+        return results;
+    }
+
+    size_t CommitIndex::size() const {
+        return ids.size();
+    }
+
+    OID CommitIndex::id(size_t position) const {
+        return ids.at(position);
+    }
+
+    void record_commit(const Repository& repo, const Commit& commit) {
+        string row;
+        OID id = commit.id();
+        row.append(reinterpret_cast<const char*>(id.oid.id), GIT_OID_RAWSZ);
+        append_varint(row, commit.parentcount());
+        for (unsigned int i = 0; i < commit.parentcount(); i++) {
+            OID parent = commit.parent_id(i);
+            row.append(reinterpret_cast<const char*>(parent.oid.id), GIT_OID_RAWSZ);
+        }
+        append_string(row, signature_name(commit.author()));
+        append_varint(row, zigzag(commit.time()));
+        append_string(row, commit.message());
+
+        // Each row is prefixed with its size, so a partly written row at the end can be recognised.
+        string data;
+        append_varint(data, row.size());
+        data.append(row);
+        ofstream journal(commit_journal_path(repo), ios::binary | ios::app);
+        journal.write(data.data(), data.size());
+    }
+}
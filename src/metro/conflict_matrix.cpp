@@ -0,0 +1,131 @@
+#include "pch.h"
+
+namespace metro {
+    // The conflicts are stored as their count followed by their paths.
+    string encode_conflicts(const vector<string>& conflicts) {
+        string value;
+        append_varint(value, conflicts.size());
+        for (const string& path : conflicts) {
+            append_string(value, path);
+        }
+        return value;
+    }
+
+    bool decode_conflicts(const string& value, vector<string>& out) {
+        try {
+            size_t pos = 0;
+            size_t count = read_varint(value, pos);
+            if (count > value.size()) {
+                return false;
+            }
+            out.resize(count);
+            for (string& path : out) {
+                path = read_string(value, pos);
+            }
+            return true;
+        } catch (MetroException&) {
+            return false;
+        }
+    }
+
+    ConflictMatrix conflict_matrix(const Repository& repo, const vector<string>& branches) {
+        METRO_OPERATION_PROBE("");
+        AccessPatternScope pattern(repo, AccessPattern::Random);
+        attach_shared_store(repo);
+        ConflictMatrix matrix {branches, {}, 0, 0};
+        vector<OID> tips, trees;
+        for (const string& branch : branches) {
+            Commit commit = get_commit(repo, branch);
+            tips.push_back(commit.id());
+            trees.push_back(commit.tree().id());
+        }
+
+        // Branches without any common history are merged as if from an empty tree.
+        QueryCache cache(repo);
+        OID emptyTree = build_tree(repo, {});
+        // The tree of each pair's merge base.
+        map<pair<size_t, size_t>, OID> bases;
+        // The files changed from each merge base's tree to each branch's, in path order, filled in below.
+        map<pair<OID, OID>, vector<string>> changes;
+        for (size_t i = 0; i < tips.size(); i++) {
+            for (size_t j = i + 1; j < tips.size(); j++) {
+                OID base = emptyTree;
+                try {
+                    base = repo.lookup_commit(cached_merge_base(repo, cache, tips[i], tips[j])).tree().id();
+                } catch (GitException&) {}
+                bases[{i, j}] = base;
+                changes[{base, trees[i]}];
+                changes[{base, trees[j]}];
+            }
+        }
+
+        // The workers share repo and objects, which is safe since they only read from them.
+        ObjectCache objects(repo);
+        {
+            TaskGroup group;
+            for (auto& [key, paths] : changes) {
+                group.run([&repo, &objects, &key = key, &paths = paths]() {
+                    git_diff_options diffOpts = GIT_DIFF_OPTIONS_INIT;
+                    Diff diff = repo.diff_tree_to_tree(objects.tree(key.first), objects.tree(key.second), diffOpts);
+                    for (size_t i = 0; i < diff.num_deltas(); i++) {
+                        const git_diff_delta *delta = diff.get_delta(i);
+                        bool deleted = delta->status == GIT_DELTA_DELETED;
+                        paths.emplace_back(deleted? delta->old_file.path : delta->new_file.path);
+                    }
+                    sort(paths.begin(), paths.end());
+                });
+            }
+            group.wait();
+        }
+
+        for (const auto& [branchPair, base] : bases) {
+            const vector<string>& first = changes[{base, trees[branchPair.first]}];
+            const vector<string>& second = changes[{base, trees[branchPair.second]}];
+            vector<string> shared;
+            set_intersection(first.begin(), first.end(), second.begin(), second.end(), back_inserter(shared));
+            matrix.pairs.push_back({branchPair.first, branchPair.second, shared.size(), !shared.empty(), {}});
+        }
+
+        // The merge result only depends on the two commits, so it is cached under them in either order.
+        auto inputs = [&](const BranchPairConflicts& pair) {
+            const OID& one = tips[pair.first];
+            const OID& two = tips[pair.second];
+            return two < one? vector<OID> {two, one} : vector<OID> {one, two};
+        };
+        {
+            METRO_PHASE_PROBE(phase, "merge", "");
+            TaskGroup group;
+            for (BranchPairConflicts& pair : matrix.pairs) {
+                if (!pair.merged) {
+                    continue;
+                }
+                matrix.merges++;
+                string value;
+                if (cache.get(QueryKind::MergeConflicts, inputs(pair), 0, value)
+                        && decode_conflicts(value, pair.conflicts)) {
+                    matrix.cachedMerges++;
+                    continue;
+                }
+                const OID& base = bases[{pair.first, pair.second}];
+                group.run([&repo, &objects, &trees, &pair, base]() {
+                    git_merge_options mergeOpts = GIT_MERGE_OPTIONS_INIT;
+                    Index index = repo.merge_trees(objects.tree(base), objects.tree(trees[pair.first]),
+                                                   objects.tree(trees[pair.second]), mergeOpts);
+                    index.for_each_conflict([&](const Conflict& conflict) {
+                        pair.conflicts.emplace_back(conflict.path());
+                    });
+                });
+            }
+            group.wait();
+            METRO_PHASE_ADD_ITEMS(phase, matrix.merges - matrix.cachedMerges, 0);
+        }
+
+        for (const BranchPairConflicts& pair : matrix.pairs) {
+            if (pair.merged) {
+                cache.put(QueryKind::MergeConflicts, inputs(pair), 0, encode_conflicts(pair.conflicts));
+            }
+        }
+        cache.save();
+        return matrix;
+    }
+}
@@ -0,0 +1,146 @@
+#include "pch.h"
+
+#define DELTA_HASH_MULTIPLIER 0x01000193u
+// The most bytes a single copy instruction copies.
+#define DELTA_MAX_COPY 0x10000
+// The most bytes a single insert instruction inserts.
+#define DELTA_MAX_INSERT 127
+
+namespace metro {
+    // A polynomial hash of a block that can be rolled along by one byte at a time.
+    uint32_t hash_block(const char *data) {
+        uint32_t hash = 0;
+        for (size_t i = 0; i < DELTA_BLOCK_SIZE; i++) {
+            hash = hash * DELTA_HASH_MULTIPLIER + (uint8_t) data[i];
+        }
+        return hash;
+    }
+
+    // The hash of the block one byte further on, which drops out and adds in.
+    uint32_t roll_hash(uint32_t hash, char out, char in) {
+        static const uint32_t outWeight = []() {
+            uint32_t weight = 1;
+            for (size_t i = 1; i < DELTA_BLOCK_SIZE; i++) {
+                weight *= DELTA_HASH_MULTIPLIER;
+            }
+            return weight;
+        }();
+        return (hash - (uint8_t) out * outWeight) * DELTA_HASH_MULTIPLIER + (uint8_t) in;
+    }
+
+    uint32_t hash_bucket(uint32_t hash, uint32_t mask) {
+        return (hash ^ (hash >> 15)) & mask;
+    }
+
+    DeltaIndex::DeltaIndex(const char *base, size_t size) : base(base), baseSize(size) {
+        size_t blocks = size / DELTA_BLOCK_SIZE;
+        uint32_t buckets = 16;
+        while (buckets < blocks) {
+            buckets *= 2;
+        }
+        mask = buckets - 1;
+        heads.assign(buckets, 0);
+        chains.resize(blocks);
+        for (size_t block = 0; block < blocks; block++) {
+            uint32_t bucket = hash_bucket(hash_block(base + block * DELTA_BLOCK_SIZE), mask);
+            chains[block] = heads[bucket];
+            heads[bucket] = block + 1;
+        }
+    }
+
+    void append_insert(string& out, const char *data, size_t size) {
+        while (size > 0) {
+            size_t count = min(size, (size_t) DELTA_MAX_INSERT);
+            out.push_back((char) count);
+            out.append(data, count);
+            data += count;
+            size -= count;
+        }
+    }
+
+    // A copy instruction has a bit for each byte of the offset and size that isn't 0, followed by those bytes.
+    // A size of 0 means DELTA_MAX_COPY.
+    void append_copy(string& out, size_t offset, size_t size) {
+        while (size > 0) {
+            size_t count = min(size, (size_t) DELTA_MAX_COPY);
+            size_t opcode = out.size();
+            uint8_t command = 0x80;
+            out.push_back(0);
+            for (int i = 0; i < 4; i++) {
+                if (uint8_t byte = (offset >> (8 * i)) & 0xFF) {
+                    command |= 1 << i;
+                    out.push_back((char) byte);
+                }
+            }
+            for (int i = 0; i < 3 && count != DELTA_MAX_COPY; i++) {
+                if (uint8_t byte = (count >> (8 * i)) & 0xFF) {
+                    command |= 0x10 << i;
+                    out.push_back((char) byte);
+                }
+            }
+            out[opcode] = (char) command;
+            offset += count;
+            size -= count;
+        }
+    }
+
+    bool DeltaIndex::create_delta(const char *target, size_t size, size_t maxSize, string& out) const {
+        out.clear();
+        append_varint(out, baseSize);
+        append_varint(out, size);
+
+        // Scan the target for blocks that are also in the base, inserting the bytes in between.
+        size_t insertStart = 0;
+        size_t i = 0;
+        uint32_t hash = size >= DELTA_BLOCK_SIZE? hash_block(target) : 0;
+        while (i + DELTA_BLOCK_SIZE <= size) {
+            size_t bestOffset = 0, bestSize = 0;
+            uint32_t candidate = heads[hash_bucket(hash, mask)];
+            for (int n = 0; candidate != 0 && n < DELTA_MAX_CANDIDATES; n++, candidate = chains[candidate - 1]) {
+                size_t offset = (size_t) (candidate - 1) * DELTA_BLOCK_SIZE;
+                if (memcmp(base + offset, target + i, DELTA_BLOCK_SIZE) != 0) {
+                    continue;
+                }
+                size_t matched = DELTA_BLOCK_SIZE;
+                while (offset + matched < baseSize && i + matched < size && base[offset + matched] == target[i + matched]) {
+                    matched++;
+                }
+                if (matched > bestSize) {
+                    bestOffset = offset;
+                    bestSize = matched;
+                }
+            }
+
+            if (bestSize == 0) {
+                // Each inserted byte costs a byte, so give up as soon as the inserts alone are too big.
+                if (out.size() + (i - insertStart) > maxSize) {
+                    return false;
+                }
+                if (i + DELTA_BLOCK_SIZE < size) {
+                    hash = roll_hash(hash, target[i], target[i + DELTA_BLOCK_SIZE]);
+                }
+                i++;
+                continue;
+            }
+
+            // Blocks in the base are aligned, so the match may also extend back over bytes not yet inserted.
+            while (i > insertStart && bestOffset > 0 && base[bestOffset - 1] == target[i - 1]) {
+                i--;
+                bestOffset--;
+                bestSize++;
+            }
+            append_insert(out, target + insertStart, i - insertStart);
+            append_copy(out, bestOffset, bestSize);
+            if (out.size() > maxSize) {
+                return false;
+            }
+            i += bestSize;
+            insertStart = i;
+            if (i + DELTA_BLOCK_SIZE <= size) {
+                hash = hash_block(target + i);
+            }
+        }
+        append_insert(out, target + insertStart, size - insertStart);
+        return out.size() <= maxSize;
+    }
+}
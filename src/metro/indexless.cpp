@@ -0,0 +1,196 @@
+#include "pch.h"
+
+namespace metro {
+    string index_disabled_path(const Repository& repo) {
+        return metro_dir(repo) + "/index-disabled";
+    }
+
+    string index_stale_path(const Repository& repo) {
+        return metro_dir(repo) + "/index-stale";
+    }
+
+    bool index_disabled(const Repository& repo) {
+        return filesystem::exists(index_disabled_path(repo));
+    }
+
+    void disable_index(const Repository& repo) {
+        write_all("", index_disabled_path(repo));
+    }
+
+    void enable_index(const Repository& repo) {
+        ensure_index(repo);
+        filesystem::remove(index_disabled_path(repo));
+    }
+
+    void mark_index_stale(const Repository& repo) {
+        if (index_disabled(repo)) {
+            write_all("", index_stale_path(repo));
+        }
+    }
+
+    void ensure_index(const Repository& repo) {
+        string stalePath = index_stale_path(repo);
+        if (!filesystem::exists(stalePath)) {
+            return;
+        }
+
+        Index index = repo.index();
+        // Conflicts record an ongoing merge rather than anything in HEAD, so they are kept through the rebuild.
+        vector<StandaloneConflict> conflicts = get_conflicts(index);
+        index.read_tree(get_commit(repo, "HEAD").tree());
+
+        // Give every file whose cached contents match HEAD the stat data it was cached with. Racily clean files
+        // are left without it, so that git hashes them rather than trusting stat data that may be stale.
+        StatCache cache(repo);
+        vector<git_index_entry> entries;
+        vector<string> paths;
+        paths.reserve(index.entrycount());
+        for (size_t i = 0; i < index.entrycount(); i++) {
+            git_index_entry entry = *index.get_byindex(i);
+            FileStat stat {};
+            OID id;
+            if (!cache.lookup(entry.path, stat, id) || id != OID(entry.id) || stat.mode != entry.mode
+                    || cache.racily_clean(stat)) {
+                continue;
+            }
+            paths.emplace_back(entry.path);
+            entry.path = paths.back().c_str();
+            entry.ctime = stat.ctime;
+            entry.mtime = stat.mtime;
+            entry.dev = stat.dev;
+            entry.ino = stat.ino;
+            entry.uid = stat.uid;
+            entry.gid = stat.gid;
+            entry.file_size = stat.size;
+            entries.push_back(entry);
+        }
+        for (const git_index_entry& entry : entries) {
+            index.add(entry);
+        }
+        if (!conflicts.empty()) {
+            index.add_conflicts(conflicts);
+        }
+        index.write();
+        filesystem::remove(stalePath);
+    }
+
+    // Walks the working directory, hashing files that aren't in the stat cache.
+    class WorkdirWalker {
+    private:
+        const Repository& repo;
+        ODB odb;
+        string workdir;
+        OID headTree;
+        TreeCache trees;
+        StatCache cache;
+        set<string> submodules;
+        bool write;
+
+    public:
+        vector<TreeWriterEntry> entries;
+        set<string> paths;
+        // The total size of the files hashed because the stat cache didn't have them.
+        uint64_t hashedBytes = 0;
+
+        WorkdirWalker(const Repository& repo, bool write) :
+                repo(repo), odb(repo.odb()), workdir(repo.workdir()), headTree(get_commit(repo, "HEAD").tree().id()),
+                trees(repo, PERSISTED_TREE_CACHE_SIZE, true), cache(repo),
+                write(write) {
+            for (const string& path : repo.submodule_paths()) {
+                submodules.insert(path);
+            }
+        }
+
+        // Whether the file or directory at path should be left out of the tree.
+        // As in git, files that are already tracked are kept even if they are ignored.
+        bool excluded(const string& path, bool isDir) {
+            FlatTreeEntry tracked;
+            return repo.is_ignored(isDir? path + "/" : path) && !trees.find_path(headTree, path, tracked);
+        }
+
+        // Add the commit a submodule or nested repo has checked out, or the commit HEAD records for it
+        // if it has none, such as when the submodule hasn't been cloned.
+        void add_gitlink(const string& path) {
+            string fullPath = workdir + path;
+            if (Repository::exists(fullPath)) {
+                Repository submodule = Repository::open(fullPath);
+                if (commit_exists(submodule, "HEAD")) {
+                    entries.push_back({path, GIT_FILEMODE_COMMIT, get_commit(submodule, "HEAD").id()});
+                    return;
+                }
+            }
+            FlatTreeEntry recorded;
+            if (trees.find_path(headTree, path, recorded) && recorded.mode == GIT_FILEMODE_COMMIT) {
+                entries.push_back({path, GIT_FILEMODE_COMMIT, recorded.id});
+            }
+        }
+
+        void add_file(const string& path, const FileStat& stat) {
+            OID id;
+            if (!cache.get(path, stat, id)) {
+                METRO_PHASE_PROBE(hashPhase, "hash", path.c_str());
+                METRO_PHASE_ADD(hashPhase, stat.size);
+                hashedBytes += stat.size;
+                if (stat.mode == GIT_FILEMODE_LINK) {
+                    // The blob of a symlink is its target.
+                    string target = filesystem::read_symlink(workdir + path).string();
+                    id = write? repo.create_blob(target.data(), target.size())
+                              : ODB::hash(target.data(), target.size(), GIT_OBJECT_BLOB);
+                } else {
+                    id = write? repo.create_blob_from_workdir(path) : repo.hash_workdir_file(path);
+                }
+            } else if (write && !odb.exists(id)) {
+                // The file was only hashed, by a status check, so its blob still needs writing.
+                id = repo.create_blob_from_workdir(path);
+            }
+            cache.put(path, stat, id);
+            entries.push_back({path, stat.mode, id});
+            paths.insert(path);
+        }
+
+        // Walk the directory at path, relative to the working directory, or the root if path is empty.
+        void walk(const string& dir) {
+            for (const filesystem::directory_entry& child : filesystem::directory_iterator(workdir + dir)) {
+                string name = child.path().filename().string();
+                string path = dir.empty()? name : dir + "/" + name;
+                if (name == ".git" || submodules.count(path) > 0) {
+                    if (name != ".git") {
+                        add_gitlink(path);
+                    }
+                    continue;
+                }
+
+                FileStat stat {};
+                if (!stat_file(workdir + path, stat) || excluded(path, stat.mode == GIT_FILEMODE_TREE)) {
+                    continue;
+                }
+                if (stat.mode != GIT_FILEMODE_TREE) {
+                    add_file(path, stat);
+                } else if (filesystem::exists(workdir + path + "/.git")) {
+                    add_gitlink(path);
+                } else {
+                    walk(path);
+                }
+            }
+        }
+
+        void save() {
+            cache.retain(paths);
+            cache.save();
+            trees.save();
+        }
+    };
+
+    OID workdir_tree(const Repository& repo, bool write) {
+        METRO_OPERATION_PROBE(write? "write" : "hash");
+        WorkdirWalker walker(repo, write);
+        {
+            string workdir = repo.workdir();
+            METRO_PHASE_PROBE(walkPhase, "walk", workdir.c_str());
+            walker.walk("");
+            METRO_PHASE_ADD_ITEMS(walkPhase, walker.paths.size(), walker.hashedBytes);
+        }
+        walker.save();
+        return build_tree(repo, move(walker.entries), write);
+    }
+}
@@ -0,0 +1,590 @@
+#include "pch.h"
+#include "git2/sys/filter.h"
+
+#define LFS_POINTER_VERSION "version https://git-lfs.github.com/spec/v1\n"
+#define LFS_MEDIA_TYPE "application/vnd.git-lfs+json"
+// The most objects the LFS batch API accepts in one request.
+#define LFS_BATCH_SIZE 100
+
+namespace metro {
+    bool parse_lfs_pointer(const char *data, size_t size, LfsPointer& out) {
+        if (size > LFS_MAX_POINTER_SIZE || size < strlen(LFS_POINTER_VERSION)
+                || memcmp(data, LFS_POINTER_VERSION, strlen(LFS_POINTER_VERSION)) != 0) {
+            return false;
+        }
+
+        bool hasOid = false, hasSize = false;
+        stringstream lines(string(data, size));
+        for (string line; getline(lines, line);) {
+            if (has_prefix(line, "oid sha256:")) {
+                out.oid = line.substr(11);
+                hasOid = out.oid.size() == 64 && out.oid.find_first_not_of("0123456789abcdef") == string::npos;
+            } else if (has_prefix(line, "size ")) {
+                char *end;
+                out.size = strtoull(line.c_str() + 5, &end, 10);
+                hasSize = end != line.c_str() + 5 && *end == '\0';
+            }
+        }
+        return hasOid && hasSize;
+    }
+
+    string format_lfs_pointer(const LfsPointer& pointer) {
+        return LFS_POINTER_VERSION "oid sha256:" + pointer.oid + "\nsize " + to_string(pointer.size) + "\n";
+    }
+
+    string lfs_object_path(const string& gitDir, const string& oid) {
+        return gitDir + "lfs/objects/" + oid.substr(0, 2) + "/" + oid.substr(2, 2) + "/" + oid;
+    }
+
+    // The directory the LFS cache is in. Worktrees share the main repo's cache.
+    string lfs_git_dir(const Repository& repo) {
+        return string(git_repository_commondir(repo.ptr().get()));
+    }
+
+    bool lfs_object_cached(const string& path, uint64_t size) {
+        error_code err;
+        return filesystem::file_size(path, err) == size && !err;
+    }
+
+    // A temporary file to write an object to before moving it into the cache,
+    // so that a partly written object is never mistaken for a whole one.
+    string lfs_temp_path(const string& gitDir, const string& oid) {
+        string dir = gitDir + "lfs/tmp";
+        filesystem::create_directories(dir);
+        stringstream path;
+        path << dir << "/" << oid << "-" << this_thread::get_id();
+        return path.str();
+    }
+
+    // Move a verified temporary file into its place in the cache.
+    void lfs_commit_object(const string& gitDir, const string& oid, const string& tempPath) {
+        string path = lfs_object_path(gitDir, oid);
+        filesystem::create_directories(filesystem::path(path).parent_path());
+        filesystem::rename(tempPath, path);
+    }
+
+    // The LFS server to use: lfs.url from the repo's config or .lfsconfig, otherwise derived from origin's URL.
+    string lfs_endpoint(const Repository& repo) {
+        string url;
+        if (repo.config().get_string("lfs.url", url)) {
+            return url;
+        }
+        string lfsConfig = repo.workdir() + ".lfsconfig";
+        if (filesystem::exists(lfsConfig) && Config::open_file(lfsConfig).get_string("lfs.url", url)) {
+            return url;
+        }
+        if (!repo.config().get_string("remote.origin.url", url) || !(has_prefix(url, "http://") || has_prefix(url, "https://"))) {
+            throw UnsupportedOperationException("Set lfs.url to the LFS server's URL, only HTTP remotes can be used to find it.");
+        }
+        while (has_suffix(url, "/")) {
+            url.pop_back();
+        }
+        return (has_suffix(url, ".git")? url : url + ".git") + "/info/lfs";
+    }
+
+    // The message of an LFS error response, or the response itself if it has none.
+    string parse_message(const string& body) {
+        try {
+            string message = parse_json(body)["message"].text;
+            return message.empty()? body : message;
+        } catch (MetroException&) {
+            return body;
+        }
+    }
+
+    // Ask the LFS server what to do with each object for an operation, download or upload.
+    // Returns the server's entry for each object, by object ID.
+    map<string, JsonValue> lfs_batch(const string& endpoint, const string& operation, const vector<LfsPointer>& pointers) {
+        map<string, JsonValue> objects;
+        for (size_t start = 0; start < pointers.size(); start += LFS_BATCH_SIZE) {
+            string body = "{\"operation\":" + json_quote(operation) + ",\"transfers\":[\"basic\"],\"objects\":[";
+            for (size_t i = start; i < pointers.size() && i < start + LFS_BATCH_SIZE; i++) {
+                body += (i == start? "" : ",");
+                body += "{\"oid\":" + json_quote(pointers[i].oid) + ",\"size\":" + to_string(pointers[i].size) + "}";
+            }
+            body += "]}";
+
+            HttpRequest request;
+            request.method = "POST";
+            request.url = endpoint + "/objects/batch";
+            request.headers = {{"Accept", LFS_MEDIA_TYPE}, {"Content-Type", LFS_MEDIA_TYPE}};
+            request.body = body;
+            HttpResponse response = http_request(request);
+            if (response.status != 200) {
+                throw TransferException("The LFS server refused the " + operation + " request with status "
+                                        + to_string(response.status) + ": " + parse_message(response.body));
+            }
+            for (const JsonValue& object : parse_json(response.body)["objects"].items) {
+                objects[object["oid"].text] = object;
+            }
+        }
+        return objects;
+    }
+
+    // The batch API's entry for an object.
+    const JsonValue& lfs_batch_object(const map<string, JsonValue>& objects, const string& oid) {
+        auto object = objects.find(oid);
+        if (object == objects.end()) {
+            throw TransferException("The LFS server left " + oid + " out of its response.");
+        }
+        return object->second;
+    }
+
+    // Throw if the batch API gave an error for the object.
+    void check_lfs_object_error(const JsonValue& object) {
+        if (object["error"].type == JsonValue::Object) {
+            throw TransferException("The LFS server can't transfer " + object["oid"].text + ": " + object["error"]["message"].text);
+        }
+    }
+
+    // Build an HTTP request for one of the actions the batch API returned for an object.
+    HttpRequest lfs_action_request(const JsonValue& object, const string& action, const string& method) {
+        check_lfs_object_error(object);
+        const JsonValue& details = object["actions"][action];
+        HttpRequest request;
+        request.method = method;
+        request.url = details["href"].text;
+        for (const auto& [name, value] : details["header"].fields) {
+            request.headers[name] = value.text;
+        }
+        return request;
+    }
+
+    // Download an object into the cache, checking it against its pointer.
+    void lfs_download(const string& gitDir, const JsonValue& object, const LfsPointer& pointer) {
+#ifndef _WIN32
+        HttpRequest request = lfs_action_request(object, "download", "GET");
+        string tempPath = lfs_temp_path(gitDir, pointer.oid);
+        HttpResponse response;
+        {
+            ofstream file(tempPath, ios::binary | ios::trunc);
+            response = http_request(request, &file);
+        }
+        if (response.status != 200) {
+            filesystem::remove(tempPath);
+            throw TransferException("Downloading " + pointer.oid + " failed with status " + to_string(response.status));
+        }
+
+        Digest hash(DigestType::Sha256);
+        {
+            // Hash the download straight from the page cache, where it has just been written.
+            BlobView contents = BlobView::map_file(tempPath);
+            hash.update(contents.data(), contents.size());
+        }
+        if (hash.hex() != pointer.oid || !lfs_object_cached(tempPath, pointer.size)) {
+            filesystem::remove(tempPath);
+            throw TransferException("The LFS server sent the wrong contents for " + pointer.oid);
+        }
+        lfs_commit_object(gitDir, pointer.oid, tempPath);
+#else
+        throw UnsupportedOperationException("LFS isn't supported on Windows yet.");
+#endif
+    }
+
+    // Upload an object from the cache if the server asked for it, then let the server verify it.
+    // Returns false if the server already had it.
+    bool lfs_upload(const string& gitDir, const JsonValue& object, const LfsPointer& pointer) {
+        check_lfs_object_error(object);
+        if (object["actions"]["upload"].type != JsonValue::Object) {
+            return false;
+        }
+        HttpRequest request = lfs_action_request(object, "upload", "PUT");
+        request.headers["Content-Type"] = "application/octet-stream";
+        request.bodyPath = lfs_object_path(gitDir, pointer.oid);
+        HttpResponse response = http_request(request);
+        if (response.status < 200 || response.status >= 300) {
+            throw TransferException("Uploading " + pointer.oid + " failed with status " + to_string(response.status));
+        }
+
+        if (object["actions"]["verify"].type == JsonValue::Object) {
+            HttpRequest verify = lfs_action_request(object, "verify", "POST");
+            verify.headers["Accept"] = LFS_MEDIA_TYPE;
+            verify.headers["Content-Type"] = LFS_MEDIA_TYPE;
+            verify.body = "{\"oid\":" + json_quote(pointer.oid) + ",\"size\":" + to_string(pointer.size) + "}";
+            response = http_request(verify);
+            if (response.status != 200) {
+                throw TransferException("The LFS server couldn't verify " + pointer.oid + ": " + parse_message(response.body));
+            }
+        }
+        return true;
+    }
+
+    // If the blob is an LFS pointer, parse it into out.
+    bool read_lfs_pointer(const ODB& odb, const OID& id, LfsPointer& out) {
+        if (odb.read_size(id) > LFS_MAX_POINTER_SIZE) {
+            return false;
+        }
+        OdbObject blob = odb.read(id);
+        return parse_lfs_pointer(blob.data(), blob.size(), out);
+    }
+
+    // Collect the LFS pointers in a tree and its subtrees, by path.
+    void find_lfs_pointers(const Repository& repo, const ODB& odb, const Tree& tree, const string& prefix,
+                           map<string, LfsPointer>& out) {
+        for (size_t i = 0; i < tree.entrycount(); i++) {
+            const git_tree_entry *entry = tree.entry_byindex(i);
+            string path = prefix + git_tree_entry_name(entry);
+            OID id(*git_tree_entry_id(entry));
+            LfsPointer pointer;
+            if (git_tree_entry_type(entry) == GIT_OBJECT_TREE) {
+                find_lfs_pointers(repo, odb, repo.lookup_tree(id), path + "/", out);
+            } else if (git_tree_entry_type(entry) == GIT_OBJECT_BLOB && read_lfs_pointer(odb, id, pointer)) {
+                out[path] = pointer;
+            }
+        }
+    }
+
+    // The pointers in the map, with each object once.
+    vector<LfsPointer> unique_pointers(const map<string, LfsPointer>& pointers, const function<bool(const LfsPointer&)>& filter) {
+        set<string> seen;
+        vector<LfsPointer> unique;
+        for (const auto& [path, pointer] : pointers) {
+            if (filter(pointer) && seen.insert(pointer.oid).second) {
+                unique.push_back(pointer);
+            }
+        }
+        return unique;
+    }
+
+    mutex activePrefetchMutex;
+    LfsPrefetch *activePrefetch = nullptr;
+    git_filter lfsFilter;
+    bool lfsFilterRegistered = false;
+
+#ifndef _WIN32
+    // The lfs filter, streamed so that a large file is never held in memory whole. Clean stores the file in the
+    // cache and passes on a pointer to it instead, smudge passes on the cached file in place of a pointer.
+    // Anything else passes through unchanged. Only the first LFS_MAX_POINTER_SIZE bytes are held back,
+    // to see whether they are a pointer.
+    struct LfsFilterStream {
+        // libgit2 calls back with a pointer to this, so it must come first.
+        git_writestream stream;
+        git_writestream *next;
+        bool clean;
+        string gitDir;
+        string buffered;
+        // Smudging: the input is too big to be a pointer, so it is being passed straight on.
+        bool passingThrough = false;
+        // Cleaning: the input is hashed as it arrives, and once it is too big to be a pointer
+        // it is written to a temporary file rather than buffered.
+        Digest hash {DigestType::Sha256};
+        uint64_t size = 0;
+        string tempPath;
+        ofstream temp;
+
+        int write(const char *data, size_t length) {
+            if (!clean) {
+                if (passingThrough) {
+                    return next->write(next, data, length);
+                }
+                buffered.append(data, length);
+                if (buffered.size() <= LFS_MAX_POINTER_SIZE) {
+                    return 0;
+                }
+                passingThrough = true;
+                int err = next->write(next, buffered.data(), buffered.size());
+                string().swap(buffered);
+                return err;
+            }
+
+            hash.update(data, length);
+            size += length;
+            if (!temp.is_open() && buffered.size() + length <= LFS_MAX_POINTER_SIZE) {
+                buffered.append(data, length);
+                return 0;
+            }
+            if (!temp.is_open()) {
+                stringstream name;
+                name << "clean-" << this;
+                tempPath = lfs_temp_path(gitDir, name.str());
+                temp.open(tempPath, ios::binary | ios::trunc);
+                temp.write(buffered.data(), buffered.size());
+                string().swap(buffered);
+            }
+            temp.write(data, length);
+            if (temp.fail()) {
+                throw MetroException("Failed to write " + tempPath);
+            }
+            return 0;
+        }
+
+        // Pass on the cached object if the buffered input is a pointer to one that is cached or being downloaded.
+        // Returns false if it isn't.
+        bool smudge(int& err) {
+            LfsPointer pointer;
+            if (!parse_lfs_pointer(buffered.data(), buffered.size(), pointer)) {
+                return false;
+            }
+            string path = lfs_object_path(gitDir, pointer.oid);
+            if (!lfs_object_cached(path, pointer.size)) {
+                LfsPrefetch *prefetch;
+                {
+                    lock_guard<mutex> lock(activePrefetchMutex);
+                    prefetch = activePrefetch;
+                }
+                // The prefetch outlives the checkout running this filter, so it can be used unlocked.
+                if (prefetch == nullptr || !prefetch->wait_for(pointer.oid)) {
+                    return false;
+                }
+            }
+
+            // Pages of the mapping are read as they are passed on, and can be dropped again once written.
+            BlobView content = BlobView::map_file(path);
+            err = 0;
+            for (size_t offset = 0; offset < content.size() && err >= 0; offset += LFS_STREAM_CHUNK_SIZE) {
+                err = next->write(next, content.data() + offset, min((size_t) LFS_STREAM_CHUNK_SIZE, content.size() - offset));
+            }
+            return true;
+        }
+
+        int close() {
+            int err = 0;
+            if (!clean) {
+                if (!passingThrough && !smudge(err)) {
+                    err = next->write(next, buffered.data(), buffered.size());
+                }
+                return err < 0? err : next->close(next);
+            }
+
+            LfsPointer pointer;
+            if (!temp.is_open() && parse_lfs_pointer(buffered.data(), buffered.size(), pointer)) {
+                err = next->write(next, buffered.data(), buffered.size());
+                return err < 0? err : next->close(next);
+            }
+
+            pointer = {hash.hex(), size};
+            if (temp.is_open()) {
+                temp.close();
+                if (temp.fail()) {
+                    throw MetroException("Failed to write " + tempPath);
+                }
+            }
+            if (!lfs_object_cached(lfs_object_path(gitDir, pointer.oid), pointer.size)) {
+                if (tempPath.empty()) {
+                    tempPath = lfs_temp_path(gitDir, pointer.oid);
+                    write_all_atomic(buffered, tempPath);
+                }
+                lfs_commit_object(gitDir, pointer.oid, tempPath);
+            }
+            string text = format_lfs_pointer(pointer);
+            err = next->write(next, text.data(), text.size());
+            return err < 0? err : next->close(next);
+        }
+
+        ~LfsFilterStream() {
+            // Whatever is left in the temporary file wasn't committed to the cache.
+            if (!tempPath.empty()) {
+                error_code err;
+                filesystem::remove(tempPath, err);
+            }
+        }
+    };
+
+    // Run a stream callback, reporting any exception to libgit2 as an error.
+    int lfs_stream_call(git_writestream *stream, const function<int(LfsFilterStream&)>& fn) {
+        try {
+            return fn(*reinterpret_cast<LfsFilterStream*>(stream));
+        } catch (exception& e) {
+            git_error_set_str(GIT_ERROR_FILTER, e.what());
+            return -1;
+        }
+    }
+
+    int open_lfs_stream(git_writestream **out, git_filter *self, void **payload, const git_filter_source *src,
+                        git_writestream *next) {
+        auto *stream = new LfsFilterStream();
+        stream->stream.write = [](git_writestream *s, const char *data, size_t length) {
+            return lfs_stream_call(s, [&](LfsFilterStream& filter) { return filter.write(data, length); });
+        };
+        stream->stream.close = [](git_writestream *s) {
+            return lfs_stream_call(s, [](LfsFilterStream& filter) { return filter.close(); });
+        };
+        stream->stream.free = [](git_writestream *s) {
+            delete reinterpret_cast<LfsFilterStream*>(s);
+        };
+        stream->next = next;
+        stream->clean = git_filter_source_mode(src) == GIT_FILTER_TO_ODB;
+        stream->gitDir = git_repository_commondir(git_filter_source_repo(src));
+        *out = &stream->stream;
+        return 0;
+    }
+#endif
+
+    void register_lfs_filter() {
+#ifndef _WIN32
+        git_filter_init(&lfsFilter, GIT_FILTER_VERSION);
+        lfsFilter.attributes = "filter=lfs";
+        lfsFilter.stream = open_lfs_stream;
+        check_error(git_filter_register("lfs", &lfsFilter, GIT_FILTER_DRIVER_PRIORITY));
+        lfsFilterRegistered = true;
+#endif
+    }
+
+    LfsPrefetch::LfsPrefetch(const Repository& repo, const Tree& from, const Tree& to) : gitDir(lfs_git_dir(repo)) {
+        if (!lfsFilterRegistered) {
+            return;
+        }
+
+        ODB odb = repo.odb();
+        // A switch diffs the branch's tree against HEAD's and then the WIP commit's against the branch's,
+        // so most of the trees are ones the last switch or commit already parsed.
+        TreeCache trees(repo, PERSISTED_TREE_CACHE_SIZE, true);
+        vector<LfsPointer> missing;
+        trees.changed_files(from.id(), to.id(), [&](const string& path, const FlatTreeEntry& entry) {
+            LfsPointer pointer;
+            if (entry.mode != GIT_FILEMODE_COMMIT && read_lfs_pointer(odb, entry.id, pointer)
+                    && !lfs_object_cached(lfs_object_path(gitDir, pointer.oid), pointer.size)
+                    && downloads.count(pointer.oid) == 0) {
+                missing.push_back(pointer);
+                downloads[pointer.oid] = shared_future<bool>();
+            }
+        });
+        trees.save();
+        if (missing.empty()) {
+            return;
+        }
+
+        string endpoint;
+        try {
+            endpoint = lfs_endpoint(repo);
+        } catch (MetroException&) {
+            failed = missing.size();
+            downloads.clear();
+            return;
+        }
+
+        auto results = make_shared<map<string, promise<bool>>>();
+        for (const LfsPointer& pointer : missing) {
+            downloads[pointer.oid] = (*results)[pointer.oid].get_future().share();
+        }
+        {
+            lock_guard<mutex> activeLock(activePrefetchMutex);
+            activePrefetch = this;
+        }
+
+        group = make_unique<TaskGroup>();
+        group->run([this, endpoint, missing, results]() {
+            auto objects = make_shared<map<string, JsonValue>>();
+            try {
+                TaskRuntime::blocking([&]() {
+                    *objects = lfs_batch(endpoint, "download", missing);
+                });
+            } catch (exception&) {
+                lock_guard<mutex> failedLock(lock);
+                failed += missing.size();
+                for (auto& [oid, result] : *results) {
+                    result.set_value(false);
+                }
+                return;
+            }
+
+            auto next = make_shared<atomic<size_t>>(0);
+            for (size_t job = 0; job < LFS_TRANSFER_JOBS && job < missing.size(); job++) {
+                group->run([this, missing, results, objects, next]() {
+                    for (size_t i = (*next)++; i < missing.size(); i = (*next)++) {
+                        const LfsPointer& pointer = missing[i];
+                        bool downloaded = false;
+                        try {
+                            TaskRuntime::blocking([&]() {
+                                lfs_download(gitDir, lfs_batch_object(*objects, pointer.oid), pointer);
+                            });
+                            downloaded = true;
+                        } catch (exception&) {
+                            lock_guard<mutex> failedLock(lock);
+                            failed++;
+                        }
+                        results->at(pointer.oid).set_value(downloaded);
+                    }
+                });
+            }
+        });
+    }
+
+    LfsPrefetch::~LfsPrefetch() {
+        finish();
+    }
+
+    bool LfsPrefetch::wait_for(const string& oid) {
+        auto download = downloads.find(oid);
+        return download != downloads.end() && download->second.valid() && download->second.get();
+    }
+
+    size_t LfsPrefetch::finish() {
+        if (group != nullptr) {
+            group->wait();
+            group = nullptr;
+        }
+        {
+            lock_guard<mutex> activeLock(activePrefetchMutex);
+            if (activePrefetch == this) {
+                activePrefetch = nullptr;
+            }
+        }
+        lock_guard<mutex> failedLock(lock);
+        return failed;
+    }
+
+    size_t lfs_fetch(const Repository& repo, const Tree& tree) {
+        METRO_OPERATION_PROBE("");
+        string gitDir = lfs_git_dir(repo);
+        map<string, LfsPointer> pointers;
+        find_lfs_pointers(repo, repo.odb(), tree, "", pointers);
+        vector<LfsPointer> missing = unique_pointers(pointers, [&](const LfsPointer& pointer) {
+            return !lfs_object_cached(lfs_object_path(gitDir, pointer.oid), pointer.size);
+        });
+
+        if (!missing.empty()) {
+            map<string, JsonValue> objects = lfs_batch(lfs_endpoint(repo), "download", missing);
+            parallel_for_each(missing, [&](const LfsPointer& pointer) {
+                TaskRuntime::blocking([&]() {
+                    lfs_download(gitDir, lfs_batch_object(objects, pointer.oid), pointer);
+                });
+            }, LFS_TRANSFER_JOBS);
+        }
+
+        // Fill in the files a checkout left as pointers because their objects weren't cached yet.
+        string workdir = repo.workdir();
+        for (const auto& [path, pointer] : pointers) {
+            string filePath = workdir + path;
+            error_code err;
+            if (filesystem::file_size(filePath, err) > LFS_MAX_POINTER_SIZE || err) {
+                continue;
+            }
+            string content = read_all(filePath);
+            LfsPointer current;
+            if (parse_lfs_pointer(content.data(), content.size(), current) && current.oid == pointer.oid) {
+                string tempPath = filePath + ".tmp";
+                filesystem::copy_file(lfs_object_path(gitDir, pointer.oid), tempPath, filesystem::copy_options::overwrite_existing);
+                filesystem::rename(tempPath, filePath);
+            }
+        }
+        return missing.size();
+    }
+
+    size_t lfs_push(const Repository& repo, const Tree& tree) {
+        METRO_OPERATION_PROBE("");
+        string gitDir = lfs_git_dir(repo);
+        map<string, LfsPointer> pointers;
+        find_lfs_pointers(repo, repo.odb(), tree, "", pointers);
+        vector<LfsPointer> unique = unique_pointers(pointers, [](const LfsPointer&) { return true; });
+        for (const LfsPointer& pointer : unique) {
+            if (!lfs_object_cached(lfs_object_path(gitDir, pointer.oid), pointer.size)) {
+                throw TransferException("Can't upload " + pointer.oid + ", it isn't in the LFS cache.");
+            }
+        }
+        if (unique.empty()) {
+            return 0;
+        }
+
+        map<string, JsonValue> objects = lfs_batch(lfs_endpoint(repo), "upload", unique);
+        atomic<size_t> uploaded(0);
+        parallel_for_each(unique, [&](const LfsPointer& pointer) {
+            TaskRuntime::blocking([&]() {
+                if (lfs_upload(gitDir, lfs_batch_object(objects, pointer.oid), pointer)) {
+                    uploaded++;
+                }
+            });
+        }, LFS_TRANSFER_JOBS);
+        return uploaded;
+    }
+}
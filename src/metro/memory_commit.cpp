@@ -0,0 +1,73 @@
+#include "pch.h"
+
+#define STREAM_CHUNK_SIZE (64 * 1024)
+
+namespace metro {
+    void MemoryCommit::write(const string& path, const char *data, size_t size, git_filemode_t mode) {
+        changes[path] = {false, repo.create_blob(data, size).oid, mode};
+    }
+
+    void MemoryCommit::write(const string& path, istream& input, size_t size, git_filemode_t mode) {
+        unique_ptr<BlobWriter> writer = repo.create_blob_writer();
+        vector<char> buffer(min(size, (size_t) STREAM_CHUNK_SIZE));
+        while (size > 0) {
+            size_t chunk = min(size, buffer.size());
+            input.read(buffer.data(), chunk);
+            if (input.gcount() != (streamsize) chunk) {
+                throw MetroException("Unexpected end of input for " + path);
+            }
+            writer->write(buffer.data(), chunk);
+            size -= chunk;
+        }
+        changes[path] = {false, writer->commit().oid, mode};
+    }
+
+    void MemoryCommit::remove(const string& path) {
+        changes[path] = {true, git_oid{}, GIT_FILEMODE_UNREADABLE};
+    }
+
+    OID MemoryCommit::commit(const string& message) {
+        METRO_OPERATION_PROBE("");
+        Commit parent = get_commit(repo, "HEAD");
+        baseTree = make_shared<Tree>(parent.tree());
+
+        vector<git_tree_update> updates;
+        for (const auto& [path, change] : changes) {
+            git_tree_update update{};
+            update.action = change.remove? GIT_TREE_UPDATE_REMOVE : GIT_TREE_UPDATE_UPSERT;
+            update.id = change.id;
+            update.filemode = change.mode;
+            update.path = path.c_str();
+            updates.push_back(update);
+        }
+        newTree = make_shared<Tree>(repo.lookup_tree(repo.create_updated_tree(*baseTree, updates)));
+
+        Signature author = repo.default_signature();
+        OID id = repo.create_commit("HEAD", author, author, "UTF-8", message, *newTree, {parent});
+        record_commit(repo, repo.lookup_commit(id));
+        return id;
+    }
+
+    void MemoryCommit::update_workdir() const {
+        if (newTree == nullptr) {
+            throw UnsupportedOperationException("Can't update the working directory before committing.");
+        }
+        ensure_index(repo);
+
+        vector<char*> paths;
+        for (const auto& change : changes) {
+            paths.push_back(const_cast<char*>(change.first.c_str()));
+        }
+
+        // Compare against the old tree, since HEAD already points at the new commit.
+        // A safe checkout fails entirely if any file was modified unless it is allowed to skip those files.
+        git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
+        checkoutOpts.checkout_strategy = GIT_CHECKOUT_SAFE | GIT_CHECKOUT_ALLOW_CONFLICTS | GIT_CHECKOUT_RECREATE_MISSING
+                                         | GIT_CHECKOUT_DISABLE_PATHSPEC_MATCH;
+        checkoutOpts.baseline = baseTree->ptr().get();
+        checkoutOpts.paths = {paths.data(), paths.size()};
+        METRO_PHASE_PROBE(phase, "checkout", "");
+        METRO_PHASE_ADD_ITEMS(phase, paths.size(), 0);
+        repo.checkout_tree(*newTree, checkoutOpts);
+    }
+}
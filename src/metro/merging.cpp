@@ -7,11 +7,57 @@ namespace metro {
     }
 
     string get_merge_message(const Repository& repo) {
-        return read_all(repo.path() + "/MERGE_MSG");
+        return read_all(repo.path() + "MERGE_MSG");
     }
 
     void set_merge_message(const Repository& repo, const string& message) {
-        write_all(message, repo.path() + "/MERGE_MSG");
+        write_all(message, repo.path() + "MERGE_MSG");
+    }
+
+    // Each line of the file is "<branch> <absorbed branch>", for every branch with an absorb in progress.
+    // It is kept by branch rather than alongside MERGE_HEAD so that it survives switching away and back.
+    string absorbed_branches_path(const Repository& repo) {
+        return metro_dir(repo) + "/absorbing";
+    }
+
+    map<string, string> read_absorbed_branches(const Repository& repo) {
+        map<string, string> branches;
+        ifstream file(absorbed_branches_path(repo));
+        for (string line; getline(file, line);) {
+            string branch, absorbed;
+            split_at_first(line, ' ', branch, absorbed);
+            if (!absorbed.empty()) {
+                branches[branch] = absorbed;
+            }
+        }
+        return branches;
+    }
+
+    // Record the branch being absorbed into branch, or forget it if absorbed is empty.
+    void set_absorbed_branch(const Repository& repo, const string& branch, const string& absorbed) {
+        map<string, string> branches = read_absorbed_branches(repo);
+        if (absorbed.empty()) {
+            if (branches.erase(branch) == 0) {
+                return;
+            }
+        } else {
+            branches[branch] = absorbed;
+        }
+        string text;
+        for (const auto& [name, absorbedName] : branches) {
+            text += name + " " + absorbedName + "\n";
+        }
+        write_all_atomic(text, absorbed_branches_path(repo));
+    }
+
+    bool absorbed_branch(const Repository& repo, const string& branch, string& out) {
+        map<string, string> branches = read_absorbed_branches(repo);
+        auto absorbed = branches.find(branch);
+        if (absorbed == branches.end()) {
+            return false;
+        }
+        out = absorbed->second;
+        return true;
     }
 
     // Get the commit ID of the merge head. Assumes a merge is ongoing.
@@ -22,11 +68,16 @@ namespace metro {
     // Merge the specified commit into the current branch head.
     // The repo will be left in a merging state, possibly with conflicts in the index.
     void start_merge(const Repository& repo, const string& name) {
+        METRO_OPERATION_PROBE(name.c_str());
+        AccessPatternScope pattern(repo, AccessPattern::Random);
+        attach_shared_store(repo);
+        ensure_index(repo);
         Commit otherHead = get_commit(repo, name);
         AnnotatedCommit annotatedOther = repo.lookup_annotated_commit(otherHead.id());
         vector<AnnotatedCommit> sources = {annotatedOther};
 
-        git_merge_analysis_t analysis = repo.merge_analysis(sources);
+        OID head = get_commit(repo, "HEAD").id();
+        git_merge_analysis_t analysis = cached_merge_analysis(repo, head, otherHead.id());
         if ((analysis & (GIT_MERGE_ANALYSIS_NONE | GIT_MERGE_ANALYSIS_UP_TO_DATE)) != 0) {
             throw UnnecessaryMergeException();
         }
@@ -37,13 +88,17 @@ namespace metro {
         git_merge_options mergeOpts = GIT_MERGE_OPTIONS_INIT;
         git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
         checkoutOpts.checkout_strategy = GIT_CHECKOUT_FORCE | GIT_CHECKOUT_ALLOW_CONFLICTS;
-        repo.merge(sources, mergeOpts, checkoutOpts);
+        {
+            METRO_PHASE_PROBE(phase, "merge", name.c_str());
+            repo.merge(sources, mergeOpts, checkoutOpts);
+        }
 
         set_merge_message(repo, default_merge_message(name));
     }
 
     // Create a commit of the ongoing merge and clear the merge state and conflicts from the repo.
     void resolve(const Repository& repo) {
+        METRO_OPERATION_PROBE("");
         if (!merge_ongoing(repo)) {
             throw NotMergingException();
         }
@@ -55,16 +110,25 @@ namespace metro {
         repo.cleanup_state();
         repo.index().cleanup_conflicts();
         commit(repo, message, {"HEAD", mergeHead});
+        set_absorbed_branch(repo, current_branch_name(repo), "");
     }
 
     bool absorb(const Repository& repo, const string& mergeHead) {
+        METRO_OPERATION_PROBE(mergeHead.c_str());
         if (has_suffix(mergeHead, WIPString)) {
             throw UnsupportedOperationException("Can't absorb WIP branch.");
         }
         assert_merging(repo);
 
         start_merge(repo, mergeHead);
-        if (repo.index().has_conflicts()) {
+        set_absorbed_branch(repo, current_branch_name(repo), mergeHead);
+        Index index = repo.index();
+        if (index.has_conflicts()) {
+            vector<string> conflicted;
+            index.for_each_conflict([&](const Conflict& conflict) {
+                conflicted.push_back(conflict.path());
+            });
+            record_conflicts(repo, conflicted);
             return true;
         } else {
             // If no conflicts occurred make the merge commit right away.
@@ -72,4 +136,196 @@ namespace metro {
             return false;
         }
     }
+
+    // Get the entry for a file at the given path in one of the merge input trees.
+    // Returns false if the tree has no file at that path.
+    bool merge_input_entry(TreeCache& trees, const OID& tree, const string& path, git_index_entry& out) {
+        FlatTreeEntry entry;
+        if (!trees.find_path(tree, path, entry) || entry.mode == GIT_FILEMODE_TREE) {
+            return false;
+        }
+        out = git_index_entry{};
+        out.id = entry.id.oid;
+        out.mode = entry.mode;
+        out.path = path.c_str();
+        return true;
+    }
+
+    bool same_entry(const git_index_entry *a, const git_index_entry *b) {
+        if (a == nullptr || b == nullptr) {
+            return a == b;
+        }
+        return a->mode == b->mode && git_oid_equal(&a->id, &b->id);
+    }
+
+    bool is_regular_file(const git_index_entry *entry) {
+        return entry == nullptr || entry->mode == GIT_FILEMODE_BLOB || entry->mode == GIT_FILEMODE_BLOB_EXECUTABLE;
+    }
+
+    // Replace the file at path in the working directory with the given contents.
+    void write_workdir_file(const Repository& repo, const string& path, const char *data, size_t size, unsigned int mode) {
+        filesystem::path fullPath = repo.workdir() + path;
+        filesystem::create_directories(fullPath.parent_path());
+        filesystem::remove(fullPath);
+        if (mode == GIT_FILEMODE_LINK) {
+            filesystem::create_symlink(string(data, size), fullPath);
+            return;
+        }
+
+        ofstream file(fullPath, ios::binary);
+        file.write(data, size);
+        file.close();
+        if (mode == GIT_FILEMODE_BLOB_EXECUTABLE) {
+            filesystem::permissions(fullPath, filesystem::perms::owner_exec | filesystem::perms::group_exec
+                                              | filesystem::perms::others_exec, filesystem::perm_options::add);
+        }
+    }
+
+    // Write the blob of the given entry to the working directory.
+    void checkout_entry(const Repository& repo, const string& path, const git_index_entry *entry) {
+        // Submodule contents belong to the submodule's own repo.
+        if (entry->mode == GIT_FILEMODE_COMMIT) {
+            return;
+        }
+        BlobView contents = repo.lookup_blob(OID(entry->id)).view();
+        write_workdir_file(repo, path, contents.data(), contents.size(), entry->mode);
+    }
+
+    // Three-way merge the contents of a file straight from the decompressed blob buffers, without copying them.
+    MergeFileResult merge_blobs(const Repository& repo, const string& path, const git_index_entry *ancestor,
+                                const git_index_entry *ours, const git_index_entry *theirs,
+                                const git_merge_file_options& options) {
+        const git_index_entry *entries[3] = {ancestor, ours, theirs};
+        BlobView views[3];
+        git_merge_file_input inputs[3];
+        for (int i = 0; i < 3; i++) {
+            git_merge_file_input input = GIT_MERGE_FILE_INPUT_INIT;
+            if (entries[i] != nullptr) {
+                views[i] = repo.lookup_blob(OID(entries[i]->id)).view();
+                input.ptr = views[i].data();
+                input.size = views[i].size();
+                input.path = path.c_str();
+                input.mode = entries[i]->mode;
+            }
+            inputs[i] = input;
+        }
+        return MergeFileResult::merge(ancestor != nullptr? &inputs[0] : nullptr, inputs[1], inputs[2], options);
+    }
+
+    // Resolve the file at path to the given version of it, or delete it if entry is null.
+    // The version's index entry, if any, is added to entries.
+    void take_version(const Repository& repo, vector<git_index_entry>& entries, const string& path,
+                      const git_index_entry *entry) {
+        if (entry == nullptr) {
+            error_code ignored;
+            filesystem::remove(repo.workdir() + path, ignored);
+            return;
+        }
+        checkout_entry(repo, path, entry);
+        entries.push_back(*entry);
+    }
+
+    void add_changed_paths(const Diff& diff, set<string>& paths) {
+        for (size_t i = 0; i < diff.num_deltas(); i++) {
+            const git_diff_delta *delta = diff.get_delta(i);
+            paths.insert(delta->old_file.path);
+            paths.insert(delta->new_file.path);
+        }
+    }
+
+    size_t refresh_absorb(const Repository& repo, const string& mergeHead,
+                          const function<void(const string&)>& onConflict) {
+        METRO_OPERATION_PROBE(mergeHead.c_str());
+        if (!merge_ongoing(repo)) {
+            throw NotMergingException();
+        }
+        // Another branch's changes would be merged against a base that belongs to this absorb.
+        string absorbed;
+        if (absorbed_branch(repo, current_branch_name(repo), absorbed) && absorbed != mergeHead) {
+            throw WrongAbsorbedBranchException(absorbed);
+        }
+
+        AccessPatternScope pattern(repo, AccessPattern::Random);
+        attach_shared_store(repo);
+        ensure_index(repo);
+        Commit head = get_commit(repo, "HEAD");
+        Commit oldTip = get_commit(repo, "MERGE_HEAD");
+        Commit newTip = get_commit(repo, mergeHead);
+        if (oldTip.id() == newTip.id()) {
+            throw UnchangedMergeHeadException();
+        }
+
+        // Our side of the merge is still HEAD, so a file's merge result can only change if its
+        // version on the absorbed branch or in the merge base has changed.
+        OID oldBase = cached_merge_base(repo, head.id(), oldTip.id());
+        OID newBase = cached_merge_base(repo, head.id(), newTip.id());
+        Tree headTree = head.tree();
+        Tree newTipTree = newTip.tree();
+        Tree newBaseTree = get_commit(repo, newBase.str()).tree();
+
+        set<string> changed;
+        git_diff_options diffOpts = GIT_DIFF_OPTIONS_INIT;
+        add_changed_paths(repo.diff_tree_to_tree(oldTip.tree(), newTipTree, diffOpts), changed);
+        if (oldBase != newBase) {
+            Tree oldBaseTree = get_commit(repo, oldBase.str()).tree();
+            add_changed_paths(repo.diff_tree_to_tree(oldBaseTree, newBaseTree, diffOpts), changed);
+        }
+
+        // Collect the new entries for the changed paths and swap them all into the index at the end,
+        // since removing and inserting each path separately is quadratic in huge merges.
+        git_merge_file_options fileOpts = GIT_MERGE_FILE_OPTIONS_INIT;
+        vector<git_index_entry> entries;
+        vector<string> conflicted;
+        // Every changed path is looked up in the same three trees, so parse their subtrees only once.
+        TreeCache trees(repo);
+        METRO_PHASE_PROBE(phase, "merge", mergeHead.c_str());
+        for (const string& path : changed) {
+            git_index_entry ancestorEntry, oursEntry, theirsEntry;
+            const git_index_entry *ancestor = merge_input_entry(trees, newBaseTree.id(), path, ancestorEntry)?
+                                              &ancestorEntry : nullptr;
+            const git_index_entry *ours = merge_input_entry(trees, headTree.id(), path, oursEntry)? &oursEntry : nullptr;
+            const git_index_entry *theirs = merge_input_entry(trees, newTipTree.id(), path, theirsEntry)?
+                                            &theirsEntry : nullptr;
+
+            // If only one side changed the file take that side, otherwise merge the contents.
+            if (same_entry(ancestor, theirs) || same_entry(ours, theirs)) {
+                take_version(repo, entries, path, ours);
+            } else if (same_entry(ancestor, ours)) {
+                take_version(repo, entries, path, theirs);
+            } else if (ours != nullptr && theirs != nullptr && is_regular_file(ancestor)
+                       && is_regular_file(ours) && is_regular_file(theirs)) {
+                MergeFileResult result = merge_blobs(repo, path, ancestor, ours, theirs, fileOpts);
+                METRO_PHASE_ADD(phase, result.size());
+                if (result.automergeable() && result.mode() != 0) {
+                    git_index_entry merged{};
+                    merged.id = repo.create_blob(result.content(), result.size()).oid;
+                    merged.mode = result.mode();
+                    merged.path = path.c_str();
+                    write_workdir_file(repo, path, result.content(), result.size(), merged.mode);
+                    entries.push_back(merged);
+                } else {
+                    // Leave the conflict markers in the working directory for the user to resolve.
+                    write_workdir_file(repo, path, result.content(), result.size(), ours->mode);
+                    Conflict(ancestor, ours, theirs).append_entries(entries);
+                    conflicted.push_back(path);
+                    onConflict(path);
+                }
+            } else {
+                // Conflicts that can't be merged by content, such as modify/delete,
+                // leave whichever version exists in the working directory, preferring ours.
+                checkout_entry(repo, path, ours != nullptr? ours : theirs);
+                Conflict(ancestor, ours, theirs).append_entries(entries);
+                conflicted.push_back(path);
+                onConflict(path);
+            }
+        }
+
+        // Whatever state the previous merge left for the changed paths is replaced.
+        Index index = repo.index();
+        index.replace_entries(changed, entries);
+        write_all(newTip.id().str() + "\n", repo.path() + "MERGE_HEAD");
+        index.write();
+        record_conflicts(repo, conflicted);
+        return conflicted.size();
+    }
 }
\ No newline at end of file
@@ -19,24 +19,122 @@ namespace metro {
         }
     }
 
+    string metro_dir(const Repository& repo) {
+        string path = repo.path() + "metro";
+        filesystem::create_directories(path);
+        return path;
+    }
+
     // Commit all files in the repo directory (excluding those in .gitignore) to the head of the current branch.
     // repo: The repo
     // message: The commit message
     // parentCommits: The commit's parents
     void commit(const Repository& repo, const string& message, const vector<Commit>& parentCommits) {
-        Signature author = repo.default_signature();
+        commit_to_ref(repo, "HEAD", message, parentCommits);
+    }
+
+    // Commit all files in the repo directory (excluding those in .gitignore) to the given reference,
+    // creating it if it doesn't exist.
+    // Returns the new commit ID.
+    OID commit_to_ref(const Repository& repo, const string& updateRef, const string& message, const vector<Commit>& parentCommits) {
+        return commit_to_ref(repo, updateRef, message, parentCommits, repo.default_signature());
+    }
+
+    OID commit_to_ref(const Repository& repo, const string& updateRef, const string& message,
+                      const vector<Commit>& parentCommits, const Signature& author) {
+        METRO_OPERATION_PROBE(updateRef.c_str());
+        AccessPatternScope pattern(repo, AccessPattern::Minimal);
+        attach_shared_store(repo);
+
+        if (index_disabled(repo)) {
+            Tree tree = repo.lookup_tree(workdir_tree(repo, true));
+            mark_index_stale(repo);
+            OID id = repo.create_commit(updateRef, author, author, "UTF-8", message, tree, parentCommits);
+            record_commit(repo, repo.lookup_commit(id));
+            return id;
+        }
 
         Index index = repo.index();
         index.add_all({}, GIT_INDEX_ADD_DISABLE_PATHSPEC_MATCH, nullptr);
         // Write the files in the index into a tree that can be attached to the commit.
-        OID oid = index.write_tree();
+        OID oid = write_index_tree(repo, index);
         Tree tree = repo.lookup_tree(oid);
         // Save the index to disk so that it stays in sync with the contents of the working directory.
         // If we don't do this removals of every file are left staged.
         index.write();
 
-        // Commit the files to the head of the current branch.
-        repo.create_commit("HEAD", author, author, "UTF-8", message, tree, parentCommits);
+        OID id = repo.create_commit(updateRef, author, author, "UTF-8", message, tree, parentCommits);
+        record_commit(repo, repo.lookup_commit(id));
+        return id;
+    }
+
+    string wip_times_path(const Repository& repo) {
+        return metro_dir(repo) + "/wip-times";
+    }
+
+    // The saved time of each WIP commit, from lines of its ID and the time.
+    map<OID, int64_t> read_wip_times(const Repository& repo) {
+        map<OID, int64_t> times;
+        string path = wip_times_path(repo);
+        if (!filesystem::exists(path)) {
+            return times;
+        }
+        stringstream lines(read_all(path));
+        for (string line; getline(lines, line);) {
+            string id, time;
+            split_at_first(line, ' ', id, time);
+            OID wip;
+            if (git_oid_fromstr(&wip.oid, id.c_str()) == 0 && !time.empty()) {
+                times[wip] = strtoll(time.c_str(), nullptr, 10);
+            }
+        }
+        return times;
+    }
+
+    OID commit_wip(const Repository& repo, const string& updateRef, const string& message, const vector<Commit>& parentCommits) {
+        int64_t time = 0;
+        for (const Commit& parent : parentCommits) {
+            time = max(time, parent.time());
+        }
+        Signature signature {};
+        signature.name = const_cast<char*>(WIP_AUTHOR_NAME);
+        signature.email = const_cast<char*>(WIP_AUTHOR_EMAIL);
+        signature.when.time = time;
+        OID id = commit_to_ref(repo, updateRef, message, parentCommits, signature);
+
+        // Only the times of WIP commits that branches still point to are kept.
+        map<OID, int64_t> times = read_wip_times(repo);
+        times[id] = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+        set<OID> current = {id};
+        BranchIterator iter = repo.new_branch_iterator(GIT_BRANCH_LOCAL);
+        for (Branch branch; iter.next(&branch);) {
+            if (has_suffix(branch.name(), WIPString)) {
+                current.insert(branch.target());
+            }
+        }
+        string text;
+        for (const auto& [wip, savedTime] : times) {
+            if (current.count(wip) > 0) {
+                text += wip.str() + " " + to_string(savedTime) + "\n";
+            }
+        }
+        write_all_atomic(text, wip_times_path(repo));
+        return id;
+    }
+
+    bool wip_saved_time(const Repository& repo, const OID& wip, int64_t& out) {
+        map<OID, int64_t> times = read_wip_times(repo);
+        auto time = times.find(wip);
+        if (time == times.end()) {
+            return false;
+        }
+        out = time->second;
+        return true;
+    }
+
+    bool is_wip_commit(const Commit& commit) {
+        const git_signature *author = commit.author();
+        return strcmp(author->name, WIP_AUTHOR_NAME) == 0 && strcmp(author->email, WIP_AUTHOR_EMAIL) == 0;
     }
 
     // Commit all files in the repo directory (excluding those in .gitignore) to the head of the current branch.
@@ -56,6 +154,7 @@ namespace metro {
     // Initialize an empty git repository in the specified directory,
     // with an initial commit.
     Repository create(const string& path) {
+        METRO_OPERATION_PROBE(path.c_str());
         if (Repository::exists(path+"/.git")) {
             throw RepositoryExistsException();
         }
@@ -66,6 +165,7 @@ namespace metro {
     }
 
     void delete_last_commit(const Repository& repo, bool reset) {
+        METRO_OPERATION_PROBE("");
         Commit lastCommit = get_commit(repo, "HEAD");
         if (lastCommit.parentcount() == 0) {
             throw UnsupportedOperationException("Can't delete initial commit.");
@@ -75,11 +175,16 @@ namespace metro {
         git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
         checkoutOpts.checkout_strategy = GIT_CHECKOUT_FORCE;
         git_reset_t resetType = reset? GIT_RESET_HARD : GIT_RESET_SOFT;
+        // A hard reset rewrites the index, a soft one doesn't touch it.
+        if (reset) {
+            ensure_index(repo);
+        }
 
         repo.reset_to_commit(parent, resetType, checkoutOpts);
     }
 
     void patch(const Repository& repo, const string& message) {
+        METRO_OPERATION_PROBE("");
         assert_merging(repo);
         vector<Commit> parents = get_commit(repo, "HEAD").parents();
         delete_last_commit(repo, false);
@@ -140,40 +245,65 @@ namespace metro {
     // Checks out the given commit without moving head,
     // such that the working directory will match the commit contents.
     // Doesn't change current branch ref.
-    void checkout(const Repository& repo, const string& name) {
+    CheckoutReport checkout(const Repository& repo, const string& name) {
+        METRO_OPERATION_PROBE(name.c_str());
+        AccessPatternScope pattern(repo, AccessPattern::Sequential);
         Tree tree = get_commit(repo, name).tree();
+        // Start downloading the large files the checkout will need so it doesn't wait on each in turn.
+        LfsPrefetch lfs(repo, get_commit(repo, "HEAD").tree(), tree);
         git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
         checkoutOpts.checkout_strategy = GIT_CHECKOUT_FORCE;
-        repo.checkout_tree(tree, checkoutOpts);
+        // A forced checkout writes every file that differs between HEAD and the target whatever the index says,
+        // so with the index disabled it can be left out of date.
+        if (index_disabled(repo)) {
+            checkoutOpts.checkout_strategy |= GIT_CHECKOUT_DONT_UPDATE_INDEX;
+            mark_index_stale(repo);
+        }
+        {
+            METRO_PHASE_PROBE(phase, "checkout", name.c_str());
+            repo.checkout_tree(tree, checkoutOpts);
+        }
+        CheckoutReport report;
+        report.missingLfsFiles = lfs.finish();
+        report.skippedSubmodules = checkout_submodules(repo, tree);
+        return report;
     }
 
     bool has_uncommitted_changes(const Repository& repo) {
+        AccessPatternScope pattern(repo, AccessPattern::Minimal);
+        if (index_disabled(repo)) {
+            return workdir_tree(repo, false) != get_commit(repo, "HEAD").tree().id() || submodules_changed(repo);
+        }
+
         git_status_options opts = GIT_STATUS_OPTIONS_INIT;
         opts.show = GIT_STATUS_SHOW_INDEX_AND_WORKDIR;
-        opts.flags = GIT_STATUS_OPT_INCLUDE_UNTRACKED;
+        // Submodules are checked separately, in parallel rather than one by one.
+        opts.flags = GIT_STATUS_OPT_INCLUDE_UNTRACKED | GIT_STATUS_OPT_EXCLUDE_SUBMODULES;
 
         StatusList status = repo.new_status_list(opts);
-        return status.entrycount() > 0;
+        return status.entrycount() > 0 || submodules_changed(repo);
     }
 
     vector<StandaloneConflict> get_conflicts(const Index& index) {
         vector<StandaloneConflict> conflicts;
-        ConflictIterator iter = index.conflict_iterator();
-        for (Conflict conflict{}; iter.next(conflict);) {
-            conflicts.emplace_back(StandaloneConflict(conflict));
-        }
+        index.for_each_conflict([&](const Conflict& conflict) {
+            conflicts.emplace_back(conflict);
+        });
         return conflicts;
     }
 
     // If the working directory has changes since the last commit, or a merge has been started,
     // Save these changes in a WIP commit in a new #wip branch.
     void save_wip(const Repository& repo) {
+        METRO_OPERATION_PROBE("");
+        string name = current_branch_name(repo);
+        save_submodule_wips(repo, name);
+
         // If there are no changes since the last commit, don't bother with a WIP commit.
         if (!(has_uncommitted_changes(repo) || merge_ongoing(repo))) {
             return;
         }
 
-        string name = current_branch_name(repo);
         try {
             delete_branch(repo, name+WIPString);
         } catch (GitException&) {
@@ -186,21 +316,18 @@ namespace metro {
         if (merge_ongoing(repo)) {
             // Store the merge message in the second line (and beyond) of the WIP commit message.
             string message = get_merge_message(repo);
-            commit(repo, "WIP\n"+message, {"HEAD", "MERGE_HEAD"});
+            commit_wip(repo, "HEAD", "WIP\n"+message, {get_commit(repo, "HEAD"), get_commit(repo, "MERGE_HEAD")});
             repo.cleanup_state();
         } else {
-            commit(repo, "WIP", {"HEAD"});
+            commit_wip(repo, "HEAD", "WIP", {get_commit(repo, "HEAD")});
         }
     }
 
-    // Deletes the WIP commit at head if any, restoring the contents to the working directory
+    // Deletes the WIP commit of the named branch, restoring the contents to the working directory
     // and resuming a merge if one was ongoing.
-    void restore_wip(const Repository& repo) {
-        string name = current_branch_name(repo);
-        if (!branch_exists(repo, name+WIPString)) {
-            return;
-        }
+    CheckoutReport restore_branch_wip(const Repository& repo, const string& name) {
         Commit wipCommit = get_commit(repo, name+WIPString);
+        ensure_index(repo);
         Index index = repo.index();
 
         vector<StandaloneConflict> conflicts;
@@ -229,17 +356,35 @@ namespace metro {
         }
 
         // Restore the contents of the WIP commit to the working directory.
-        checkout(repo, name+WIPString);
+        CheckoutReport report = checkout(repo, name+WIPString);
         delete_branch(repo, name+WIPString);
 
         // If we are mid-merge, restore the conflicts from the merge.
-        for (const Conflict& conflict : conflicts) {
-            index.add_conflict(conflict);
+        // The checkout may have left a disabled index out of date; bring it up to date first,
+        // so that the conflicts aren't discarded by a later rebuild.
+        ensure_index(repo);
+        if (!conflicts.empty()) {
+            index.add_conflicts(conflicts);
         }
         index.write();
+        return report;
+    }
+
+    // Deletes the WIP commit at head if any, restoring the contents to the working directory
+    // and resuming a merge if one was ongoing. Submodule WIP commits are restored too.
+    CheckoutReport restore_wip(const Repository& repo) {
+        METRO_OPERATION_PROBE("");
+        string name = current_branch_name(repo);
+        CheckoutReport report;
+        if (branch_exists(repo, name+WIPString)) {
+            report = restore_branch_wip(repo, name);
+        }
+        restore_submodule_wips(repo, name);
+        return report;
     }
 
-    void switch_branch(const Repository& repo, const string& name) {
+    CheckoutReport switch_branch(const Repository& repo, const string& name) {
+        METRO_OPERATION_PROBE(name.c_str());
         if (has_suffix(name, WIPString)) {
             throw UnsupportedOperationException("Can't switch to WIP branch.");
         }
@@ -247,10 +392,13 @@ namespace metro {
             throw BranchNotFoundException();
         }
 
+        string previous = current_branch_name(repo);
         save_wip(repo);
-        checkout(repo, name);
+        CheckoutReport report = checkout(repo, name);
         move_head(repo, name);
-        restore_wip(repo);
+        report.add(restore_wip(repo));
+        record_switch(repo, previous, name);
+        return report;
     }
 
     void move_head(const Repository& repo, const string& name) {
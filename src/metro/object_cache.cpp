@@ -0,0 +1,112 @@
+#include "pch.h"
+
+// Rough memory used by a cached object besides its contents.
+#define OBJECT_CACHE_ENTRY_OVERHEAD 128
+#define OBJECT_CACHE_TREE_ENTRY_SIZE 64
+
+namespace metro {
+    ObjectCache::ObjectCache(const Repository& repo, size_t maxBytes) :
+            repo(repo), shardBudget(maxBytes / OBJECT_CACHE_SHARDS), shards(new Shard[OBJECT_CACHE_SHARDS]) {}
+
+    ObjectCache::Shard& ObjectCache::shard_for(const OID& id) const {
+        // The first bytes of the ID decide the hash table bucket, so shard by a later one.
+        return shards[id.oid.id[GIT_OID_RAWSZ - 1] % OBJECT_CACHE_SHARDS];
+    }
+
+    shared_ptr<void> ObjectCache::get(const OID& id) const {
+        Shard& shard = shard_for(id);
+        shared_lock<shared_mutex> lock(shard.mutex);
+        auto entry = shard.entries.find(id);
+        if (entry == shard.entries.end()) {
+            shard.misses.fetch_add(1, memory_order_relaxed);
+            return nullptr;
+        }
+        entry->second->referenced.store(true, memory_order_relaxed);
+        shard.hits.fetch_add(1, memory_order_relaxed);
+        return entry->second->object;
+    }
+
+    shared_ptr<void> ObjectCache::put(const OID& id, shared_ptr<void> object, size_t size) {
+        if (size > shardBudget) {
+            return object;
+        }
+
+        Shard& shard = shard_for(id);
+        unique_lock<shared_mutex> lock(shard.mutex);
+        auto existing = shard.entries.find(id);
+        if (existing != shard.entries.end()) {
+            // Another thread cached it first.
+            return existing->second->object;
+        }
+
+        // Sweep the clock hand past recently used entries, evicting the first one that hasn't been used
+        // since the hand last passed it, until the new object fits.
+        while (shard.bytes + size > shardBudget && !shard.clock.empty()) {
+            shard.hand %= shard.clock.size();
+            auto victim = shard.entries.find(shard.clock[shard.hand]);
+            if (victim->second->referenced.exchange(false, memory_order_relaxed)) {
+                shard.hand++;
+                continue;
+            }
+            shard.bytes -= victim->second->size;
+            shard.entries.erase(victim);
+            shard.clock[shard.hand] = shard.clock.back();
+            shard.clock.pop_back();
+            shard.evictions.fetch_add(1, memory_order_relaxed);
+        }
+
+        auto entry = make_unique<Entry>();
+        entry->object = object;
+        entry->size = size;
+        entry->referenced = false;
+        shard.entries.emplace(id, move(entry));
+        shard.clock.push_back(id);
+        shard.bytes += size;
+        return object;
+    }
+
+    Tree ObjectCache::tree(const OID& id) {
+        shared_ptr<void> cached = get(id);
+        if (cached == nullptr) {
+            Tree tree = repo.lookup_tree(id);
+            size_t size = OBJECT_CACHE_ENTRY_OVERHEAD + tree.entrycount() * OBJECT_CACHE_TREE_ENTRY_SIZE;
+            cached = put(id, tree.ptr(), size);
+        }
+        return Tree(static_pointer_cast<git_tree>(cached));
+    }
+
+    Commit ObjectCache::commit(const OID& id) {
+        shared_ptr<void> cached = get(id);
+        if (cached == nullptr) {
+            Commit commit = repo.lookup_commit(id);
+            size_t size = OBJECT_CACHE_ENTRY_OVERHEAD + commit.message().size();
+            cached = put(id, commit.ptr(), size);
+        }
+        return Commit(static_pointer_cast<git_commit>(cached));
+    }
+
+    Blob ObjectCache::blob(const OID& id) {
+        shared_ptr<void> cached = get(id);
+        if (cached == nullptr) {
+            Blob blob = repo.lookup_blob(id);
+            if (blob.rawsize() > OBJECT_CACHE_MAX_BLOB_SIZE) {
+                return blob;
+            }
+            cached = put(id, blob.ptr(), OBJECT_CACHE_ENTRY_OVERHEAD + blob.rawsize());
+        }
+        return Blob(static_pointer_cast<git_blob>(cached));
+    }
+
+    ObjectCacheStats ObjectCache::stats() const {
+        ObjectCacheStats stats {};
+        for (size_t i = 0; i < OBJECT_CACHE_SHARDS; i++) {
+            Shard& shard = shards[i];
+            stats.hits += shard.hits.load(memory_order_relaxed);
+            stats.misses += shard.misses.load(memory_order_relaxed);
+            stats.evictions += shard.evictions.load(memory_order_relaxed);
+            shared_lock<shared_mutex> lock(shard.mutex);
+            stats.bytes += shard.bytes;
+        }
+        return stats;
+    }
+}
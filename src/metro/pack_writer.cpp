@@ -0,0 +1,325 @@
+#include "pch.h"
+#include <zlib.h>
+
+#define PACK_VERSION 2
+// How many objects each compression task takes.
+#define PACK_COMPRESS_CHUNK 64
+
+namespace metro {
+    // Git's hash for grouping objects by name: it weighs the last characters most, so that files with the same
+    // extension sort together, and ignores whitespace.
+    uint32_t pack_name_hash(const string& path) {
+        uint32_t hash = 0;
+        for (char c : path) {
+            if (!isspace((unsigned char) c)) {
+                hash = (hash >> 2) + ((uint32_t) (uint8_t) c << 24);
+            }
+        }
+        return hash;
+    }
+
+    PackWriter::PackWriter(const Repository& repo, PackWriterOptions options)
+            : repo(repo), odb(repo.odb()), options(options) {
+        if (options.localOnly) {
+            local = make_unique<ODB>(ODB::open_directory(repo.path() + "objects"));
+        }
+    }
+
+    bool PackWriter::add(const OID& id, const string& path) {
+        if (positions.count(id) > 0 || leftOut.count(id) > 0) {
+            return false;
+        }
+        if (local != nullptr && !local->exists(id)) {
+            leftOut.insert(id);
+            return false;
+        }
+        Entry entry;
+        entry.id = id;
+        odb.read_header(id, entry.type, entry.size);
+        entry.nameHash = pack_name_hash(path);
+        positions[id] = entries.size();
+        entries.push_back(std::move(entry));
+        return true;
+    }
+
+    void PackWriter::add_commit(const OID& id) {
+        add(id);
+        add_tree(repo.lookup_commit(id).tree().id(), "");
+    }
+
+    void PackWriter::add_tree(const OID& id, const string& path) {
+        // A tree only in the shared store is still walked, since it may lead to objects that aren't.
+        bool walked = positions.count(id) > 0 || leftOut.count(id) > 0;
+        add(id, path);
+        if (walked) {
+            return;
+        }
+        Tree tree = repo.lookup_tree(id);
+        for (size_t i = 0; i < tree.entrycount(); i++) {
+            const git_tree_entry *entry = tree.entry_byindex(i);
+            string entryPath = path.empty()? git_tree_entry_name(entry) : path + "/" + git_tree_entry_name(entry);
+            OID entryId(*git_tree_entry_id(entry));
+            if (git_tree_entry_type(entry) == GIT_OBJECT_TREE) {
+                add_tree(entryId, entryPath);
+            } else if (git_tree_entry_type(entry) == GIT_OBJECT_BLOB) {
+                add(entryId, entryPath);
+            }
+        }
+    }
+
+    void PackWriter::find_deltas(const vector<size_t>& order, size_t start, size_t end) {
+        // The most recent objects, which are tried as bases for the next one.
+        struct WindowSlot {
+            size_t entry;
+            OdbObject object;
+            unique_ptr<DeltaIndex> index;
+        };
+        deque<WindowSlot> window;
+        string delta, best;
+        for (size_t i = start; i < end; i++) {
+            Entry& entry = entries[order[i]];
+            if (entry.size < PACK_MIN_DELTA_OBJECT_SIZE || entry.size > PACK_MAX_DELTA_OBJECT_SIZE) {
+                continue;
+            }
+            OdbObject object = odb.read(entry.id);
+
+            size_t bestBase = SIZE_MAX;
+            for (auto slot = window.rbegin(); slot != window.rend(); ++slot) {
+                const Entry& base = entries[slot->entry];
+                // Objects much smaller than the base rarely make good deltas.
+                if (base.type != entry.type || base.depth >= options.depth || entry.size < base.size / 32) {
+                    continue;
+                }
+                // Deltas must save at least half the object to be worth it, and more the deeper they'd be,
+                // so that short chains are preferred.
+                size_t maxSize = bestBase == SIZE_MAX? entry.size / 2 - 20 : best.size() - 1;
+                maxSize = maxSize * (options.depth - base.depth) / options.depth;
+                if (slot->index->create_delta(object.data(), object.size(), maxSize, delta)) {
+                    best.swap(delta);
+                    bestBase = slot->entry;
+                }
+            }
+            if (bestBase != SIZE_MAX) {
+                entry.base = bestBase;
+                entry.depth = entries[bestBase].depth + 1;
+                entry.delta = best;
+            }
+
+            auto index = make_unique<DeltaIndex>(object.data(), object.size());
+            window.push_back({order[i], std::move(object), std::move(index)});
+            if (window.size() > options.window) {
+                window.pop_front();
+            }
+        }
+    }
+
+    // An object's header in a pack: its type and then its size, in 4 bits and then 7 bits a byte.
+    void append_pack_object_header(string& out, git_object_t type, size_t size) {
+        auto byte = (uint8_t) ((type << 4) | (size & 0x0F));
+        size >>= 4;
+        while (size > 0) {
+            out.push_back((char) (byte | 0x80));
+            byte = size & 0x7F;
+            size >>= 7;
+        }
+        out.push_back((char) byte);
+    }
+
+    // How far back in the pack a delta's base is. Each byte but the last adds one before shifting,
+    // so that no two encodings mean the same distance.
+    void append_pack_base_distance(string& out, uint64_t distance) {
+        char bytes[10];
+        size_t pos = sizeof(bytes) - 1;
+        bytes[pos] = (char) (distance & 0x7F);
+        while (distance >>= 7) {
+            bytes[--pos] = (char) (0x80 | (--distance & 0x7F));
+        }
+        out.append(bytes + pos, sizeof(bytes) - pos);
+    }
+
+    void append_be32(string& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back((char) ((value >> shift) & 0xFF));
+        }
+    }
+
+    string deflate_data(const char *data, size_t size) {
+        uLongf compressedSize = compressBound(size);
+        string out(compressedSize, '\0');
+        if (compress2(reinterpret_cast<Bytef*>(&out[0]), &compressedSize, reinterpret_cast<const Bytef*>(data), size,
+                      Z_DEFAULT_COMPRESSION) != Z_OK) {
+            throw MetroException("Couldn't compress an object for a pack");
+        }
+        out.resize(compressedSize);
+        return out;
+    }
+
+    PackWriterStats PackWriter::write(const string& packDir) {
+#ifdef _WIN32
+        throw UnsupportedOperationException("Writing packs isn't supported on Windows yet.");
+#else
+        METRO_PHASE_PROBE(phase, "pack", packDir.c_str());
+        PackWriterStats stats {};
+        auto searchStart = chrono::steady_clock::now();
+
+        vector<size_t> order(entries.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+            const Entry& x = entries[a];
+            const Entry& y = entries[b];
+            if (x.type != y.type) return x.type < y.type;
+            if (x.nameHash != y.nameHash) return x.nameHash < y.nameHash;
+            if (x.size != y.size) return x.size > y.size;
+            return a < b;
+        });
+        {
+            TaskGroup group(TaskPriority::Background);
+            for (size_t start = 0; start < order.size(); start += PACK_SEARCH_CHUNK) {
+                size_t end = min(start + PACK_SEARCH_CHUNK, order.size());
+                group.run([this, &order, start, end]() {
+                    find_deltas(order, start, end);
+                });
+            }
+            group.wait();
+        }
+        auto writeStart = chrono::steady_clock::now();
+
+        // Commits first, then tags, trees and blobs, so that the objects read together are near each other.
+        // A delta's base always comes before it, so it is written as a distance back from the delta.
+        vector<size_t> writeOrder;
+        vector<bool> queued(entries.size());
+        function<void(size_t)> enqueue = [&](size_t i) {
+            if (queued[i]) {
+                return;
+            }
+            queued[i] = true;
+            if (entries[i].base != SIZE_MAX) {
+                enqueue(entries[i].base);
+            }
+            writeOrder.push_back(i);
+        };
+        for (git_object_t type : {GIT_OBJECT_COMMIT, GIT_OBJECT_TAG, GIT_OBJECT_TREE, GIT_OBJECT_BLOB}) {
+            for (size_t i = 0; i < entries.size(); i++) {
+                if (entries[i].type == type) {
+                    enqueue(i);
+                }
+            }
+        }
+
+        Indexer indexer = Indexer::open(packDir);
+        Digest checksum(DigestType::Sha1);
+        uint64_t offset = 0;
+        auto emit = [&](const string& data) {
+            indexer.append(data.data(), data.size());
+            checksum.update(data.data(), data.size());
+            offset += data.size();
+        };
+
+        string header = "PACK";
+        append_be32(header, PACK_VERSION);
+        append_be32(header, (uint32_t) writeOrder.size());
+        emit(header);
+
+        for (size_t batchStart = 0; batchStart < writeOrder.size(); batchStart += PACK_WRITE_BATCH) {
+            size_t batchEnd = min(batchStart + PACK_WRITE_BATCH, writeOrder.size());
+            vector<string> compressed(batchEnd - batchStart);
+            {
+                TaskGroup group(TaskPriority::Background);
+                for (size_t start = batchStart; start < batchEnd; start += PACK_COMPRESS_CHUNK) {
+                    size_t end = min(start + PACK_COMPRESS_CHUNK, batchEnd);
+                    group.run([&, start, end]() {
+                        for (size_t i = start; i < end; i++) {
+                            Entry& entry = entries[writeOrder[i]];
+                            if (entry.base != SIZE_MAX) {
+                                compressed[i - batchStart] = deflate_data(entry.delta.data(), entry.delta.size());
+                            } else {
+                                OdbObject object = odb.read(entry.id);
+                                compressed[i - batchStart] = deflate_data(object.data(), object.size());
+                            }
+                        }
+                    });
+                }
+                group.wait();
+            }
+
+            for (size_t i = batchStart; i < batchEnd; i++) {
+                Entry& entry = entries[writeOrder[i]];
+                entry.offset = offset;
+                string objectHeader;
+                if (entry.base != SIZE_MAX) {
+                    append_pack_object_header(objectHeader, GIT_OBJECT_OFS_DELTA, entry.delta.size());
+                    append_pack_base_distance(objectHeader, entry.offset - entries[entry.base].offset);
+                    stats.deltas++;
+                    string().swap(entry.delta);
+                } else {
+                    append_pack_object_header(objectHeader, entry.type, entry.size);
+                }
+                emit(objectHeader);
+                emit(compressed[i - batchStart]);
+                stats.objectBytes += entry.size;
+            }
+        }
+
+        string trailer = checksum.finish();
+        indexer.append(trailer.data(), trailer.size());
+        indexer.commit();
+
+        auto writeEnd = chrono::steady_clock::now();
+        stats.name = indexer.name();
+        stats.objects = writeOrder.size();
+        stats.packBytes = offset + trailer.size();
+        stats.searchSeconds = chrono::duration<double>(writeStart - searchStart).count();
+        stats.writeSeconds = chrono::duration<double>(writeEnd - writeStart).count();
+        METRO_PHASE_ADD_ITEMS(phase, stats.objects, stats.packBytes);
+        return stats;
+#endif
+    }
+
+    PackWriterStats repack(const Repository& repo, const PackWriterOptions& options) {
+        METRO_OPERATION_PROBE("");
+        AccessPatternScope pattern(repo, AccessPattern::Sequential);
+        attach_shared_store(repo);
+        ODB odb = repo.odb();
+        string objectsDir = repo.path() + "objects";
+        string packDir = objectsDir + "/pack";
+
+        ObjectRoots roots = object_roots(repo, odb);
+        vector<OID> tips = roots.commits;
+        for (const OID& id : reflog_commits(repo, odb)) {
+            tips.push_back(id);
+        }
+
+        PackWriterOptions writerOptions = options;
+        writerOptions.localOnly = true;
+        PackWriter writer(repo, writerOptions);
+        // Newest first, so that recent versions of files are stored whole and older ones as deltas against them.
+        RevWalk walk = repo.new_revwalk();
+        walk.sorting(GIT_SORT_TIME);
+        for (const OID& tip : tips) {
+            walk.push(tip);
+        }
+        for (OID id; walk.next(id);) {
+            writer.add_commit(id);
+        }
+        for (const OID& tag : roots.tags) {
+            writer.add(tag);
+        }
+        for (const OID& other : roots.others) {
+            if (odb.read(other).type() == GIT_OBJECT_TREE) {
+                writer.add_tree(other, "");
+            } else {
+                writer.add(other);
+            }
+        }
+        for (const auto& [id, path] : roots.staged) {
+            writer.add(id, path);
+        }
+
+        vector<filesystem::path> oldFiles = replaceable_object_files(objectsDir);
+        PackWriterStats stats = writer.write(packDir);
+        remove_replaced_objects(oldFiles, packDir, "pack-" + stats.name);
+        return stats;
+    }
+}
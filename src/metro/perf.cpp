@@ -0,0 +1,268 @@
+#include "pch.h"
+
+#include <random>
+
+#ifdef __unix__
+#include <sys/resource.h>
+#endif
+
+// A window is only tested against the previous one when both have at least this many runs.
+#define PERF_MIN_SAMPLES 5
+// The largest p-value reported as a regression.
+#define PERF_SIGNIFICANCE 0.01
+// Ignore statistically significant slowdowns smaller than this fraction of the previous median.
+#define PERF_MIN_SLOWDOWN 0.1
+
+namespace metro {
+    uint32_t metro_build_id() {
+        // FNV-1a of the build time.
+        uint32_t hash = 2166136261u;
+        for (const char *c = __DATE__ " " __TIME__; *c != '\0'; c++) {
+            hash = (hash ^ (uint8_t) *c) * 16777619u;
+        }
+        return hash;
+    }
+
+    string perf_dir(const Repository& repo) {
+        string dir = metro_dir(repo) + "/perf";
+        filesystem::create_directories(dir);
+        return dir;
+    }
+
+    string perf_segment_path(const string& dir, size_t segment) {
+        return dir + "/segment-" + to_string(segment);
+    }
+
+    // Read the complete records in a segment, ignoring any partly written record at the end.
+    vector<PerfRecord> read_perf_segment(const string& path) {
+        string data = read_all(path);
+        vector<PerfRecord> records(data.size() / sizeof(PerfRecord));
+        memcpy(records.data(), data.data(), records.size() * sizeof(PerfRecord));
+        return records;
+    }
+
+    // The segment new records go in: the one with the newest records, or the one after it if it is full.
+    size_t perf_current_segment(const string& dir) {
+        size_t newest = 0;
+        int64_t newestTime = INT64_MIN;
+        for (size_t i = 0; i < PERF_SEGMENT_COUNT; i++) {
+            string path = perf_segment_path(dir, i);
+            error_code err;
+            uintmax_t size = filesystem::file_size(path, err);
+            if (err || size < sizeof(PerfRecord)) {
+                continue;
+            }
+
+            PerfRecord last {};
+            ifstream file(path, ios::binary);
+            file.seekg((size / sizeof(PerfRecord) - 1) * sizeof(PerfRecord));
+            file.read(reinterpret_cast<char*>(&last), sizeof(last));
+            if (file && last.time > newestTime) {
+                newest = i;
+                newestTime = last.time;
+            }
+        }
+
+        error_code err;
+        uintmax_t size = filesystem::file_size(perf_segment_path(dir, newest), err);
+        if (!err && size >= PERF_SEGMENT_RECORDS * sizeof(PerfRecord)) {
+            newest = (newest + 1) % PERF_SEGMENT_COUNT;
+            // Overwrite the oldest segment.
+            ofstream(perf_segment_path(dir, newest), ios::binary | ios::trunc);
+        }
+        return newest;
+    }
+
+    void record_command_perf(const string& command, chrono::steady_clock::duration wallTime, int exitCode) {
+        PerfRecord record {};
+        record.time = chrono::duration_cast<chrono::seconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+        record.wallMicros = chrono::duration_cast<chrono::microseconds>(wallTime).count();
+        record.buildId = metro_build_id();
+        record.exitCode = exitCode;
+        strncpy(record.command, command.c_str(), PERF_COMMAND_NAME_SIZE - 1);
+#ifdef __unix__
+        rusage usage {};
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            record.cpuMicros = (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull
+                    + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+            record.maxRssKb = usage.ru_maxrss;
+        }
+#endif
+
+        // The perf history must never make a command fail.
+        try {
+            string dir = perf_dir(Repository::open("."));
+            ofstream file(perf_segment_path(dir, perf_current_segment(dir)), ios::binary | ios::app);
+            file.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        } catch (exception&) {}
+    }
+
+    vector<PerfRecord> read_perf_history(const Repository& repo) {
+        string dir = perf_dir(repo);
+        vector<PerfRecord> records;
+        for (size_t i = 0; i < PERF_SEGMENT_COUNT; i++) {
+            vector<PerfRecord> segment = read_perf_segment(perf_segment_path(dir, i));
+            records.insert(records.end(), segment.begin(), segment.end());
+        }
+        stable_sort(records.begin(), records.end(), [](const PerfRecord& a, const PerfRecord& b) {
+            return a.time < b.time;
+        });
+        return records;
+    }
+
+    // The value at the given fraction of the way through the sorted values, using the nearest rank.
+    uint64_t percentile(const vector<uint64_t>& sorted, double fraction) {
+        size_t rank = (size_t) ceil(fraction * sorted.size());
+        return sorted[rank == 0? 0 : rank - 1];
+    }
+
+    // The one-sided p-value that later is drawn from a distribution no greater than earlier,
+    // using the normal approximation to the Mann-Whitney U statistic.
+    double mann_whitney_p(const vector<uint64_t>& earlier, const vector<uint64_t>& later) {
+        vector<pair<uint64_t, bool>> all;
+        for (uint64_t value : earlier) {
+            all.emplace_back(value, false);
+        }
+        for (uint64_t value : later) {
+            all.emplace_back(value, true);
+        }
+        sort(all.begin(), all.end());
+
+        // Sum the ranks of the later values, giving tied values the average of their ranks.
+        double laterRanks = 0;
+        for (size_t i = 0; i < all.size();) {
+            size_t end = i;
+            while (end < all.size() && all[end].first == all[i].first) {
+                end++;
+            }
+            double rank = (i + 1 + end) / 2.0;
+            for (; i < end; i++) {
+                if (all[i].second) {
+                    laterRanks += rank;
+                }
+            }
+        }
+
+        double n1 = later.size();
+        double n2 = earlier.size();
+        double u = laterRanks - n1 * (n1 + 1) / 2;
+        double sd = sqrt(n1 * n2 * (n1 + n2 + 1) / 12);
+        double z = (u - n1 * n2 / 2 - 0.5) / sd;
+        return 0.5 * erfc(z / sqrt(2.0));
+    }
+
+    vector<PerfWindow> perf_history(const Repository& repo, int64_t windowSeconds) {
+        // Group the durations by command, then by window.
+        map<string, map<int64_t, pair<vector<uint64_t>, set<uint32_t>>>> grouped;
+        for (const PerfRecord& record : read_perf_history(repo)) {
+            string command(record.command, strnlen(record.command, PERF_COMMAND_NAME_SIZE));
+            int64_t start = record.time - record.time % windowSeconds;
+            auto& window = grouped[command][start];
+            window.first.push_back(record.wallMicros);
+            window.second.insert(record.buildId);
+        }
+
+        vector<PerfWindow> windows;
+        for (auto& [command, byStart] : grouped) {
+            const vector<uint64_t> *previous = nullptr;
+            const set<uint32_t> *previousBuilds = nullptr;
+            for (auto& [start, samples] : byStart) {
+                vector<uint64_t>& durations = samples.first;
+                sort(durations.begin(), durations.end());
+
+                PerfWindow window {command, start, durations.size(), percentile(durations, 0.5),
+                                   percentile(durations, 0.9), percentile(durations, 0.99), false, false, 1};
+                if (previousBuilds != nullptr) {
+                    for (uint32_t build : samples.second) {
+                        window.newBuild |= previousBuilds->count(build) == 0;
+                    }
+                }
+                if (previous != nullptr && previous->size() >= PERF_MIN_SAMPLES
+                        && durations.size() >= PERF_MIN_SAMPLES) {
+                    window.pValue = mann_whitney_p(*previous, durations);
+                    window.regression = window.pValue < PERF_SIGNIFICANCE
+                            && window.p50Micros > percentile(*previous, 0.5) * (1 + PERF_MIN_SLOWDOWN);
+                }
+                windows.push_back(window);
+
+                previous = &durations;
+                previousBuilds = &samples.second;
+            }
+        }
+        return windows;
+    }
+
+    // Run lookup on threads threads at once, each passing it its own shuffled copy of ids lookups times over
+    // in total, and return the lookups made per second.
+    double lookup_rate(unsigned int threads, const vector<pair<OID, bool>>& ids, size_t lookups,
+                       const function<void(const pair<OID, bool>&)>& lookup) {
+        vector<vector<pair<OID, bool>>> orders(threads, ids);
+        for (unsigned int i = 0; i < threads; i++) {
+            shuffle(orders[i].begin(), orders[i].end(), mt19937(i));
+        }
+
+        // Start timing once every thread is ready, so thread start-up isn't counted.
+        atomic<unsigned int> ready(0);
+        atomic<bool> go(false);
+        vector<thread> workers;
+        for (unsigned int i = 0; i < threads; i++) {
+            workers.emplace_back([&, i]() {
+                ready++;
+                while (!go) {
+                    this_thread::yield();
+                }
+                const vector<pair<OID, bool>>& order = orders[i];
+                for (size_t n = 0; n < lookups; n++) {
+                    lookup(order[n % order.size()]);
+                }
+            });
+        }
+        while (ready < threads) {
+            this_thread::yield();
+        }
+        auto start = chrono::steady_clock::now();
+        go = true;
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        return (double) threads * lookups / seconds;
+    }
+
+    vector<CacheScaling> object_cache_scaling(const Repository& repo, unsigned int maxThreads, size_t lookupsPerThread) {
+        METRO_OPERATION_PROBE("");
+        // The commits and their root trees, marked true for commits.
+        vector<pair<OID, bool>> ids;
+        RevWalk walk = repo.new_revwalk();
+        walk.sorting(GIT_SORT_TIME);
+        walk.push(get_commit(repo, "HEAD").id());
+        for (OID id; ids.size() < 2 * CACHE_BENCHMARK_COMMITS && walk.next(id);) {
+            ids.emplace_back(id, true);
+            ids.emplace_back(repo.lookup_commit(id).tree().id(), false);
+        }
+
+        vector<CacheScaling> results;
+        for (unsigned int threads = 1; threads <= maxThreads; threads *= 2) {
+            ObjectCache cache(repo);
+            double cachedRate = lookup_rate(threads, ids, lookupsPerThread, [&](const pair<OID, bool>& id) {
+                if (id.second) {
+                    (void) cache.commit(id.first);
+                } else {
+                    (void) cache.tree(id.first);
+                }
+            });
+            double directRate = lookup_rate(threads, ids, lookupsPerThread, [&](const pair<OID, bool>& id) {
+                if (id.second) {
+                    (void) repo.lookup_commit(id.first);
+                } else {
+                    (void) repo.lookup_tree(id.first);
+                }
+            });
+            ObjectCacheStats stats = cache.stats();
+            double hitRate = (double) stats.hits / max<uint64_t>(1, stats.hits + stats.misses);
+            results.push_back({threads, cachedRate, directRate, hitRate});
+        }
+        return results;
+    }
+}
@@ -0,0 +1,144 @@
+#include "pch.h"
+
+#ifdef __unix__
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+
+extern char **environ;
+#endif
+
+// Number of switches remembered in the history.
+#define SWITCH_HISTORY_LENGTH 256
+// Blobs bigger than this aren't worth reading ahead of time.
+#define PREWARM_MAX_BLOB_SIZE (16 * 1024 * 1024)
+// Stop prewarming after reading this much, so as not to push everything else out of the page cache.
+#define PREWARM_MAX_TOTAL_SIZE (256 * 1024 * 1024)
+
+namespace metro {
+    string switch_history_path(const Repository& repo) {
+        return metro_dir(repo) + "/switch-history";
+    }
+
+    // Each line of the history is "<from> <to>", oldest first.
+    vector<pair<string, string>> read_switch_history(const Repository& repo) {
+        vector<pair<string, string>> history;
+        ifstream file(switch_history_path(repo));
+        for (string line; getline(file, line);) {
+            string from, to;
+            split_at_first(line, ' ', from, to);
+            if (!to.empty()) {
+                history.emplace_back(from, to);
+            }
+        }
+        return history;
+    }
+
+    void record_switch(const Repository& repo, const string& from, const string& to) {
+        vector<pair<string, string>> history = read_switch_history(repo);
+        history.emplace_back(from, to);
+        size_t start = history.size() > SWITCH_HISTORY_LENGTH? history.size() - SWITCH_HISTORY_LENGTH : 0;
+
+        string text;
+        for (size_t i = start; i < history.size(); i++) {
+            text += history[i].first + " " + history[i].second + "\n";
+        }
+        write_all_atomic(text, switch_history_path(repo));
+    }
+
+    vector<string> likely_switch_targets(const Repository& repo, const string& from, size_t count) {
+        // Score each target by how often it follows this branch, breaking ties by how recently it did.
+        map<string, pair<size_t, size_t>> scores;
+        vector<pair<string, string>> history = read_switch_history(repo);
+        for (size_t i = 0; i < history.size(); i++) {
+            if (history[i].first == from && history[i].second != from) {
+                auto& score = scores[history[i].second];
+                score.first++;
+                score.second = i;
+            }
+        }
+
+        vector<pair<pair<size_t, size_t>, string>> ranked;
+        for (const auto& [target, score] : scores) {
+            if (branch_exists(repo, target)) {
+                ranked.emplace_back(score, target);
+            }
+        }
+        sort(ranked.rbegin(), ranked.rend());
+
+        vector<string> targets;
+        for (size_t i = 0; i < ranked.size() && i < count; i++) {
+            targets.push_back(ranked[i].second);
+        }
+        return targets;
+    }
+
+    size_t prewarm(const Repository& repo, size_t targetCount) {
+        METRO_OPERATION_PROBE("");
+        AccessPatternScope pattern(repo, AccessPattern::WillNeed);
+        string current = current_branch_name(repo);
+        Tree currentTree = get_commit(repo, "HEAD").tree();
+        ODB odb = repo.odb();
+        git_diff_options diffOpts = GIT_DIFF_OPTIONS_INIT;
+
+        size_t total = 0;
+        for (const string& target : likely_switch_targets(repo, current, targetCount)) {
+            // Diffing loads every tree that differs, and the blobs that differ are read below.
+            Diff diff = repo.diff_tree_to_tree(currentTree, get_commit(repo, target).tree(), diffOpts);
+            for (size_t i = 0; i < diff.num_deltas() && total < PREWARM_MAX_TOTAL_SIZE; i++) {
+                const git_diff_delta *delta = diff.get_delta(i);
+                if (delta->status == GIT_DELTA_DELETED || delta->new_file.mode == GIT_FILEMODE_COMMIT) {
+                    continue;
+                }
+                // Tree diffs don't fill in file sizes, so look the size up without reading the blob.
+                OID id(delta->new_file.id);
+                if (odb.read_size(id) > PREWARM_MAX_BLOB_SIZE) {
+                    continue;
+                }
+                total += odb.read(id).size();
+            }
+        }
+        return total;
+    }
+
+#ifdef __unix__
+    void prewarm_in_background(const Repository& repo) {
+        // Run metro prewarm as a new process rather than forking this one, whose other threads
+        // may hold locks that a forked child would never see released.
+        // It inherits the working directory, so it opens the same repo.
+        error_code err;
+        string program = filesystem::read_symlink("/proc/self/exe", err).string();
+        bool haveSelf = !err;
+        if (!haveSelf) {
+            program = "metro";
+        }
+        string command = "prewarm";
+        vector<char*> argv = {const_cast<char*>(program.c_str()), const_cast<char*>(command.c_str()), nullptr};
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawnattr_t attributes;
+        posix_spawnattr_init(&attributes);
+#ifdef POSIX_SPAWN_SETSID
+        // Detach from the terminal so the user's shell doesn't wait for it.
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSID);
+#endif
+
+        cout.flush();
+        pid_t pid;
+        if (haveSelf) {
+            posix_spawn(&pid, program.c_str(), &actions, &attributes, argv.data(), environ);
+        } else {
+            posix_spawnp(&pid, program.c_str(), &actions, &attributes, argv.data(), environ);
+        }
+        // Prewarming is only a hint, so failing to start it isn't worth reporting.
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+    }
+#else
+    void prewarm_in_background(const Repository& repo) {}
+#endif
+}
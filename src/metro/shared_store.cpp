@@ -0,0 +1,248 @@
+#include "pch.h"
+
+// Higher than libgit2's own backends, so the pool is where new objects are written.
+#define SHARED_STORE_PRIORITY 10
+// Unreferenced loose objects newer than this are kept, as a commit may be about to reference them.
+#define SHARED_STORE_GRACE_PERIOD chrono::hours(1)
+
+namespace metro {
+    string shared_store_path(const Repository& repo) {
+        string path = read_all(metro_dir(repo) + "/shared-store");
+        path.erase(path.find_last_not_of("\r\n") + 1);
+        return path;
+    }
+
+    string alternates_path(const Repository& repo) {
+        return repo.path() + "objects/info/alternates";
+    }
+
+    // Read a file as a list of lines, skipping empty ones.
+    vector<string> read_lines(const string& path) {
+        vector<string> lines;
+        ifstream file(path);
+        for (string line; getline(file, line);) {
+            if (!line.empty()) {
+                lines.push_back(line);
+            }
+        }
+        return lines;
+    }
+
+    void write_lines(const vector<string>& lines, const string& path) {
+        string text;
+        for (const string& line : lines) {
+            text += line + "\n";
+        }
+        write_all_atomic(text, path);
+    }
+
+    // The pool's registry lists the .git directory of every repo using it, and so counts the references to the pool.
+    string registry_path(const string& pool) {
+        return pool + "/repos";
+    }
+
+    void join_shared_store(const Repository& repo, const string& poolPath) {
+        if (!shared_store_path(repo).empty()) {
+            throw UnsupportedOperationException("This repo already uses a shared object store.");
+        }
+
+        string pool = filesystem::absolute(poolPath).lexically_normal().string();
+        filesystem::create_directories(pool + "/objects/pack");
+        filesystem::create_directories(pool + "/objects/info");
+
+        string gitDir = filesystem::absolute(repo.path()).lexically_normal().string();
+        vector<string> registered = read_lines(registry_path(pool));
+        if (find(registered.begin(), registered.end(), gitDir) == registered.end()) {
+            registered.push_back(gitDir);
+            write_lines(registered, registry_path(pool));
+        }
+
+        // The alternates file lets plain git tools find the pool's objects too.
+        filesystem::create_directories(repo.path() + "objects/info");
+        vector<string> alternates = read_lines(alternates_path(repo));
+        alternates.push_back(pool + "/objects");
+        write_lines(alternates, alternates_path(repo));
+
+        write_all(pool + "\n", metro_dir(repo) + "/shared-store");
+        attach_shared_store(repo);
+    }
+
+    void attach_shared_store(const Repository& repo) {
+        // Remember which repos already write to their pool. The weak pointer detects
+        // a repo that has been freed and had its address reused.
+        static mutex attachedMutex;
+        static map<git_repository*, weak_ptr<git_repository>> attached;
+        lock_guard<mutex> lock(attachedMutex);
+
+        auto found = attached.find(repo.ptr().get());
+        if (found != attached.end() && !found->second.expired()) {
+            return;
+        }
+
+        string pool = shared_store_path(repo);
+        if (pool.empty()) {
+            return;
+        }
+        repo.odb().add_loose_backend(pool + "/objects", SHARED_STORE_PRIORITY);
+        attached[repo.ptr().get()] = repo.ptr();
+    }
+
+    void mark_tree(const Repository& repo, const OID& id, set<OID>& marked) {
+        if (!marked.insert(id).second) {
+            return;
+        }
+
+        Tree tree = repo.lookup_tree(id);
+        for (size_t i = 0; i < tree.entrycount(); i++) {
+            const git_tree_entry *entry = tree.entry_byindex(i);
+            OID entryId(*git_tree_entry_id(entry));
+            switch (git_tree_entry_type(entry)) {
+                case GIT_OBJECT_TREE:
+                    mark_tree(repo, entryId, marked);
+                    break;
+                case GIT_OBJECT_BLOB:
+                    marked.insert(entryId);
+                    break;
+                default:
+                    // Submodule commits live in the submodule's own repo.
+                    break;
+            }
+        }
+    }
+
+    // Add every object the repo may still need to marked: everything reachable from its refs, reflogs,
+    // in-progress operations, and the HEADs and indexes of its worktrees, the same objects repack keeps.
+    void mark_reachable(const Repository& repo, set<OID>& marked) {
+        ODB odb = repo.odb();
+        ObjectRoots roots = object_roots(repo, odb);
+        RevWalk walk = repo.new_revwalk();
+        for (const OID& tip : roots.commits) {
+            walk.push(tip);
+        }
+        for (const OID& id : reflog_commits(repo, odb)) {
+            walk.push(id);
+        }
+
+        for (OID id; walk.next(id);) {
+            if (!marked.insert(id).second) {
+                continue;
+            }
+            mark_tree(repo, repo.lookup_commit(id).tree().id(), marked);
+        }
+
+        for (const OID& tag : roots.tags) {
+            marked.insert(tag);
+        }
+        for (const OID& other : roots.others) {
+            if (odb.read(other).type() == GIT_OBJECT_TREE) {
+                mark_tree(repo, other, marked);
+            } else {
+                marked.insert(other);
+            }
+        }
+        for (const auto& [id, path] : roots.staged) {
+            marked.insert(id);
+        }
+    }
+
+    void leave_shared_store(const Repository& repo) {
+        string pool = shared_store_path(repo);
+        if (pool.empty()) {
+            throw UnsupportedOperationException("This repo doesn't use a shared object store.");
+        }
+
+        // Copy everything the repo needs out of the pool before letting go of it.
+        set<OID> needed;
+        mark_reachable(repo, needed);
+        ODB local = ODB::open_directory(repo.path() + "objects");
+        ODB all = repo.odb();
+        for (const OID& id : needed) {
+            if (!local.exists(id)) {
+                OdbObject object = all.read(id);
+                local.write(object.data(), object.size(), object.type());
+            }
+        }
+
+        vector<string> alternates = read_lines(alternates_path(repo));
+        alternates.erase(remove(alternates.begin(), alternates.end(), pool + "/objects"), alternates.end());
+        write_lines(alternates, alternates_path(repo));
+
+        string gitDir = filesystem::absolute(repo.path()).lexically_normal().string();
+        vector<string> registered = read_lines(registry_path(pool));
+        registered.erase(remove(registered.begin(), registered.end(), gitDir), registered.end());
+        write_lines(registered, registry_path(pool));
+
+        filesystem::remove(metro_dir(repo) + "/shared-store");
+    }
+
+    SharedStoreStats gc_shared_store(const Repository& repo) {
+        METRO_OPERATION_PROBE("");
+        AccessPatternScope pattern(repo, AccessPattern::Sequential);
+        string pool = shared_store_path(repo);
+        if (pool.empty()) {
+            throw UnsupportedOperationException("This repo doesn't use a shared object store.");
+        }
+
+        // An object stays in the pool while any registered repo references it.
+        set<OID> referenced;
+        vector<string> live;
+        for (const string& gitDir : read_lines(registry_path(pool))) {
+            if (!Repository::exists(gitDir)) {
+                continue;
+            }
+            mark_reachable(Repository::open(gitDir), referenced);
+            live.push_back(gitDir);
+        }
+        write_lines(live, registry_path(pool));
+
+        string objectsDir = pool + "/objects";
+        string packDir = objectsDir + "/pack";
+        // Only the packs are replaced here; which loose objects go is decided below, with a shorter grace period.
+        vector<filesystem::path> oldPacks;
+        for (const filesystem::path& path : replaceable_object_files(objectsDir)) {
+            if (path.parent_path().filename() == "pack") {
+                oldPacks.push_back(path);
+            }
+        }
+
+        // Pack every referenced object in the pool, and decide which loose objects can be deleted.
+        PackBuilder builder = repo.new_packbuilder();
+        vector<filesystem::path> looseToDelete;
+        size_t removed = 0;
+        auto graceStart = filesystem::file_time_type::clock::now() - SHARED_STORE_GRACE_PERIOD;
+        ODB::open_directory(objectsDir).foreach([&](const OID& id) {
+            string hex = id.str();
+            filesystem::path loosePath = objectsDir + "/" + hex.substr(0, 2) + "/" + hex.substr(2);
+            error_code noFile;
+            auto modified = filesystem::last_write_time(loosePath, noFile);
+            bool isLoose = !noFile;
+
+            if (referenced.count(id) > 0) {
+                builder.insert(id);
+                if (isLoose) {
+                    looseToDelete.push_back(loosePath);
+                }
+            } else if (!isLoose || modified < graceStart) {
+                if (isLoose) {
+                    looseToDelete.push_back(loosePath);
+                }
+                removed++;
+            }
+        });
+
+        size_t kept = builder.object_count();
+        if (kept > 0) {
+            // When nothing changed, the new pack has the same name as an old one, which must survive.
+            builder.write(packDir);
+            remove_replaced_objects(oldPacks, packDir, "pack-" + builder.name());
+        } else {
+            for (const filesystem::path& path : oldPacks) {
+                filesystem::remove(path);
+            }
+        }
+        for (const filesystem::path& path : looseToDelete) {
+            filesystem::remove(path);
+        }
+        return {live.size(), kept, removed};
+    }
+}
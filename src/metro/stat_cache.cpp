@@ -0,0 +1,209 @@
+#include "pch.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#define STAT_CACHE_MAGIC "MSC1"
+
+namespace metro {
+#ifndef _WIN32
+    bool stat_file(const string& path, FileStat& out) {
+        struct stat st {};
+        if (lstat(path.c_str(), &st) != 0) {
+            return false;
+        }
+
+        if (S_ISLNK(st.st_mode)) {
+            out.mode = GIT_FILEMODE_LINK;
+        } else if (S_ISREG(st.st_mode)) {
+            out.mode = (st.st_mode & S_IXUSR) != 0? GIT_FILEMODE_BLOB_EXECUTABLE : GIT_FILEMODE_BLOB;
+        } else if (S_ISDIR(st.st_mode)) {
+            out.mode = GIT_FILEMODE_TREE;
+        } else {
+            return false;
+        }
+#ifdef __APPLE__
+        out.ctime = {(int32_t) st.st_ctimespec.tv_sec, (uint32_t) st.st_ctimespec.tv_nsec};
+        out.mtime = {(int32_t) st.st_mtimespec.tv_sec, (uint32_t) st.st_mtimespec.tv_nsec};
+#else
+        out.ctime = {(int32_t) st.st_ctim.tv_sec, (uint32_t) st.st_ctim.tv_nsec};
+        out.mtime = {(int32_t) st.st_mtim.tv_sec, (uint32_t) st.st_mtim.tv_nsec};
+#endif
+        out.dev = st.st_dev;
+        out.ino = st.st_ino;
+        out.uid = st.st_uid;
+        out.gid = st.st_gid;
+        out.size = st.st_size;
+        return true;
+    }
+#else
+    bool stat_file(const string& path, FileStat& out) {
+        error_code err;
+        filesystem::file_status status = filesystem::symlink_status(path, err);
+        if (err) {
+            return false;
+        }
+
+        out = FileStat {};
+        if (filesystem::is_symlink(status)) {
+            out.mode = GIT_FILEMODE_LINK;
+        } else if (filesystem::is_regular_file(status)) {
+            out.mode = GIT_FILEMODE_BLOB;
+            out.size = filesystem::file_size(path, err);
+        } else if (filesystem::is_directory(status)) {
+            out.mode = GIT_FILEMODE_TREE;
+        } else {
+            return false;
+        }
+        auto time = filesystem::last_write_time(path, err).time_since_epoch();
+        out.mtime = {(int32_t) chrono::duration_cast<chrono::seconds>(time).count(),
+                     (uint32_t) (chrono::duration_cast<chrono::nanoseconds>(time).count() % 1000000000)};
+        return true;
+    }
+#endif
+
+    bool same_stat(const FileStat& a, const FileStat& b) {
+        return a.mode == b.mode && a.size == b.size
+               && a.mtime.seconds == b.mtime.seconds && a.mtime.nanoseconds == b.mtime.nanoseconds
+               && a.ctime.seconds == b.ctime.seconds && a.ctime.nanoseconds == b.ctime.nanoseconds
+               && a.ino == b.ino && a.dev == b.dev && a.uid == b.uid && a.gid == b.gid;
+    }
+
+    StatCache::StatCache(const Repository& repo) : path(metro_dir(repo) + "/statcache") {
+        load();
+    }
+
+    // Read all entries from the cache file. A missing or corrupt file is treated as an empty cache,
+    // since everything in it can be recomputed.
+    void StatCache::load() {
+        FileStat fileStat {};
+        if (!stat_file(path, fileStat)) {
+            return;
+        }
+        string data = read_all(path);
+        if (!has_prefix(data, STAT_CACHE_MAGIC)) {
+            return;
+        }
+        written = fileStat.mtime;
+
+        try {
+            size_t pos = strlen(STAT_CACHE_MAGIC);
+            // Each path is stored as the length it shares with the previous path, then the rest of it.
+            string entryPath;
+            while (pos < data.size()) {
+                size_t shared = read_varint(data, pos);
+                size_t suffixSize = read_varint(data, pos);
+                if (shared > entryPath.size() || pos + suffixSize > data.size()) {
+                    throw MetroException("Corrupt stat cache");
+                }
+                entryPath = entryPath.substr(0, shared) + data.substr(pos, suffixSize);
+                pos += suffixSize;
+
+                Entry entry {};
+                entry.stat.ctime.seconds = read_varint(data, pos);
+                entry.stat.ctime.nanoseconds = read_varint(data, pos);
+                entry.stat.mtime.seconds = read_varint(data, pos);
+                entry.stat.mtime.nanoseconds = read_varint(data, pos);
+                entry.stat.dev = read_varint(data, pos);
+                entry.stat.ino = read_varint(data, pos);
+                entry.stat.uid = read_varint(data, pos);
+                entry.stat.gid = read_varint(data, pos);
+                entry.stat.size = read_varint(data, pos);
+                entry.stat.mode = read_varint(data, pos);
+                if (pos + GIT_OID_RAWSZ > data.size()) {
+                    throw MetroException("Corrupt stat cache");
+                }
+                git_oid_fromraw(&entry.id.oid, reinterpret_cast<const unsigned char*>(data.data() + pos));
+                pos += GIT_OID_RAWSZ;
+                entries[entryPath] = entry;
+            }
+        } catch (MetroException&) {
+            entries.clear();
+        }
+    }
+
+    bool StatCache::get(const string& filePath, const FileStat& stat, OID& id) const {
+        auto entry = entries.find(filePath);
+        if (entry == entries.end() || !same_stat(entry->second.stat, stat)) {
+            return false;
+        }
+        // The file may have been modified again after it was hashed.
+        if (racily_clean(entry->second.stat)) {
+            return false;
+        }
+        id = entry->second.id;
+        return true;
+    }
+
+    bool StatCache::racily_clean(const FileStat& stat) const {
+        return stat.mtime.seconds > written.seconds
+               || (stat.mtime.seconds == written.seconds && stat.mtime.nanoseconds >= written.nanoseconds);
+    }
+
+    bool StatCache::lookup(const string& filePath, FileStat& stat, OID& id) const {
+        auto entry = entries.find(filePath);
+        if (entry == entries.end()) {
+            return false;
+        }
+        stat = entry->second.stat;
+        id = entry->second.id;
+        return true;
+    }
+
+    void StatCache::put(const string& filePath, const FileStat& stat, const OID& id) {
+        Entry& entry = entries[filePath];
+        // Even if nothing changed, a racily clean entry needs the cache rewritten, which moves the time
+        // the cache was written past the file's, or the file would be hashed again every time.
+        if (!same_stat(entry.stat, stat) || entry.id != id || racily_clean(stat)) {
+            entry = {stat, id};
+            dirty = true;
+        }
+    }
+
+    void StatCache::retain(const set<string>& paths) {
+        for (auto entry = entries.begin(); entry != entries.end();) {
+            if (paths.count(entry->first) == 0) {
+                entry = entries.erase(entry);
+                dirty = true;
+            } else {
+                entry++;
+            }
+        }
+    }
+
+    void StatCache::save() {
+        if (!dirty) {
+            return;
+        }
+
+        string data = STAT_CACHE_MAGIC;
+        const string *previous = nullptr;
+        for (const auto& [entryPath, entry] : entries) {
+            size_t shared = 0;
+            if (previous != nullptr) {
+                while (shared < previous->size() && shared < entryPath.size() && (*previous)[shared] == entryPath[shared]) {
+                    shared++;
+                }
+            }
+            append_varint(data, shared);
+            append_varint(data, entryPath.size() - shared);
+            data.append(entryPath, shared, string::npos);
+
+            append_varint(data, entry.stat.ctime.seconds);
+            append_varint(data, entry.stat.ctime.nanoseconds);
+            append_varint(data, entry.stat.mtime.seconds);
+            append_varint(data, entry.stat.mtime.nanoseconds);
+            append_varint(data, entry.stat.dev);
+            append_varint(data, entry.stat.ino);
+            append_varint(data, entry.stat.uid);
+            append_varint(data, entry.stat.gid);
+            append_varint(data, entry.stat.size);
+            append_varint(data, entry.stat.mode);
+            data.append(reinterpret_cast<const char*>(entry.id.oid.id), GIT_OID_RAWSZ);
+            previous = &entryPath;
+        }
+        write_all_atomic(data, path);
+        dirty = false;
+    }
+}
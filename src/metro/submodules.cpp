@@ -0,0 +1,133 @@
+#include "pch.h"
+
+// Each submodule is a repo of its own, which the worker handling it opens, so checkouts and status run in parallel.
+namespace metro {
+    struct SubmoduleState {
+        // Path of the submodule's working directory.
+        string path;
+        // The commit recorded for the submodule in the superproject tree, if any.
+        OID recorded;
+        bool hasRecorded;
+    };
+
+    // The submodules of the repo that have been cloned, with the commits recorded for them in tree.
+    vector<SubmoduleState> submodule_states(const Repository& repo, const Tree& tree) {
+        vector<SubmoduleState> states;
+        vector<string> paths = repo.submodule_paths();
+        if (paths.empty()) {
+            return states;
+        }
+        // A switch looks the submodules up in HEAD's tree, the branch's and the WIP commit's, which mostly share
+        // the trees on the way to each submodule.
+        TreeCache trees(repo, PERSISTED_TREE_CACHE_SIZE, true);
+        for (const string& path : paths) {
+            string fullPath = repo.workdir() + path;
+            if (!Repository::exists(fullPath)) {
+                continue;
+            }
+            FlatTreeEntry entry {};
+            bool hasRecorded = trees.find_path(tree.id(), path, entry) && entry.mode == GIT_FILEMODE_COMMIT;
+            states.push_back({fullPath, hasRecorded? entry.id : OID(), hasRecorded});
+        }
+        trees.save();
+        return states;
+    }
+
+    bool submodules_changed(const Repository& repo) {
+        vector<SubmoduleState> states = submodule_states(repo, get_commit(repo, "HEAD").tree());
+        atomic<bool> changed(false);
+        parallel_for_each(states, [&](const SubmoduleState& state) {
+            if (changed) {
+                return;
+            }
+            Repository submodule = Repository::open(state.path);
+            if (!state.hasRecorded || !commit_exists(submodule, "HEAD")
+                    || get_commit(submodule, "HEAD").id() != state.recorded
+                    || has_uncommitted_changes(submodule)) {
+                changed = true;
+            }
+        });
+        return changed;
+    }
+
+    void save_submodule_wips(const Repository& repo, const string& branchName) {
+        vector<SubmoduleState> states = submodule_states(repo, get_commit(repo, "HEAD").tree());
+        parallel_for_each(states, [&](const SubmoduleState& state) {
+            Repository submodule = Repository::open(state.path);
+            if (!has_uncommitted_changes(submodule)) {
+                return;
+            }
+            if (merge_ongoing(submodule)) {
+                throw UnsupportedOperationException(("Submodule " + state.path + " is absorbing, please resolve it first.").c_str());
+            }
+
+            string wipName = branchName + WIPString;
+            try {
+                delete_branch(submodule, wipName);
+            } catch (GitException&) {
+                // We don't mind if the delete fails, we tried it just in case.
+            }
+            Commit head = get_commit(submodule, "HEAD");
+            OID wip = commit_wip(submodule, "refs/heads/" + wipName, "WIP", {head});
+
+            // Reset the working directory to HEAD, using the WIP tree as the baseline
+            // so that files only present in the WIP commit are removed too.
+            Tree wipTree = submodule.lookup_commit(wip).tree();
+            git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
+            checkoutOpts.checkout_strategy = GIT_CHECKOUT_FORCE;
+            checkoutOpts.baseline = wipTree.ptr().get();
+            submodule.checkout_tree(head.tree(), checkoutOpts);
+        });
+    }
+
+    void restore_submodule_wips(const Repository& repo, const string& branchName) {
+        vector<SubmoduleState> states = submodule_states(repo, get_commit(repo, "HEAD").tree());
+        parallel_for_each(states, [&](const SubmoduleState& state) {
+            Repository submodule = Repository::open(state.path);
+            string wipName = branchName + WIPString;
+            if (!branch_exists(submodule, wipName)) {
+                return;
+            }
+
+            git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
+            checkoutOpts.checkout_strategy = GIT_CHECKOUT_FORCE;
+            submodule.checkout_tree(get_commit(submodule, wipName).tree(), checkoutOpts);
+            delete_branch(submodule, wipName);
+        });
+    }
+
+    vector<string> checkout_submodules(const Repository& repo, const Tree& tree) {
+        vector<SubmoduleState> states = submodule_states(repo, tree);
+        vector<string> skipped;
+        mutex skippedMutex;
+        parallel_for_each(states, [&](const SubmoduleState& state) {
+            if (!state.hasRecorded) {
+                return;
+            }
+            Repository submodule = Repository::open(state.path);
+            if (commit_exists(submodule, "HEAD") && get_commit(submodule, "HEAD").id() == state.recorded) {
+                return;
+            }
+            // Like git, leave a submodule that hasn't fetched the recorded commit where it is rather than
+            // failing the switch halfway through.
+            if (!submodule.odb().exists(state.recorded)) {
+                lock_guard<mutex> lock(skippedMutex);
+                skipped.push_back(state.path);
+                return;
+            }
+
+            // Like git, leave the submodule with a detached HEAD at the recorded commit.
+            // The checkout only writes files that differ from the current HEAD, and refuses to overwrite local changes.
+            Tree target = submodule.lookup_commit(state.recorded).tree();
+            git_checkout_options checkoutOpts = GIT_CHECKOUT_OPTIONS_INIT;
+            checkoutOpts.checkout_strategy = GIT_CHECKOUT_SAFE | GIT_CHECKOUT_RECREATE_MISSING;
+            submodule.checkout_tree(target, checkoutOpts);
+            submodule.set_head_detached(state.recorded);
+            vector<string> nested = checkout_submodules(submodule, target);
+            lock_guard<mutex> lock(skippedMutex);
+            skipped.insert(skipped.end(), nested.begin(), nested.end());
+        });
+        sort(skipped.begin(), skipped.end());
+        return skipped;
+    }
+}
@@ -0,0 +1,257 @@
+#include "pch.h"
+
+namespace metro {
+    // The index of the worker the current thread is, or -1 if it isn't one.
+    thread_local int workerIndex = -1;
+    // Whether the current thread is a worker counted against the concurrency limit.
+    thread_local bool holdsPermit = false;
+    atomic<bool> runtimeStarted(false);
+
+    TaskRuntime::TaskRuntime(unsigned int concurrency) :
+            concurrency(concurrency), maxThreads(concurrency + MAX_COMPENSATION_THREADS),
+            // Whichever thread waits for a group runs tasks too, so it makes up the last permit.
+            permits(max(1u, concurrency - 1)) {
+        for (unsigned int i = 0; i < maxThreads; i++) {
+            queues.push_back(make_unique<TaskQueue>());
+        }
+        lock_guard<mutex> lock(stateMutex);
+        for (unsigned int i = 0; i < permits; i++) {
+            spawn_worker();
+        }
+    }
+
+    TaskRuntime::~TaskRuntime() {
+        {
+            lock_guard<mutex> lock(stateMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& t : threads) {
+            t.join();
+        }
+    }
+
+    TaskRuntime& TaskRuntime::instance() {
+        static TaskRuntime runtime(default_parallelism());
+        runtimeStarted = true;
+        return runtime;
+    }
+
+    bool TaskRuntime::started() {
+        return runtimeStarted;
+    }
+
+    bool TaskRuntime::in_worker() {
+        return workerIndex >= 0;
+    }
+
+    // Must be called with stateMutex held.
+    void TaskRuntime::spawn_worker() {
+        size_t index = threads.size();
+        threads.emplace_back([this, index]() {
+            worker_loop(index);
+        });
+        threadCount = threads.size();
+    }
+
+    // Wait until this thread may run tasks, and there is work if needWork is set.
+    // Returns false if the runtime is stopping.
+    bool TaskRuntime::acquire_permit(bool needWork) {
+        unique_lock<mutex> lock(stateMutex);
+        idle++;
+        wake.wait(lock, [&]() {
+            return stopping || (permits > 0 && (!needWork || pending > 0));
+        });
+        idle--;
+        if (stopping) {
+            return false;
+        }
+        permits--;
+        holdsPermit = true;
+        return true;
+    }
+
+    void TaskRuntime::release_permit() {
+        {
+            lock_guard<mutex> lock(stateMutex);
+            permits++;
+            holdsPermit = false;
+        }
+        wake.notify_one();
+    }
+
+    void TaskRuntime::worker_loop(size_t index) {
+        workerIndex = (int) index;
+        while (acquire_permit(true)) {
+            for (function<void()> task; find_task(TaskPriority::Background, task);) {
+                task();
+                executed.fetch_add(1, memory_order_relaxed);
+            }
+            release_permit();
+        }
+    }
+
+    void TaskRuntime::push(TaskQueue& queue, function<void()> task, TaskPriority priority) {
+        size_t depth;
+        {
+            lock_guard<mutex> lock(queue.lock);
+            auto& tasks = queue.tasks[(int) priority];
+            tasks.push_back(move(task));
+            depth = tasks.size();
+        }
+        for (size_t max = maxQueueDepth; depth > max && !maxQueueDepth.compare_exchange_weak(max, depth););
+
+        pending++;
+        // Taking the lock makes sure a worker checking for work either sees the new task or gets woken.
+        {
+            lock_guard<mutex> lock(stateMutex);
+        }
+        wake.notify_one();
+    }
+
+    bool TaskRuntime::pop(TaskQueue& queue, TaskPriority priority, bool newest, function<void()>& out) {
+        lock_guard<mutex> lock(queue.lock);
+        auto& tasks = queue.tasks[(int) priority];
+        if (tasks.empty()) {
+            return false;
+        }
+        if (newest) {
+            out = move(tasks.back());
+            tasks.pop_back();
+        } else {
+            out = move(tasks.front());
+            tasks.pop_front();
+        }
+        pending--;
+        return true;
+    }
+
+    bool TaskRuntime::find_task(TaskPriority maxPriority, function<void()>& out) {
+        for (int p = 0; p <= (int) maxPriority; p++) {
+            auto priority = (TaskPriority) p;
+            if (workerIndex >= 0 && pop(*queues[workerIndex], priority, true, out)) {
+                return true;
+            }
+            if (pop(injected, priority, false, out)) {
+                return true;
+            }
+            // Start looking at the next worker's queue, so that thieves spread out.
+            size_t count = threadCount;
+            size_t start = workerIndex >= 0? workerIndex + 1 : 0;
+            for (size_t i = 0; i < count; i++) {
+                size_t victim = (start + i) % count;
+                if ((int) victim != workerIndex && pop(*queues[victim], priority, false, out)) {
+                    steals.fetch_add(1, memory_order_relaxed);
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void TaskRuntime::submit(function<void()> task, TaskPriority priority) {
+        push(workerIndex >= 0? *queues[workerIndex] : injected, move(task), priority);
+    }
+
+    bool TaskRuntime::run_one(TaskPriority maxPriority) {
+        function<void()> task;
+        if (!find_task(maxPriority, task)) {
+            return false;
+        }
+        task();
+        executed.fetch_add(1, memory_order_relaxed);
+        return true;
+    }
+
+    void TaskRuntime::blocking(const function<void()>& fn) {
+        if (!holdsPermit) {
+            fn();
+            return;
+        }
+
+        TaskRuntime& runtime = instance();
+        {
+            lock_guard<mutex> lock(runtime.stateMutex);
+            runtime.permits++;
+            holdsPermit = false;
+            // If no worker is free to use the permit, start another.
+            if (runtime.idle == 0 && runtime.threads.size() < runtime.maxThreads) {
+                runtime.spawn_worker();
+                runtime.compensations++;
+            }
+        }
+        runtime.wake.notify_one();
+
+        exception_ptr error;
+        try {
+            fn();
+        } catch (...) {
+            error = current_exception();
+        }
+        runtime.acquire_permit(false);
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+
+    TaskRuntimeStats TaskRuntime::stats() {
+        TaskRuntimeStats stats {};
+        stats.threads = threadCount;
+        stats.concurrency = concurrency;
+        stats.executed = executed;
+        stats.steals = steals;
+        stats.compensations = compensations;
+        stats.maxQueueDepth = maxQueueDepth;
+        for (size_t i = 0; i <= stats.threads; i++) {
+            TaskQueue& queue = i < stats.threads? *queues[i] : injected;
+            lock_guard<mutex> lock(queue.lock);
+            stats.queueDepths.push_back(queue.tasks[0].size() + queue.tasks[1].size());
+        }
+        return stats;
+    }
+
+    TaskGroup::~TaskGroup() {
+        try {
+            wait();
+        } catch (...) {}
+    }
+
+    void TaskGroup::run(function<void()> task) {
+        pending++;
+        TaskRuntime::instance().submit([this, task = move(task)]() {
+            try {
+                task();
+            } catch (...) {
+                lock_guard<mutex> lock(doneMutex);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+            // Notify under the lock, so the group can't be destroyed between the count reaching zero and the notify.
+            lock_guard<mutex> lock(doneMutex);
+            if (--pending == 0) {
+                done.notify_all();
+            }
+        }, priority);
+    }
+
+    void TaskGroup::wait() {
+        while (pending > 0) {
+            if (TaskRuntime::instance().run_one(priority)) {
+                continue;
+            }
+            // The remaining tasks are running elsewhere. Check back now and then in case more get queued.
+            unique_lock<mutex> lock(doneMutex);
+            done.wait_for(lock, chrono::milliseconds(1), [&]() {
+                return pending == 0;
+            });
+        }
+
+        lock_guard<mutex> lock(doneMutex);
+        if (error) {
+            exception_ptr thrown = error;
+            error = nullptr;
+            rethrow_exception(thrown);
+        }
+    }
+}
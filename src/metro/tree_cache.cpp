@@ -0,0 +1,267 @@
+#include "pch.h"
+
+#define TREE_CACHE_MAGIC "MTC1"
+// Rough memory used by a cached tree besides its block.
+#define TREE_CACHE_ENTRY_OVERHEAD 96
+
+namespace metro {
+    // The size of a block holding count entries whose names take nameBytes.
+    size_t flat_tree_bytes(size_t count, size_t nameBytes) {
+        return (count + 2) * sizeof(uint32_t) + count * (sizeof(uint16_t) + GIT_OID_RAWSZ) + nameBytes;
+    }
+
+    shared_ptr<const FlatTree> FlatTree::parse(const char *data, size_t size) {
+        struct RawEntry {
+            string_view name;
+            uint16_t mode;
+            const char *id;
+        };
+        vector<RawEntry> raw;
+        size_t nameBytes = 0;
+        // Each entry is its mode in octal, a space, its name, a NUL and its raw ID.
+        for (size_t pos = 0; pos < size;) {
+            uint32_t mode = 0;
+            for (; pos < size && data[pos] >= '0' && data[pos] <= '7'; pos++) {
+                mode = mode * 8 + (data[pos] - '0');
+            }
+            const char *nameEnd = pos < size? static_cast<const char*>(memchr(data + pos, '\0', size - pos)) : nullptr;
+            if (nameEnd == nullptr || nameEnd + 1 + GIT_OID_RAWSZ > data + size || data[pos] != ' '
+                    || mode == 0 || mode > UINT16_MAX) {
+                throw MetroException("Corrupt tree object");
+            }
+            string_view name(data + pos + 1, nameEnd - (data + pos + 1));
+            raw.push_back({name, (uint16_t) mode, nameEnd + 1});
+            nameBytes += name.size();
+            pos = nameEnd + 1 + GIT_OID_RAWSZ - data;
+        }
+        sort(raw.begin(), raw.end(), [](const RawEntry& a, const RawEntry& b) { return a.name < b.name; });
+
+        size_t bytes = flat_tree_bytes(raw.size(), nameBytes);
+        vector<uint32_t> block((bytes + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        block[0] = raw.size();
+        auto *out = reinterpret_cast<char*>(block.data());
+        char *modes = out + (raw.size() + 2) * sizeof(uint32_t);
+        char *ids = modes + raw.size() * sizeof(uint16_t);
+        char *names = ids + raw.size() * GIT_OID_RAWSZ;
+        uint32_t offset = 0;
+        for (size_t i = 0; i < raw.size(); i++) {
+            block[i + 1] = offset;
+            memcpy(modes + i * sizeof(uint16_t), &raw[i].mode, sizeof(uint16_t));
+            memcpy(ids + i * GIT_OID_RAWSZ, raw[i].id, GIT_OID_RAWSZ);
+            memcpy(names + offset, raw[i].name.data(), raw[i].name.size());
+            offset += raw[i].name.size();
+        }
+        block[raw.size() + 1] = offset;
+        return shared_ptr<const FlatTree>(new FlatTree(std::move(block), bytes));
+    }
+
+    shared_ptr<const FlatTree> FlatTree::deserialize(const char *data, size_t size) {
+        uint32_t count;
+        if (size < sizeof(uint32_t)) {
+            return nullptr;
+        }
+        memcpy(&count, data, sizeof(count));
+        if (count > size || flat_tree_bytes(count, 0) > size) {
+            return nullptr;
+        }
+        vector<uint32_t> block((size + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+        memcpy(block.data(), data, size);
+        // The name offsets must run in order to the end of the block.
+        for (size_t i = 0; i < count; i++) {
+            if (block[i + 1] > block[i + 2]) {
+                return nullptr;
+            }
+        }
+        if (block[0] != count || block[1] != 0 || flat_tree_bytes(count, block[count + 1]) != size) {
+            return nullptr;
+        }
+        return shared_ptr<const FlatTree>(new FlatTree(std::move(block), size));
+    }
+
+    size_t FlatTree::find(string_view entryName) const {
+        size_t low = 0, high = size();
+        while (low < high) {
+            size_t middle = low + (high - low) / 2;
+            int order = name(middle).compare(entryName);
+            if (order == 0) {
+                return middle;
+            }
+            if (order < 0) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return SIZE_MAX;
+    }
+
+    TreeCache::TreeCache(const Repository& repo, size_t maxBytes, bool persistent) :
+            odb(repo.odb()), path(persistent? metro_dir(repo) + "/tree-cache" : ""), maxBytes(maxBytes) {
+        if (persistent) {
+            load();
+        }
+    }
+
+    // Read the cached trees from disk. Anything after a corrupt tree is ignored, since it can be parsed again.
+    void TreeCache::load() {
+        ifstream file(path, ios::binary);
+        string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+        if (!has_prefix(data, TREE_CACHE_MAGIC)) {
+            return;
+        }
+        unique_lock<shared_mutex> lock(mutex);
+        size_t pos = strlen(TREE_CACHE_MAGIC);
+        try {
+            while (pos < data.size()) {
+                OID id = read_oid(data, pos);
+                size_t size = read_varint(data, pos);
+                if (size > data.size() - pos) {
+                    break;
+                }
+                shared_ptr<const FlatTree> tree = FlatTree::deserialize(data.data() + pos, size);
+                if (tree == nullptr) {
+                    break;
+                }
+                pos += size;
+                insert(id, tree);
+            }
+        } catch (MetroException&) {}
+        dirty = false;
+    }
+
+    shared_ptr<const FlatTree> TreeCache::insert(const OID& id, shared_ptr<const FlatTree> tree) {
+        auto existing = entries.find(id);
+        if (existing != entries.end()) {
+            // Another thread parsed it first.
+            return existing->second->tree;
+        }
+        size_t size = TREE_CACHE_ENTRY_OVERHEAD + tree->serialized().size();
+        if (size > maxBytes) {
+            return tree;
+        }
+
+        // Sweep the clock hand past recently used trees, evicting the first one that hasn't been used
+        // since the hand last passed it, until the new tree fits.
+        while (bytes + size > maxBytes && !clock.empty()) {
+            hand %= clock.size();
+            auto victim = entries.find(clock[hand]);
+            if (victim->second->referenced.exchange(false, memory_order_relaxed)) {
+                hand++;
+                continue;
+            }
+            bytes -= TREE_CACHE_ENTRY_OVERHEAD + victim->second->tree->serialized().size();
+            entries.erase(victim);
+            clock[hand] = clock.back();
+            clock.pop_back();
+        }
+
+        auto entry = make_unique<Entry>();
+        entry->tree = tree;
+        entry->referenced = false;
+        entries.emplace(id, std::move(entry));
+        clock.push_back(id);
+        bytes += size;
+        dirty = true;
+        return tree;
+    }
+
+    shared_ptr<const FlatTree> TreeCache::tree(const OID& id) {
+        {
+            shared_lock<shared_mutex> lock(mutex);
+            auto entry = entries.find(id);
+            if (entry != entries.end()) {
+                entry->second->referenced.store(true, memory_order_relaxed);
+                hits.fetch_add(1, memory_order_relaxed);
+                return entry->second->tree;
+            }
+        }
+        misses.fetch_add(1, memory_order_relaxed);
+
+        OdbObject object = odb.read(id);
+        if (object.type() != GIT_OBJECT_TREE) {
+            throw MetroException("Object " + id.str() + " is not a tree");
+        }
+        shared_ptr<const FlatTree> tree = FlatTree::parse(object.data(), object.size());
+        unique_lock<shared_mutex> lock(mutex);
+        return insert(id, tree);
+    }
+
+    bool TreeCache::find_path(const OID& root, string_view entryPath, FlatTreeEntry& out) {
+        OID current = root;
+        while (true) {
+            size_t slash = entryPath.find('/');
+            shared_ptr<const FlatTree> flat = tree(current);
+            size_t n = flat->find(entryPath.substr(0, slash));
+            if (n == SIZE_MAX) {
+                return false;
+            }
+            if (slash == string_view::npos) {
+                out = flat->entry(n);
+                return true;
+            }
+            if (flat->mode(n) != GIT_FILEMODE_TREE) {
+                return false;
+            }
+            current = OID(flat->id(n));
+            entryPath = entryPath.substr(slash + 1);
+        }
+    }
+
+    void TreeCache::changed_files(const OID& from, const OID& to,
+                                  const function<void(const string&, const FlatTreeEntry&)>& fn) {
+        changed_files(&from, to, "", fn);
+    }
+
+    void TreeCache::changed_files(const OID *from, const OID& to, const string& prefix,
+                                  const function<void(const string&, const FlatTreeEntry&)>& fn) {
+        shared_ptr<const FlatTree> newTree = tree(to);
+        shared_ptr<const FlatTree> oldTree = from == nullptr? nullptr : tree(*from);
+        size_t oldSize = oldTree == nullptr? 0 : oldTree->size();
+        // Both trees are sorted by name, so the old entry with each new entry's name is found by walking along.
+        size_t j = 0;
+        for (size_t i = 0; i < newTree->size(); i++) {
+            FlatTreeEntry entry = newTree->entry(i);
+            while (j < oldSize && oldTree->name(j) < entry.name) {
+                j++;
+            }
+            bool hasOld = j < oldSize && oldTree->name(j) == entry.name;
+            if (hasOld && oldTree->mode(j) == entry.mode && OID(oldTree->id(j)) == entry.id) {
+                continue;
+            }
+
+            string path = prefix + string(entry.name);
+            if (entry.mode != GIT_FILEMODE_TREE) {
+                fn(path, entry);
+            } else if (hasOld && oldTree->mode(j) == GIT_FILEMODE_TREE) {
+                OID oldId(oldTree->id(j));
+                changed_files(&oldId, entry.id, path + "/", fn);
+            } else {
+                changed_files(nullptr, entry.id, path + "/", fn);
+            }
+        }
+    }
+
+    void TreeCache::save() {
+        if (path.empty()) {
+            return;
+        }
+        unique_lock<shared_mutex> lock(mutex);
+        if (!dirty) {
+            return;
+        }
+        string data = TREE_CACHE_MAGIC;
+        for (const auto& [id, entry] : entries) {
+            data.append(reinterpret_cast<const char*>(id.oid.id), GIT_OID_RAWSZ);
+            string_view block = entry->tree->serialized();
+            append_varint(data, block.size());
+            data.append(block.data(), block.size());
+        }
+        write_all_atomic(data, path);
+        dirty = false;
+    }
+
+    TreeCacheStats TreeCache::stats() const {
+        shared_lock<shared_mutex> lock(mutex);
+        return {hits.load(memory_order_relaxed), misses.load(memory_order_relaxed), entries.size(), bytes};
+    }
+}
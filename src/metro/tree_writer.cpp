@@ -0,0 +1,166 @@
+#include "pch.h"
+
+// Directories with fewer entries than this under them are built by the task building their parent,
+// since a task of their own would cost more than it saves.
+#define TREE_WRITER_TASK_ENTRIES 512
+// How many tree objects each task writes to the object database.
+#define TREE_WRITER_WRITE_CHUNK 256
+
+namespace metro {
+    // An entry of a single tree object.
+    struct TreeObjectEntry {
+        string name;
+        uint32_t mode;
+        OID id;
+    };
+
+    // Git orders tree entries by name, comparing directories as if their names ended in '/'.
+    bool tree_object_entry_before(const TreeObjectEntry& a, const TreeObjectEntry& b) {
+        size_t common = min(a.name.size(), b.name.size());
+        int cmp = memcmp(a.name.data(), b.name.data(), common);
+        if (cmp != 0) {
+            return cmp < 0;
+        }
+        unsigned char aNext = a.name.size() > common? a.name[common] : a.mode == GIT_FILEMODE_TREE? '/' : '\0';
+        unsigned char bNext = b.name.size() > common? b.name[common] : b.mode == GIT_FILEMODE_TREE? '/' : '\0';
+        return aNext < bNext;
+    }
+
+    // Serialize the entries as the contents of a tree object: "<octal mode> <name>\0<raw id>" for each.
+    string serialize_tree(vector<TreeObjectEntry>& entries) {
+        sort(entries.begin(), entries.end(), tree_object_entry_before);
+        string data;
+        char mode[16];
+        for (const TreeObjectEntry& entry : entries) {
+            snprintf(mode, sizeof(mode), "%o ", entry.mode);
+            data += mode;
+            data += entry.name;
+            data.push_back('\0');
+            data.append(reinterpret_cast<const char*>(entry.id.oid.id), GIT_OID_RAWSZ);
+        }
+        return data;
+    }
+
+    // The tree objects made by build_tree, kept until every tree is built and then written together.
+    // Trees that are already in the object database, usually most of them, aren't written again.
+    class TreeObjectBatch {
+    private:
+        mutex lock;
+        vector<pair<OID, string>> objects;
+        uint64_t totalBytes = 0;
+
+    public:
+        void add(const OID& id, string data) {
+            lock_guard<mutex> guard(lock);
+            totalBytes += data.size();
+            objects.emplace_back(id, std::move(data));
+        }
+
+        size_t size() const {
+            return objects.size();
+        }
+
+        uint64_t bytes() const {
+            return totalBytes;
+        }
+
+        void write(const ODB& odb) {
+            TaskGroup group;
+            for (size_t start = 0; start < objects.size(); start += TREE_WRITER_WRITE_CHUNK) {
+                size_t end = min(start + TREE_WRITER_WRITE_CHUNK, objects.size());
+                group.run([this, &odb, start, end]() {
+                    for (size_t i = start; i < end; i++) {
+                        if (!odb.exists(objects[i].first)) {
+                            odb.write(objects[i].second.data(), objects[i].second.size(), GIT_OBJECT_TREE);
+                        }
+                    }
+                });
+            }
+            group.wait();
+        }
+    };
+
+    // Build the tree of entries[begin...end), which all start with the same directory prefix of prefixLength,
+    // adding the tree objects to batch unless it is null. Big subdirectories are built in parallel.
+    OID build_subtree(const vector<TreeWriterEntry>& entries, size_t begin, size_t end, size_t prefixLength,
+                      TreeObjectBatch *batch) {
+        // Find the children first, so that the subtree tasks fill in a list that no longer moves.
+        vector<TreeObjectEntry> children;
+        vector<pair<size_t, size_t>> ranges;
+        for (size_t i = begin; i < end;) {
+            const string& path = entries[i].path;
+            size_t slash = path.find('/', prefixLength);
+            if (slash == string::npos) {
+                children.push_back({path.substr(prefixLength), entries[i].mode, entries[i].id});
+                ranges.emplace_back(i, i);
+                i++;
+                continue;
+            }
+
+            // Entries are sorted by path, so everything in the same directory is next to each other.
+            size_t dirEnd = i + 1;
+            while (dirEnd < end && entries[dirEnd].path.compare(0, slash + 1, path, 0, slash + 1) == 0) {
+                dirEnd++;
+            }
+            children.push_back({path.substr(prefixLength, slash - prefixLength), GIT_FILEMODE_TREE, OID()});
+            ranges.emplace_back(i, dirEnd);
+            i = dirEnd;
+        }
+
+        TaskGroup group;
+        for (size_t n = 0; n < children.size(); n++) {
+            auto [subBegin, subEnd] = ranges[n];
+            if (subBegin == subEnd) {
+                continue;
+            }
+            size_t subPrefix = prefixLength + children[n].name.size() + 1;
+            if (subEnd - subBegin < TREE_WRITER_TASK_ENTRIES) {
+                children[n].id = build_subtree(entries, subBegin, subEnd, subPrefix, batch);
+                continue;
+            }
+            group.run([&entries, &children, batch, n, subBegin = subBegin, subEnd = subEnd, subPrefix]() {
+                children[n].id = build_subtree(entries, subBegin, subEnd, subPrefix, batch);
+            });
+        }
+        group.wait();
+
+        string data = serialize_tree(children);
+        OID id = ODB::hash(data.data(), data.size(), GIT_OBJECT_TREE);
+        if (batch != nullptr) {
+            batch->add(id, std::move(data));
+        }
+        return id;
+    }
+
+    OID build_tree(const Repository& repo, vector<TreeWriterEntry> entries, bool write) {
+        sort(entries.begin(), entries.end(), [](const TreeWriterEntry& a, const TreeWriterEntry& b) {
+            return a.path < b.path;
+        });
+        METRO_PHASE_PROBE(phase, "write_tree", write? "write" : "hash");
+        TreeObjectBatch batch;
+        OID root = build_subtree(entries, 0, entries.size(), 0, write? &batch : nullptr);
+        if (write) {
+            batch.write(repo.odb());
+            METRO_PHASE_ADD_ITEMS(phase, batch.size(), batch.bytes());
+        }
+        return root;
+    }
+
+    OID write_index_tree(const Repository& repo, Index& index) {
+        // Conflicts can't be written as a tree, so leave the index to report them.
+        if (index.has_conflicts()) {
+            return index.write_tree();
+        }
+        vector<TreeWriterEntry> entries;
+        entries.reserve(index.entrycount());
+        for (size_t i = 0; i < index.entrycount(); i++) {
+            const git_index_entry *entry = index.get_byindex(i);
+            // Like libgit2, leave out files only marked as to be added.
+            if ((entry->flags_extended & GIT_INDEX_ENTRY_INTENT_TO_ADD) != 0) {
+                continue;
+            }
+            entries.push_back({entry->path, entry->mode, OID(entry->id)});
+        }
+        return build_tree(repo, std::move(entries));
+    }
+}
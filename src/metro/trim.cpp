@@ -0,0 +1,336 @@
+#include "pch.h"
+
+namespace metro {
+    string shallow_path(const Repository& repo) {
+        return repo.path() + "shallow";
+    }
+
+    set<OID> shallow_commits(const Repository& repo) {
+        set<OID> commits;
+        if (!filesystem::exists(shallow_path(repo))) {
+            return commits;
+        }
+        stringstream lines(read_all(shallow_path(repo)));
+        for (string line; getline(lines, line);) {
+            OID id;
+            if (git_oid_fromstr(&id.oid, line.c_str()) == 0) {
+                commits.insert(id);
+            }
+        }
+        return commits;
+    }
+
+    // The total size of the files in a directory and its subdirectories.
+    uintmax_t directory_size(const string& path) {
+        uintmax_t size = 0;
+        for (const auto& entry : filesystem::recursive_directory_iterator(path)) {
+            error_code err;
+            if (entry.is_regular_file(err)) {
+                size += entry.file_size(err);
+            }
+        }
+        return size;
+    }
+
+    // Follow a ref's target through any annotated tags, adding the tags to tags and the object they lead to
+    // to commits if it is a commit, or to others if it isn't.
+    void add_ref_target(const ODB& odb, OID id, vector<OID>& commits, vector<OID>& tags, vector<OID>& others) {
+        while (odb.exists(id)) {
+            OdbObject object = odb.read(id);
+            if (object.type() == GIT_OBJECT_COMMIT) {
+                commits.push_back(id);
+                return;
+            }
+            // A tag object starts with "object <id>".
+            string data(object.data(), object.size());
+            OID target;
+            if (object.type() != GIT_OBJECT_TAG || !has_prefix(data, "object ")
+                    || git_oid_fromstrn(&target.oid, data.c_str() + 7, GIT_OID_HEXSZ) != 0) {
+                others.push_back(id);
+                return;
+            }
+            tags.push_back(id);
+            id = target;
+        }
+    }
+
+    // Add the commits a worktree's HEAD and in-progress operations are at, and the blobs in its index.
+    void add_worktree_roots(const Repository& worktree, const ODB& odb, ObjectRoots& roots) {
+        for (const char *rev : {"HEAD", "MERGE_HEAD", "ORIG_HEAD"}) {
+            if (commit_exists(worktree, rev)) {
+                roots.commits.push_back(get_commit(worktree, rev).id());
+            }
+        }
+        Index index = worktree.index();
+        for (size_t i = 0; i < index.entrycount(); i++) {
+            const git_index_entry *entry = index.get_byindex(i);
+            if (entry->mode != GIT_FILEMODE_COMMIT && odb.exists(OID(entry->id))) {
+                roots.staged.emplace_back(OID(entry->id), entry->path);
+            }
+        }
+    }
+
+    ObjectRoots object_roots(const Repository& repo, const ODB& odb) {
+        ObjectRoots roots;
+        for (const OID& target : repo.reference_targets()) {
+            add_ref_target(odb, target, roots.commits, roots.tags, roots.others);
+        }
+        add_worktree_roots(repo, odb, roots);
+        // Linked worktrees, such as the pooled bisect worktrees, have HEADs and indexes of their own.
+        for (const Repository& worktree : repo.worktrees()) {
+            add_worktree_roots(worktree, odb, roots);
+        }
+        return roots;
+    }
+
+    // The IDs a reflog entry names. Each line starts with the old and new IDs of the ref,
+    // which are all zeros when the ref didn't exist; those are left out.
+    vector<OID> reflog_line_ids(const string& line) {
+        vector<OID> ids;
+        for (size_t start : {(size_t) 0, (size_t) GIT_OID_HEXSZ + 1}) {
+            OID id;
+            if (line.size() >= start + GIT_OID_HEXSZ
+                    && git_oid_fromstrn(&id.oid, line.c_str() + start, GIT_OID_HEXSZ) == 0
+                    && !git_oid_is_zero(&id.oid)) {
+                ids.push_back(id);
+            }
+        }
+        return ids;
+    }
+
+    // Add the commits one reflog lists that are in the ODB, if the reflog exists.
+    void add_reflog_commits(const string& path, const ODB& odb, vector<OID>& commits) {
+        if (!filesystem::exists(path)) {
+            return;
+        }
+        stringstream lines(read_all(path));
+        for (string line; getline(lines, line);) {
+            for (const OID& id : reflog_line_ids(line)) {
+                if (odb.exists(id)) {
+                    commits.push_back(id);
+                }
+            }
+        }
+    }
+
+    vector<OID> reflog_commits(const Repository& repo, const ODB& odb) {
+        vector<OID> commits;
+        string logsDir = repo.path() + "logs";
+        if (!filesystem::exists(logsDir)) {
+            return commits;
+        }
+        for (const auto& entry : filesystem::recursive_directory_iterator(logsDir)) {
+            if (entry.is_regular_file()) {
+                add_reflog_commits(entry.path().string(), odb, commits);
+            }
+        }
+        return commits;
+    }
+
+    // Drop the reflog entries that name objects not in kept, so that every entry left can still be read.
+    void cut_reflogs(const Repository& repo, const set<OID>& kept) {
+        string logsDir = repo.path() + "logs";
+        if (!filesystem::exists(logsDir)) {
+            return;
+        }
+        for (const auto& entry : filesystem::recursive_directory_iterator(logsDir)) {
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            string text = read_all(entry.path().string());
+            string cut;
+            stringstream lines(text);
+            for (string line; getline(lines, line);) {
+                vector<OID> ids = reflog_line_ids(line);
+                if (all_of(ids.begin(), ids.end(), [&](const OID& id) { return kept.count(id) > 0; })) {
+                    cut += line + "\n";
+                }
+            }
+            if (cut != text) {
+                write_all_atomic(cut, entry.path().string());
+            }
+        }
+    }
+
+    vector<filesystem::path> replaceable_object_files(const string& objectsDir) {
+        vector<filesystem::path> files;
+        for (const auto& entry : filesystem::directory_iterator(objectsDir)) {
+            string name = entry.path().filename().string();
+            if (name.size() == 2 && isxdigit((unsigned char) name[0]) && isxdigit((unsigned char) name[1])) {
+                files.push_back(entry.path());
+            }
+        }
+        for (const auto& entry : filesystem::directory_iterator(objectsDir + "/pack")) {
+            filesystem::path keep = entry.path();
+            keep.replace_extension(".keep");
+            if (!filesystem::exists(keep)) {
+                files.push_back(entry.path());
+            }
+        }
+        return files;
+    }
+
+    // The IDs of the objects in a pack, read from its version 2 index: a header, a 256 entry fanout table
+    // whose last entry is the object count, then the sorted IDs.
+    set<OID> pack_index_ids(const string& idxPath) {
+        string data = read_all(idxPath);
+        size_t idsStart = 8 + 256 * 4;
+        if (data.size() < idsStart || data.compare(0, 4, "\377tOc") != 0) {
+            throw MetroException("Unreadable pack index " + idxPath);
+        }
+        const auto *bytes = reinterpret_cast<const unsigned char*>(data.data());
+        size_t count = (size_t) bytes[idsStart - 4] << 24 | (size_t) bytes[idsStart - 3] << 16
+                       | (size_t) bytes[idsStart - 2] << 8 | bytes[idsStart - 1];
+        if (data.size() < idsStart + count * GIT_OID_RAWSZ) {
+            throw MetroException("Truncated pack index " + idxPath);
+        }
+        set<OID> ids;
+        for (size_t i = 0; i < count; i++) {
+            git_oid id;
+            git_oid_fromraw(&id, bytes + idsStart + i * GIT_OID_RAWSZ);
+            ids.insert(OID(id));
+        }
+        return ids;
+    }
+
+    void remove_replaced_objects(const vector<filesystem::path>& files, const string& packDir, const string& newPack) {
+        set<OID> packed = pack_index_ids(packDir + "/" + newPack + ".idx");
+        auto cutoff = filesystem::file_time_type::clock::now() - chrono::seconds(LOOSE_OBJECT_GRACE_SECONDS);
+        for (const filesystem::path& path : files) {
+            if (path.stem().string() == newPack) {
+                continue;
+            }
+            if (path.parent_path().filename() == "pack") {
+                filesystem::remove(path);
+                continue;
+            }
+
+            // A loose object directory: its files are named by the rest of each object's hex ID.
+            string prefix = path.filename().string();
+            for (const auto& entry : filesystem::directory_iterator(path)) {
+                OID id;
+                string hex = prefix + entry.path().filename().string();
+                bool isPacked = hex.size() == GIT_OID_HEXSZ && git_oid_fromstrn(&id.oid, hex.c_str(), GIT_OID_HEXSZ) == 0
+                                && packed.count(id) > 0;
+                error_code err;
+                if (isPacked || entry.last_write_time(err) < cutoff) {
+                    filesystem::remove(entry.path(), err);
+                }
+            }
+            error_code err;
+            if (filesystem::is_empty(path, err)) {
+                filesystem::remove(path, err);
+            }
+        }
+    }
+
+    TrimStats trim_history(const Repository& repo, const TrimLimit& limit) {
+#if LIBGIT2_VER_MAJOR < 1 || (LIBGIT2_VER_MAJOR == 1 && LIBGIT2_VER_MINOR < 7)
+        throw UnsupportedOperationException("Trimming history needs libgit2 1.7 or newer, which understands shallow repos.");
+#else
+        METRO_OPERATION_PROBE("");
+        AccessPatternScope pattern(repo, AccessPattern::Sequential);
+        attach_shared_store(repo);
+        ODB odb = repo.odb();
+        string objectsDir = repo.path() + "objects";
+        uintmax_t bytesBefore = directory_size(objectsDir);
+
+        // Every ref, worktree and in-progress operation keeps its commit, and annotated tags keep their tag objects.
+        ObjectRoots roots = object_roots(repo, odb);
+        vector<OID> tips = roots.commits;
+        // Older stashes are only in the stash reflog. Applying a stash needs the commits it was made on too,
+        // so each stash keeps its parents.
+        vector<OID> stashes;
+        add_reflog_commits(repo.path() + "logs/refs/stash", odb, stashes);
+        for (const OID& stash : stashes) {
+            tips.push_back(stash);
+            Commit commit = repo.lookup_commit(stash);
+            for (unsigned int i = 0; i < commit.parentcount(); i++) {
+                if (odb.exists(commit.parent_id(i))) {
+                    tips.push_back(commit.parent_id(i));
+                }
+            }
+        }
+
+        // Walk breadth first, so each commit is first reached by its shortest path from a ref.
+        set<OID> shallow = shallow_commits(repo);
+        set<OID> kept;
+        deque<pair<OID, size_t>> queue;
+        for (const OID& tip : tips) {
+            if (kept.insert(tip).second) {
+                queue.emplace_back(tip, 0);
+            }
+        }
+        while (!queue.empty()) {
+            auto [id, depth] = queue.front();
+            queue.pop_front();
+            if (shallow.count(id) > 0 || (limit.count > 0 && depth + 1 >= limit.count)) {
+                continue;
+            }
+            Commit commit = repo.lookup_commit(id);
+            for (unsigned int i = 0; i < commit.parentcount(); i++) {
+                OID parent = commit.parent_id(i);
+                if (kept.count(parent) > 0) {
+                    continue;
+                }
+                if (limit.count == 0 && repo.lookup_commit(parent).time() < limit.since) {
+                    continue;
+                }
+                kept.insert(parent);
+                queue.emplace_back(parent, depth + 1);
+            }
+        }
+
+        // The commits whose parents are being cut off, or already were.
+        set<OID> boundary;
+        PackBuilder builder = repo.new_packbuilder();
+        for (const OID& id : kept) {
+            Commit commit = repo.lookup_commit(id);
+            if (shallow.count(id) > 0) {
+                boundary.insert(id);
+            }
+            for (unsigned int i = 0; i < commit.parentcount(); i++) {
+                if (kept.count(commit.parent_id(i)) == 0) {
+                    boundary.insert(id);
+                }
+            }
+            builder.insert_commit(id);
+        }
+        for (const OID& tag : roots.tags) {
+            builder.insert(tag);
+        }
+        for (const OID& other : roots.others) {
+            builder.insert_recursive(other);
+        }
+        for (const auto& [id, path] : roots.staged) {
+            builder.insert(id);
+        }
+
+        // Git reads .git/shallow to know not to look for the cut parents, so write it before removing them.
+        string shallowText;
+        for (const OID& id : boundary) {
+            shallowText += id.str() + "\n";
+        }
+        write_all_atomic(shallowText, shallow_path(repo));
+
+        // Reflogs that reach back past the cut lose their older entries. Refs can point to tags and other objects,
+        // so those count as kept too.
+        set<OID> keptObjects = kept;
+        keptObjects.insert(roots.tags.begin(), roots.tags.end());
+        keptObjects.insert(roots.others.begin(), roots.others.end());
+        cut_reflogs(repo, keptObjects);
+
+        string packDir = objectsDir + "/pack";
+        vector<filesystem::path> oldFiles = replaceable_object_files(objectsDir);
+        builder.write(packDir);
+        remove_replaced_objects(oldFiles, packDir, "pack-" + builder.name());
+
+        filesystem::remove(metro_dir(repo) + "/commit-index");
+        filesystem::remove(metro_dir(repo) + "/commit-index.journal");
+        // Cached merge bases and analyses may name the cut commits.
+        clear_query_cache(repo);
+
+        return {kept.size(), boundary.size(), bytesBefore, directory_size(objectsDir)};
+#endif
+    }
+}
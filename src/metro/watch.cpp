@@ -0,0 +1,224 @@
+#include "pch.h"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE)
+
+namespace metro {
+    string event_type_name(RepoEventType type) {
+        switch (type) {
+            case RepoEventType::BranchChanged: return "branch-changed";
+            case RepoEventType::CommitCreated: return "commit-created";
+            case RepoEventType::MergeStarted: return "merge-started";
+            case RepoEventType::MergeResolved: return "merge-resolved";
+            case RepoEventType::PathsDirtied: return "paths-dirtied";
+            case RepoEventType::Rescan: return "rescan";
+        }
+        return "unknown";
+    }
+
+    // The parts of the repo state that events are reported for.
+    struct WatchedState {
+        string branch;
+        string head;
+        string mergeHead;
+
+        explicit WatchedState(const Repository& repo) {
+            try {
+                branch = current_branch_name(repo);
+            } catch (BranchNotFoundException&) {}
+            if (commit_exists(repo, "HEAD")) {
+                head = get_commit(repo, "HEAD").id().str();
+            }
+            if (merge_ongoing(repo)) {
+                mergeHead = merge_head_id(repo);
+            }
+        }
+    };
+
+    // Work out which events took the repo from one state to the other.
+    vector<RepoEvent> state_events(const WatchedState& before, const WatchedState& after) {
+        vector<RepoEvent> events;
+        if (after.branch != before.branch) {
+            events.push_back({RepoEventType::BranchChanged, after.branch, {}});
+        } else if (after.head != before.head) {
+            events.push_back({RepoEventType::CommitCreated, after.head, {}});
+        }
+
+        if (before.mergeHead.empty() && !after.mergeHead.empty()) {
+            events.push_back({RepoEventType::MergeStarted, after.mergeHead, {}});
+        } else if (!before.mergeHead.empty() && after.mergeHead.empty()) {
+            events.push_back({RepoEventType::MergeResolved, "", {}});
+        }
+        return events;
+    }
+
+#ifdef __linux__
+    class Watcher {
+    private:
+        const Repository& repo;
+        int fd;
+        // Directory of each watch descriptor, relative to the working directory
+        // for the working directory watches or to the .git directory for the others.
+        map<int, string> workdirWatches;
+        map<int, string> gitWatches;
+
+    public:
+        bool gitChanged = false;
+        set<string> dirtied;
+        // The event queue overflowed, so dirtied is incomplete.
+        bool overflowed = false;
+
+        explicit Watcher(const Repository& repo) : repo(repo) {
+            fd = inotify_init1(IN_CLOEXEC);
+            if (fd < 0) {
+                throw MetroException("Failed to start watching: " + string(strerror(errno)));
+            }
+            add_git_dir("");
+            add_git_dir("refs/heads/");
+            add_workdir("");
+        }
+
+        ~Watcher() {
+            close(fd);
+        }
+
+        // Watch a directory in .git, along with any subdirectories if it is within refs.
+        void add_git_dir(const string& relative) {
+            int wd = inotify_add_watch(fd, (repo.path() + relative).c_str(), WATCH_MASK);
+            if (wd < 0) {
+                return;
+            }
+            gitWatches[wd] = relative;
+            if (has_prefix(relative, "refs/")) {
+                for (const auto& entry : filesystem::directory_iterator(repo.path() + relative)) {
+                    if (entry.is_directory()) {
+                        add_git_dir(relative + entry.path().filename().string() + "/");
+                    }
+                }
+            }
+        }
+
+        // Watch a working directory directory and all its subdirectories, except for ignored ones and .git.
+        void add_workdir(const string& relative) {
+            int wd = inotify_add_watch(fd, (repo.workdir() + relative).c_str(), WATCH_MASK);
+            if (wd < 0) {
+                return;
+            }
+            workdirWatches[wd] = relative;
+
+            error_code ignored;
+            for (const auto& entry : filesystem::directory_iterator(repo.workdir() + relative, ignored)) {
+                string name = entry.path().filename().string();
+                if (entry.is_directory() && !entry.is_symlink() && name != ".git"
+                        && !repo.is_ignored(relative + name + "/")) {
+                    add_workdir(relative + name + "/");
+                }
+            }
+        }
+
+        // Recover from dropped events. Directories created meanwhile went unseen, so the watches are added again;
+        // adding a watch that already exists just returns it.
+        void overflow() {
+            overflowed = true;
+            gitChanged = true;
+            add_git_dir("refs/heads/");
+            add_workdir("");
+        }
+
+        // Wait up to timeoutMillis for filesystem events, or forever if negative, and record what they changed.
+        // Returns false if the timeout expired before any events arrived.
+        bool read_events(int timeoutMillis) {
+            pollfd pfd = {fd, POLLIN, 0};
+            int ready = poll(&pfd, 1, timeoutMillis);
+            if (ready < 0 && errno != EINTR) {
+                throw MetroException("Failed to watch for events: " + string(strerror(errno)));
+            }
+            if (ready <= 0) {
+                return false;
+            }
+
+            alignas(inotify_event) char buffer[64 * 1024];
+            ssize_t length = read(fd, buffer, sizeof(buffer));
+            for (ssize_t offset = 0; offset < length;) {
+                auto event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow();
+                    continue;
+                }
+                string name = event->len > 0? string(event->name) : "";
+
+                auto git = gitWatches.find(event->wd);
+                if (git != gitWatches.end()) {
+                    // Lock files are renamed into place once written, which triggers an event of its own.
+                    if (!has_suffix(name, ".lock")) {
+                        gitChanged = true;
+                    }
+                    if ((event->mask & IN_ISDIR) && (event->mask & IN_CREATE) && has_prefix(git->second, "refs/")) {
+                        add_git_dir(git->second + name + "/");
+                    }
+                    continue;
+                }
+
+                auto workdir = workdirWatches.find(event->wd);
+                if (workdir == workdirWatches.end() || name == ".git") {
+                    continue;
+                }
+                string path = workdir->second + name;
+                bool isDir = (event->mask & IN_ISDIR) != 0;
+                if (repo.is_ignored(isDir? path + "/" : path)) {
+                    continue;
+                }
+                if (isDir && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+                    add_workdir(path + "/");
+                }
+                dirtied.insert(path);
+            }
+            return true;
+        }
+    };
+
+    void watch_events(const Repository& repo, const function<bool(const RepoEvent&)>& callback, int coalesceMillis) {
+        Watcher watcher(repo);
+        WatchedState state(repo);
+
+        while (true) {
+            watcher.read_events(-1);
+            // Keep collecting until the burst of changes dies down.
+            while (watcher.read_events(coalesceMillis));
+
+            vector<RepoEvent> events;
+            if (watcher.gitChanged) {
+                WatchedState newState(repo);
+                events = state_events(state, newState);
+                state = newState;
+                watcher.gitChanged = false;
+            }
+            if (watcher.overflowed) {
+                events.push_back({RepoEventType::Rescan, "", {}});
+                watcher.overflowed = false;
+                watcher.dirtied.clear();
+            } else if (!watcher.dirtied.empty()) {
+                vector<string> paths(watcher.dirtied.begin(), watcher.dirtied.end());
+                events.push_back({RepoEventType::PathsDirtied, "", paths});
+                watcher.dirtied.clear();
+            }
+
+            for (const RepoEvent& event : events) {
+                if (!callback(event)) {
+                    return;
+                }
+            }
+        }
+    }
+#else
+    void watch_events(const Repository& repo, const function<bool(const RepoEvent&)>& callback, int coalesceMillis) {
+        throw UnsupportedOperationException("Watching for events is only supported on Linux.");
+    }
+#endif
+}
@@ -2,6 +2,9 @@
 
 #include "helper.cpp"
 #include "error.cpp"
+#include "json.cpp"
+#include "http.cpp"
+#include "digest.cpp"
 
 #include "gitwrapper/index.cpp"
 #include "gitwrapper/branch.cpp"
@@ -9,9 +12,41 @@
 #include "gitwrapper/repository.cpp"
 #include "gitwrapper/commit.cpp"
 #include "gitwrapper/conflict_iterator.cpp"
+#include "gitwrapper/tree.cpp"
+#include "gitwrapper/blob.cpp"
+#include "gitwrapper/blob_view.cpp"
+#include "gitwrapper/merge_file_result.cpp"
+#include "gitwrapper/blob_writer.cpp"
+#include "gitwrapper/odb.cpp"
+#include "gitwrapper/revwalk.cpp"
+#include "gitwrapper/pack_builder.cpp"
+#include "gitwrapper/indexer.cpp"
+#include "gitwrapper/config.cpp"
 
+#include "metro/task_runtime.cpp"
+#include "metro/access_pattern.cpp"
 #include "metro/metro.cpp"
 #include "metro/merging.cpp"
+#include "metro/cache.cpp"
+#include "metro/object_cache.cpp"
+#include "metro/memory_commit.cpp"
+#include "metro/watch.cpp"
+#include "metro/shared_store.cpp"
+#include "metro/submodules.cpp"
+#include "metro/prewarm.cpp"
+#include "metro/perf.cpp"
+#include "metro/bisect.cpp"
+#include "metro/tree_writer.cpp"
+#include "metro/stat_cache.cpp"
+#include "metro/indexless.cpp"
+#include "metro/commit_index.cpp"
+#include "metro/tree_cache.cpp"
+#include "metro/churn.cpp"
+#include "metro/lfs.cpp"
+#include "metro/trim.cpp"
+#include "metro/delta.cpp"
+#include "metro/pack_writer.cpp"
+#include "metro/conflict_matrix.cpp"
 
 #include "commands/create.cpp"
 #include "commands/commit.cpp"
@@ -22,3 +57,16 @@
 #include "commands/info.cpp"
 #include "commands/absorb.cpp"
 #include "commands/resolve.cpp"
+#include "commands/import.cpp"
+#include "commands/watch_events.cpp"
+#include "commands/share.cpp"
+#include "commands/prewarm.cpp"
+#include "commands/perf.cpp"
+#include "commands/bisect.cpp"
+#include "commands/index.cpp"
+#include "commands/log.cpp"
+#include "commands/stats.cpp"
+#include "commands/lfs.cpp"
+#include "commands/trim.cpp"
+#include "commands/repack.cpp"
+#include "commands/conflicts.cpp"
@@ -0,0 +1,106 @@
+#!/usr/bin/env bash
+# Check Metro's LFS support end to end against the stand-in server in lfs_server.py.
+# For each way the server can behave, commit a large file in one repo and push it, then fetch it into a clone,
+# and switch the clone to a branch whose large file it hasn't downloaded yet.
+# Needs git and python3. Run it with the path to a metro binary:
+#   tools/lfs/check_lfs.sh build/metro
+
+set -eu
+
+METRO=$(realpath "${1:-./metro}")
+HERE=$(dirname "$(realpath "$0")")
+WORK=$(mktemp -d)
+SERVER=
+
+cleanup() {
+    if [ -n "$SERVER" ]; then
+        kill "$SERVER" 2>/dev/null || true
+    fi
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+fail() {
+    echo "FAIL ($CASE): $*" >&2
+    exit 1
+}
+
+# Start the server with the given options and wait for it to say which port it is on.
+start_server() {
+    rm -f "$WORK/port"
+    python3 "$HERE/lfs_server.py" --dir "$WORK/$CASE/server" --port-file "$WORK/port" "$@" &
+    SERVER=$!
+    for _ in $(seq 50); do
+        [ -f "$WORK/port" ] && break
+        sleep 0.1
+    done
+    [ -f "$WORK/port" ] || fail "the server didn't start"
+    PORT=$(cat "$WORK/port")
+}
+
+stop_server() {
+    kill "$SERVER"
+    wait "$SERVER" 2>/dev/null || true
+    SERVER=
+}
+
+# Run a metro command and check that its output includes the expected text.
+expect() {
+    local text=$1
+    shift
+    local output
+    output=$("$METRO" "$@" 2>&1) || fail "metro $* failed: $output"
+    case "$output" in
+        *"$text"*) ;;
+        *) fail "metro $* printed '$output', expected '$text'" ;;
+    esac
+}
+
+check_case() {
+    CASE=$1
+    local credentials=$2
+    shift 2
+    start_server "$@"
+    # A non-default port, so the Host header has to name it.
+    local url="http://${credentials}127.0.0.1:$PORT"
+
+    local a="$WORK/$CASE/a" b="$WORK/$CASE/b"
+    mkdir -p "$a"
+    cd "$a"
+    "$METRO" create >/dev/null
+    git config lfs.url "$url"
+    echo "*.bin filter=lfs" > .gitattributes
+    head -c 3000000 /dev/urandom > big.bin
+    expect "Saved commit" commit "Add a large file"
+    git cat-file -p HEAD:big.bin | grep -q "^version https://git-lfs.github.com/spec/v1" \
+        || fail "big.bin wasn't committed as a pointer"
+    expect "Uploaded 1 large files" lfs push
+    [ -f "$WORK/$CASE/server/$(sha256sum big.bin | cut -d' ' -f1)" ] || fail "the server didn't get big.bin"
+    expect "Uploaded 0 large files" lfs push
+
+    git clone -q "$a" "$b"
+    cd "$b"
+    git config lfs.url "$url"
+    expect "Downloaded 1 large files" lfs fetch
+    cmp -s big.bin "$a/big.bin" || fail "fetch didn't fill in big.bin"
+
+    cd "$a"
+    expect "Created branch" branch more
+    expect "Switched" switch more
+    head -c 2000000 /dev/urandom > more.bin
+    expect "Saved commit" commit "Add another large file"
+    expect "Uploaded 1 large files" lfs push
+
+    cd "$b"
+    git fetch -q origin more:more
+    expect "Switched" switch more
+    cmp -s more.bin "$a/more.bin" || fail "switch didn't download more.bin"
+
+    stop_server
+    echo "ok $CASE"
+}
+
+check_case plain ""
+check_case auth "user:secret@" --require-auth user:secret
+check_case redirect "" --redirect
+check_case chunked "" --chunked
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+# A stand-in Git LFS server for checking Metro's LFS client, keeping objects in a directory.
+# It speaks the batch API with the basic transfer adapter, and can be made strict or awkward
+# in the ways real servers are:
+#   --require-auth USER:PASSWORD  refuse requests without these basic authentication credentials
+#   --redirect                    answer downloads with a redirect to the object rather than the object itself
+#   --chunked                     send downloads with chunked transfer encoding
+# Every request must carry a Host header naming the port the server listens on, as virtual hosts need.
+# The port is written to --port-file once the server is listening, so a script can start it on port 0.
+#   python3 lfs_server.py --dir /tmp/lfs-objects --port-file /tmp/lfs-port
+
+import argparse
+import base64
+import hashlib
+import json
+import os
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+LFS_MEDIA_TYPE = "application/vnd.git-lfs+json"
+
+
+class LfsHandler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+
+    def base_url(self):
+        return "http://127.0.0.1:%d" % self.server.server_port
+
+    def object_path(self, oid):
+        return os.path.join(self.server.options.dir, oid)
+
+    def send(self, status, body=b"", content_type=LFS_MEDIA_TYPE, headers=None):
+        self.send_response(status)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        for name, value in (headers or {}).items():
+            self.send_header(name, value)
+        self.end_headers()
+        self.wfile.write(body)
+
+    def send_json(self, status, value):
+        self.send(status, json.dumps(value).encode())
+
+    def read_body(self):
+        return self.rfile.read(int(self.headers.get("Content-Length", 0)))
+
+    # Check the Host header and credentials. Returns False after sending an error if they are wrong.
+    def check_request(self):
+        host = "127.0.0.1:%d" % self.server.server_port
+        if self.headers.get("Host") != host:
+            self.send_json(400, {"message": "Host header %r should be %r" % (self.headers.get("Host"), host)})
+            return False
+        auth = self.server.options.require_auth
+        if auth and self.headers.get("Authorization") != "Basic " + base64.b64encode(auth.encode()).decode():
+            self.send_json(401, {"message": "Credentials required"})
+            return False
+        return True
+
+    def do_POST(self):
+        body = self.read_body()
+        if not self.check_request():
+            return
+        request = json.loads(body)
+        if self.path == "/objects/batch":
+            self.send_json(200, {"transfer": "basic", "objects": [self.batch_object(request["operation"], o)
+                                                                  for o in request["objects"]]})
+        elif self.path == "/verify":
+            path = self.object_path(request["oid"])
+            if os.path.exists(path) and os.path.getsize(path) == request["size"]:
+                self.send_json(200, {})
+            else:
+                self.send_json(422, {"message": "Object %s is missing or the wrong size" % request["oid"]})
+        else:
+            self.send_json(404, {"message": "Not found"})
+
+    def batch_object(self, operation, obj):
+        oid, size = obj["oid"], obj["size"]
+        have = os.path.exists(self.object_path(oid))
+        entry = {"oid": oid, "size": size}
+        if operation == "download" and not have:
+            entry["error"] = {"code": 404, "message": "Object does not exist"}
+        elif operation == "download":
+            prefix = "/redirect/" if self.server.options.redirect else "/objects/"
+            entry["actions"] = {"download": {"href": self.base_url() + prefix + oid}}
+        elif not have:
+            entry["actions"] = {"upload": {"href": self.base_url() + "/objects/" + oid},
+                                "verify": {"href": self.base_url() + "/verify"}}
+        return entry
+
+    def do_GET(self):
+        if not self.check_request():
+            return
+        if self.path.startswith("/redirect/"):
+            # A relative redirect, which the client has to resolve against this server.
+            self.send(302, headers={"Location": "/objects/" + self.path[len("/redirect/"):]})
+            return
+        oid = self.path[len("/objects/"):]
+        if not self.path.startswith("/objects/") or not os.path.exists(self.object_path(oid)):
+            self.send_json(404, {"message": "Not found"})
+            return
+        with open(self.object_path(oid), "rb") as f:
+            data = f.read()
+        if not self.server.options.chunked:
+            self.send(200, data, "application/octet-stream")
+            return
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+        for start in range(0, len(data), 4096):
+            chunk = data[start:start + 4096]
+            self.wfile.write(b"%x\r\n%s\r\n" % (len(chunk), chunk))
+        self.wfile.write(b"0\r\n\r\n")
+
+    def do_PUT(self):
+        data = self.read_body()
+        if not self.check_request():
+            return
+        oid = self.path[len("/objects/"):]
+        if hashlib.sha256(data).hexdigest() != oid:
+            self.send_json(422, {"message": "Contents don't match %s" % oid})
+            return
+        with open(self.object_path(oid), "wb") as f:
+            f.write(data)
+        self.send(200)
+
+    def log_message(self, format, *args):
+        if self.server.options.verbose:
+            super().log_message(format, *args)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in Git LFS server")
+    parser.add_argument("--dir", required=True, help="directory to keep the objects in")
+    parser.add_argument("--port", type=int, default=0)
+    parser.add_argument("--port-file", help="file to write the listening port to")
+    parser.add_argument("--require-auth", metavar="USER:PASSWORD")
+    parser.add_argument("--redirect", action="store_true")
+    parser.add_argument("--chunked", action="store_true")
+    parser.add_argument("--verbose", action="store_true")
+    options = parser.parse_args()
+
+    os.makedirs(options.dir, exist_ok=True)
+    server = ThreadingHTTPServer(("127.0.0.1", options.port), LfsHandler)
+    server.options = options
+    if options.port_file:
+        with open(options.port_file + ".tmp", "w") as f:
+            f.write(str(server.server_port))
+        os.rename(options.port_file + ".tmp", options.port_file)
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
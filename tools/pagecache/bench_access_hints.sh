@@ -0,0 +1,105 @@
+#!/usr/bin/env bash
+# Time checkout, log and commit with a cold and a warm page cache, with and without the access pattern hints,
+# so their effect can be measured. METRO_NO_ACCESS_HINTS turns the hints off.
+#   checkout  metro switch between two branches, which reads packs sequentially
+#   log       metro log with the commit index deleted first, so the whole history is walked
+#   commit    metro commit of a one line change, which checks status and hardly touches the packs
+# The cold runs drop the page cache first: all of it when run as root, otherwise the repo's files with vmtouch -e.
+# The repo is changed: it is switched between the branches and commits are added to a metro-bench branch,
+# so use a scratch clone.
+#   tools/pagecache/bench_access_hints.sh build/metro ~/scratch/big-repo main other-branch [runs]
+
+set -eu
+
+METRO=$(realpath "$1")
+REPO=$(realpath "$2")
+FIRST=$3
+SECOND=$4
+RUNS=${5:-5}
+
+cd "$REPO"
+
+drop_caches() {
+    sync
+    if [ "$(id -u)" = 0 ]; then
+        echo 3 > /proc/sys/vm/drop_caches
+    elif command -v vmtouch >/dev/null; then
+        vmtouch -q -e "$REPO"
+    else
+        echo "Cold runs need root or vmtouch to drop the page cache." >&2
+        exit 1
+    fi
+}
+
+# Read the whole repo, so that warm runs find everything in the page cache.
+warm_caches() {
+    find "$REPO" -type f -exec cat {} + > /dev/null
+}
+
+# Print the milliseconds a command takes.
+time_ms() {
+    local start end
+    start=$(date +%s%N)
+    "$@" > /dev/null
+    end=$(date +%s%N)
+    echo $(( (end - start) / 1000000 ))
+}
+
+median() {
+    sort -n | awk '{ values[NR] = $1 } END { print values[int((NR + 1) / 2)] }'
+}
+
+# Set up the state each benchmark starts from, without timing it.
+prepare() {
+    case $1 in
+        checkout) ;;
+        log) rm -f .git/metro/commit-index .git/metro/commit-index.journal ;;
+        commit) echo "$RANDOM" >> metro-bench.txt ;;
+    esac
+}
+
+run() {
+    case $1 in
+        checkout)
+            if [ "$("$METRO" info | sed -n 's/^Current branch: //p')" = "$FIRST" ]; then
+                "$METRO" switch "$SECOND"
+            else
+                "$METRO" switch "$FIRST"
+            fi
+            ;;
+        log) "$METRO" log ;;
+        commit) "$METRO" commit "Benchmark commit" ;;
+    esac
+}
+
+"$METRO" switch "$FIRST" > /dev/null
+"$METRO" branch metro-bench > /dev/null 2>&1 || true
+
+printf "%-9s %-6s %12s %12s\n" "OPERATION" "CACHE" "HINTS MS" "NO HINTS MS"
+for operation in checkout log commit; do
+    if [ "$operation" = commit ]; then
+        "$METRO" switch metro-bench > /dev/null
+    fi
+    for cache in cold warm; do
+        results=()
+        for hints in on off; do
+            times=()
+            for _ in $(seq "$RUNS"); do
+                prepare "$operation"
+                if [ "$cache" = cold ]; then
+                    drop_caches
+                else
+                    warm_caches
+                fi
+                if [ "$hints" = on ]; then
+                    times+=("$(time_ms run "$operation")")
+                else
+                    times+=("$(METRO_NO_ACCESS_HINTS=1 time_ms run "$operation")")
+                fi
+            done
+            results+=("$(printf "%s\n" "${times[@]}" | median)")
+        done
+        printf "%-9s %-6s %12s %12s\n" "$operation" "$cache" "${results[0]}" "${results[1]}"
+    done
+done
+"$METRO" switch "$FIRST" > /dev/null